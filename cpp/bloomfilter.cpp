@@ -0,0 +1,75 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "bloomfilter.h"
+
+CountingBloomFilter::CountingBloomFilter(size_t capacity, double falsePositiveRate)
+    : capacity(capacity > 0 ? capacity : 1), falsePositiveRate(falsePositiveRate)
+{
+    if (!(falsePositiveRate > 0 && falsePositiveRate < 1))
+    {
+        throw std::invalid_argument("False positive rate must be in ]0, 1[");
+    }
+    const double ln2 = std::log(2.0);
+    double m = -double(this->capacity) * std::log(falsePositiveRate) / (ln2 * ln2);
+    counters.assign(static_cast<size_t>(std::ceil(m)) + 1, 0);
+    hashes = static_cast<size_t>(std::round(m / this->capacity * ln2));
+    if (hashes < 1)
+        hashes = 1;
+}
+
+void CountingBloomFilter::hash(std::string_view key, uint64_t &h1, uint64_t &h2)
+{
+    // 64-bit FNV-1a followed by a murmur3 finalizer for the second hash
+    uint64_t h = 14695981039346656037ull;
+    for (char c : key)
+    {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    h1 = h;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    h2 = h | 1; // odd, so that the k positions differ
+}
+
+void CountingBloomFilter::insert(std::string_view key)
+{
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+    for (size_t i = 0; i < hashes; ++i)
+    {
+        uint8_t &counter = counters[(h1 + i * h2) % counters.size()];
+        if (counter < 255)
+            ++counter;
+    }
+    ++count;
+}
+
+void CountingBloomFilter::erase(std::string_view key)
+{
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+    for (size_t i = 0; i < hashes; ++i)
+    {
+        uint8_t &counter = counters[(h1 + i * h2) % counters.size()];
+        if (counter > 0 && counter < 255)
+            --counter;
+    }
+    if (count > 0)
+        --count;
+}
+
+bool CountingBloomFilter::mayContain(std::string_view key) const
+{
+    uint64_t h1, h2;
+    hash(key, h1, h2);
+    for (size_t i = 0; i < hashes; ++i)
+    {
+        if (counters[(h1 + i * h2) % counters.size()] == 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file bloomfilter.h
+ * @brief Header file for the CountingBloomFilter class
+ *
+ * This file defines the CountingBloomFilter class, a probabilistic set of strings
+ * used by the Manager to answer "definitely absent" without probing its maps.
+ */
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class CountingBloomFilter
+ * @brief A Bloom filter with 8-bit counters, which supports deletion
+ *
+ * mayContain() never returns false for a key that was inserted (and not erased),
+ * and returns true for an absent key with a probability close to the configured
+ * false positive rate as long as the number of keys stays below the capacity.
+ * The number of counters and of hash functions is derived from the capacity and
+ * the false positive rate with the usual formulas m = -n ln(p) / ln(2)^2 and
+ * k = (m / n) ln(2). The k positions of a key are obtained by double hashing.
+ *
+ * A counter that reaches 255 sticks there and is never decremented, so that
+ * the filter stays correct (it only becomes slightly less selective).
+ */
+class CountingBloomFilter
+{
+public:
+    /**
+     * @brief Creates an empty filter
+     *
+     * @param[in] capacity The number of keys the filter is sized for
+     * @param[in] falsePositiveRate The expected false positive rate at capacity (in ]0, 1[)
+     *
+     * @throws std::invalid_argument if the false positive rate is out of range
+     */
+    explicit CountingBloomFilter(size_t capacity = 1024, double falsePositiveRate = 0.01);
+
+    /**
+     * @brief Adds a key
+     *
+     * @param[in] key The key to add
+     */
+    void insert(std::string_view key);
+
+    /**
+     * @brief Removes a key
+     *
+     * @param[in] key The key to remove, which must have been added before
+     */
+    void erase(std::string_view key);
+
+    /**
+     * @brief Tests whether a key may have been added
+     *
+     * @param[in] key The key to test
+     * @return false if the key was definitely not added
+     */
+    bool mayContain(std::string_view key) const;
+
+    /** @brief Returns the number of keys currently in the filter */
+    size_t size() const { return count; }
+
+    /** @brief Returns the number of keys the filter is sized for */
+    size_t getCapacity() const { return capacity; }
+
+    /** @brief Returns the false positive rate the filter is sized for */
+    double getFalsePositiveRate() const { return falsePositiveRate; }
+
+private:
+    /** @brief Computes the two base hashes of a key */
+    static void hash(std::string_view key, uint64_t &h1, uint64_t &h2);
+
+    size_t capacity;
+    double falsePositiveRate;
+    size_t count = 0;
+    size_t hashes;
+    std::vector<uint8_t> counters;
+};
+
+#endif // BLOOMFILTER_H
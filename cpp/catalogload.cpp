@@ -0,0 +1,45 @@
+#include "catalogload.h"
+
+CatalogLoad::CatalogLoad(const std::string &filename, uint64_t totalBytes)
+    : filename(filename), totalBytes(totalBytes), start(std::chrono::steady_clock::now())
+{
+}
+
+double CatalogLoad::getProgress() const
+{
+    if (done || totalBytes == 0)
+        return done ? 1 : 0;
+    return static_cast<double>(loadedBytes) / totalBytes;
+}
+
+double CatalogLoad::getSeconds() const
+{
+    if (done)
+        return seconds;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CatalogLoad::wait() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]
+                  { return done.load(); });
+}
+
+void CatalogLoad::advance(uint64_t bytes, unsigned long batchRecords, unsigned long batchErrors)
+{
+    loadedBytes = bytes;
+    records += batchRecords;
+    errors += batchErrors;
+}
+
+void CatalogLoad::finish()
+{
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    loadedBytes = totalBytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    finished.notify_all();
+}
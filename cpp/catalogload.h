@@ -0,0 +1,87 @@
+/**
+ * @file catalogload.h
+ * @brief Header file for the CatalogLoad class
+ *
+ * This file defines the CatalogLoad class, the handle of a catalog loaded in
+ * the background by Manager::readAsync().
+ */
+
+#ifndef CATALOGLOAD_H
+#define CATALOGLOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * @class CatalogLoad
+ * @brief Progress of a background catalog load
+ *
+ * The counters are updated by the loading thread after each batch of lines
+ * and may be read from any thread.
+ *
+ * @sa Manager::readAsync()
+ */
+class CatalogLoad
+{
+public:
+    /**
+     * @brief Creates the handle of a load that has not started yet
+     *
+     * @param[in] filename The catalog being loaded
+     * @param[in] totalBytes The size of the catalog
+     */
+    CatalogLoad(const std::string &filename, uint64_t totalBytes);
+
+    /** @brief Returns the catalog being loaded */
+    const std::string &getFilename() const { return filename; }
+
+    /** @brief Returns the size of the catalog in bytes */
+    uint64_t getTotalBytes() const { return totalBytes; }
+
+    /** @brief Returns the number of bytes parsed and added to the catalog */
+    uint64_t getLoadedBytes() const { return loadedBytes; }
+
+    /** @brief Returns the fraction of the catalog loaded, between 0 and 1 */
+    double getProgress() const;
+
+    /** @brief Returns the number of objects and groups added */
+    unsigned long getRecords() const { return records; }
+
+    /** @brief Returns the number of lines rejected */
+    unsigned long getErrors() const { return errors; }
+
+    /** @brief Returns the time since the load started, or its duration once done */
+    double getSeconds() const;
+
+    /** @brief Returns true once every line has been added */
+    bool isDone() const { return done; }
+
+    /** @brief Waits until every line has been added */
+    void wait() const;
+
+private:
+    friend class Manager;
+
+    /** @brief Records a batch added to the catalog */
+    void advance(uint64_t bytes, unsigned long batchRecords, unsigned long batchErrors);
+
+    /** @brief Records the end of the load and wakes the waiting threads */
+    void finish();
+
+    std::string filename;
+    uint64_t totalBytes;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<uint64_t> loadedBytes{0};
+    std::atomic<unsigned long> records{0}, errors{0};
+    std::atomic<double> seconds{0};
+    std::atomic<bool> done{false};
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable finished;
+};
+
+#endif // CATALOGLOAD_H
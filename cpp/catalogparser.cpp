@@ -0,0 +1,182 @@
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "catalogparser.h"
+
+namespace
+{
+    // Splits a line into space-separated fields.
+    class Fields
+    {
+    public:
+        explicit Fields(std::string_view line) : rest(line) {}
+
+        bool next(std::string_view &field)
+        {
+            size_t start = rest.find_first_not_of(" \t");
+            if (start == std::string_view::npos)
+                return false;
+            rest.remove_prefix(start);
+            size_t end = rest.find_first_of(" \t");
+            field = rest.substr(0, end);
+            rest.remove_prefix(field.size());
+            return true;
+        }
+
+        template <class T>
+        bool number(T &value)
+        {
+            std::string_view field;
+            if (!next(field))
+                return false;
+            auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+            return result.ec == std::errc() && result.ptr == field.data() + field.size();
+        }
+
+        // the remaining text without its surrounding blanks
+        std::string_view remainder() const
+        {
+            size_t start = rest.find_first_not_of(" \t");
+            if (start == std::string_view::npos)
+                return std::string_view();
+            size_t end = rest.find_last_not_of(" \t");
+            return rest.substr(start, end - start + 1);
+        }
+
+    private:
+        std::string_view rest;
+    };
+}
+
+CatalogParser::CatalogParser(std::string_view text, size_t firstLine) : text(text), line(firstLine - 1) {}
+
+bool CatalogParser::next(CatalogRecord &record)
+{
+    while (pos < text.size())
+    {
+        const char *begin = text.data() + pos;
+        const char *newline = static_cast<const char *>(memchr(begin, '\n', text.size() - pos));
+        size_t length = newline ? size_t(newline - begin) : text.size() - pos;
+        pos += newline ? length + 1 : length;
+        ++line;
+
+        std::string_view current(begin, length);
+        if (!current.empty() && current.back() == '\r')
+            current.remove_suffix(1);
+        if (current.find_first_not_of(" \t") == std::string_view::npos)
+            continue;
+
+        record.line = line;
+        if (const char *message = parseLine(current, record))
+        {
+            errors.push_back(Error{line, message});
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+const char *CatalogParser::parseLine(std::string_view line, CatalogRecord &record)
+{
+    Fields fields(line);
+    std::string_view className;
+    fields.next(className);
+    record.chapters.clear();
+    record.members.clear();
+    record.memberIds.clear();
+
+    if (className == "Photo")
+    {
+        record.kind = CatalogRecord::Photo;
+        if (!fields.next(record.name) || !fields.next(record.filepath))
+            return "Photo line is missing a name or a file path";
+        // from_chars accepts "nan" and "inf", which are no coordinates
+        if (!fields.number(record.latitude) || !fields.number(record.longitude) ||
+            !std::isfinite(record.latitude) || !std::isfinite(record.longitude))
+            return "Invalid photo coordinates";
+    }
+    else if (className == "Video")
+    {
+        record.kind = CatalogRecord::Video;
+        if (!fields.next(record.name) || !fields.next(record.filepath))
+            return "Video line is missing a name or a file path";
+        if (!fields.number(record.duration))
+            return "Invalid video duration";
+    }
+    else if (className == "Film")
+    {
+        record.kind = CatalogRecord::Film;
+        if (!fields.next(record.name) || !fields.next(record.filepath))
+            return "Film line is missing a name or a file path";
+        size_t count = 0;
+        if (!fields.number(record.duration) || !fields.number(count))
+            return "Invalid film duration or number of chapters";
+        if (count == 0)
+            return "Chapters cannot be empty!";
+        if (count > line.size())
+            return "Invalid number of chapters";
+        record.chapters.resize(count);
+        for (int &chapter : record.chapters)
+        {
+            if (!fields.number(chapter))
+                return "Invalid film chapter";
+        }
+    }
+    else if (className == "Group")
+    {
+        // Group <n> <member names...> <group name>
+        record.kind = CatalogRecord::Group;
+        size_t count = 0;
+        if (!fields.number(count) || count > line.size())
+            return "Invalid number of group members";
+        record.members.resize(count);
+        for (std::string_view &member : record.members)
+        {
+            if (!fields.next(member))
+                return "Missing group member";
+        }
+        record.name = fields.remainder();
+        if (record.name.empty())
+            return "Group line is missing a name";
+        return nullptr;
+    }
+    else if (className == "GroupIds")
+    {
+        // GroupIds <n> <first ID> <differences between consecutive IDs...> <group name>
+        record.kind = CatalogRecord::Group;
+        size_t count = 0;
+        if (!fields.number(count) || count > line.size())
+            return "Invalid number of group members";
+        record.memberIds.resize(count);
+        // both the IDs and the differences are kept within 2^48, so the sum cannot overflow
+        constexpr long long MAX_ID = 1LL << 48;
+        long long id = 0;
+        for (size_t &memberId : record.memberIds)
+        {
+            long long delta;
+            if (!fields.number(delta))
+                return "Missing group member";
+            if (delta < -MAX_ID || delta > MAX_ID)
+                return "Invalid group member";
+            id += delta;
+            if (id < 0 || id > MAX_ID)
+                return "Invalid group member";
+            memberId = static_cast<size_t>(id);
+        }
+        record.name = fields.remainder();
+        if (record.name.empty())
+            return "Group line is missing a name";
+        return nullptr;
+    }
+    else
+    {
+        return "Unknown class type";
+    }
+
+    std::string_view extra;
+    if (fields.next(extra))
+        return "Unexpected data at the end of the line";
+    return nullptr;
+}
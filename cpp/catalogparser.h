@@ -0,0 +1,123 @@
+/**
+ * @file catalogparser.h
+ * @brief Header file for the CatalogParser class
+ *
+ * This file defines the CatalogParser class which tokenises the text catalog
+ * format written by Manager::save() without copying it.
+ */
+
+#ifndef CATALOGPARSER_H
+#define CATALOGPARSER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct CatalogRecord
+ * @brief One parsed line of a catalog
+ *
+ * The string views point into the parsed text and are only valid as long as it.
+ * Only the fields relevant to the kind of the record are meaningful.
+ */
+struct CatalogRecord
+{
+    /** @brief Kind of object described by the line */
+    enum Kind { Photo, Video, Film, Group } kind = Photo;
+
+    /** @brief Line number of the record in the text (the first line is 1) */
+    size_t line = 0;
+
+    /** @brief Name of the object or group */
+    std::string_view name;
+
+    /** @brief File path of the object */
+    std::string_view filepath;
+
+    /** @brief Location of a photo */
+    double latitude = 0, longitude = 0;
+
+    /** @brief Duration of a video or film */
+    int duration = 0;
+
+    /** @brief Chapter lengths of a film */
+    std::vector<int> chapters;
+
+    /** @brief Member names of a group (`Group` lines) */
+    std::vector<std::string_view> members;
+
+    /**
+     * @brief Member IDs of a group (`GroupIds` lines)
+     *
+     * The ID of an object is the rank of its line among the Photo, Video and
+     * Film lines of the catalog, starting from 0.
+     */
+    std::vector<size_t> memberIds;
+};
+
+/**
+ * @class CatalogParser
+ * @brief Zero-copy parser of the text catalog format
+ *
+ * The text (typically a MappedFile) is split into lines with memchr, which the
+ * C library implements with vector instructions, and lines are split into
+ * std::string_view fields without allocating. Numbers are converted with
+ * std::from_chars. Malformed lines are recorded with their line number and
+ * skipped, so that one bad line does not prevent the rest of the catalog from
+ * being loaded.
+ *
+ * @sa Manager::read(), Manager::save()
+ */
+class CatalogParser
+{
+public:
+    /**
+     * @struct Error
+     * @brief A malformed line
+     */
+    struct Error
+    {
+        size_t line;         ///< Line number (the first line is 1)
+        std::string message; ///< Description of the problem
+    };
+
+    /**
+     * @brief Creates a parser over a text
+     *
+     * @param[in] text The text to parse, which must outlive the parser
+     * @param[in] firstLine The line number of the first line of _text_
+     */
+    explicit CatalogParser(std::string_view text, size_t firstLine = 1);
+
+    /**
+     * @brief Parses the next valid line
+     *
+     * Empty lines are ignored and malformed lines are added to getErrors().
+     * The vectors of _record_ are reused from one call to the next.
+     *
+     * @param[out] record The parsed record
+     * @return false when the end of the text is reached
+     */
+    bool next(CatalogRecord &record);
+
+    /** @brief Returns the malformed lines met so far */
+    const std::vector<Error> &getErrors() const { return errors; }
+
+    /** @brief Returns the number of bytes consumed so far */
+    size_t consumed() const { return pos; }
+
+    /** @brief Returns the line number of the last line consumed */
+    size_t getLine() const { return line; }
+
+private:
+    /** @brief Parses one non-empty line, returns an error message or nullptr */
+    const char *parseLine(std::string_view line, CatalogRecord &record);
+
+    std::string_view text;
+    size_t pos = 0;
+    size_t line;
+    std::vector<Error> errors;
+};
+
+#endif // CATALOGPARSER_H
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "catalogwriter.h"
+
+CatalogWriter::CatalogWriter(const std::string &path, size_t bufferSize)
+    : path(path), tmpPath(path + ".tmp"), buffer(bufferSize < 64 ? 64 : bufferSize)
+{
+    fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        fail("Cannot create " + tmpPath);
+}
+
+CatalogWriter::~CatalogWriter()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        ::unlink(tmpPath.c_str());
+    }
+}
+
+CatalogWriter &CatalogWriter::operator<<(std::string_view text)
+{
+    return write(text.data(), text.size());
+}
+
+CatalogWriter &CatalogWriter::operator<<(char c)
+{
+    if (used == buffer.size())
+        flush();
+    buffer[used++] = c;
+    return *this;
+}
+
+CatalogWriter &CatalogWriter::write(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        if (used == buffer.size())
+            flush();
+        size_t chunk = std::min(size, buffer.size() - used);
+        memcpy(buffer.data() + used, bytes, chunk);
+        used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+    return *this;
+}
+
+void CatalogWriter::flush()
+{
+    size_t done = 0;
+    while (done < used)
+    {
+        ssize_t n = ::write(fd, buffer.data() + done, used - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            fail("Cannot write " + tmpPath);
+        done += n;
+    }
+    written += used;
+    used = 0;
+}
+
+void CatalogWriter::commit()
+{
+    flush();
+    if (::fsync(fd) != 0)
+        fail("Cannot sync " + tmpPath);
+    if (::close(fd) != 0)
+    {
+        fd = -1;
+        ::unlink(tmpPath.c_str());
+        fail("Cannot close " + tmpPath);
+    }
+    fd = -1;
+    if (::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        int error = errno;
+        ::unlink(tmpPath.c_str());
+        errno = error;
+        fail("Cannot rename " + tmpPath + " to " + path);
+    }
+}
+
+void CatalogWriter::fail(const std::string &what)
+{
+    throw std::runtime_error(what + ": " + strerror(errno));
+}
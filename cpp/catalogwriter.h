@@ -0,0 +1,101 @@
+/**
+ * @file catalogwriter.h
+ * @brief Header file for the CatalogWriter class
+ *
+ * This file defines the CatalogWriter class, a buffered output file that is
+ * replaced atomically, used by the Manager to save its catalog.
+ */
+
+#ifndef CATALOGWRITER_H
+#define CATALOGWRITER_H
+
+#include <charconv>
+#include <type_traits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class CatalogWriter
+ * @brief Buffered writer that atomically replaces a file
+ *
+ * Data is accumulated in a large buffer and handed to the kernel only when the
+ * buffer is full, so that saving a catalog costs a handful of system calls
+ * instead of one open/write/close per object. Numbers are formatted with
+ * std::to_chars, which neither allocates nor depends on the locale.
+ *
+ * Everything is written to a temporary file next to the destination, which
+ * commit() syncs and renames over the destination: readers see either the old
+ * or the new file, never a partially written one. If the writer is destroyed
+ * without commit(), the temporary file is removed and the destination is left
+ * untouched.
+ */
+class CatalogWriter
+{
+public:
+    /**
+     * @brief Opens a temporary file next to _path_
+     *
+     * @param[in] path The file to replace on commit()
+     * @param[in] bufferSize The size of the write buffer in bytes
+     *
+     * @throws std::runtime_error if the temporary file cannot be created
+     */
+    explicit CatalogWriter(const std::string &path, size_t bufferSize = 1 << 20);
+
+    /**
+     * @brief Destructor for CatalogWriter
+     *
+     * Removes the temporary file if commit() was not called.
+     */
+    ~CatalogWriter();
+
+    /** @brief Appends a string */
+    CatalogWriter &operator<<(std::string_view text);
+
+    /** @brief Appends a character */
+    CatalogWriter &operator<<(char c);
+
+    /** @brief Appends a number in its shortest decimal representation */
+    template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    CatalogWriter &operator<<(T value)
+    {
+        if (buffer.size() - used < 32)
+            flush();
+        auto result = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value);
+        used = result.ptr - buffer.data();
+        return *this;
+    }
+
+    /** @brief Appends raw bytes */
+    CatalogWriter &write(const void *data, size_t size);
+
+    /** @brief Returns the number of bytes written so far */
+    size_t tell() const { return written + used; }
+
+    /**
+     * @brief Writes the remaining data, syncs it and renames the temporary file
+     *
+     * @throws std::runtime_error on I/O error
+     */
+    void commit();
+
+private:
+    CatalogWriter(const CatalogWriter &) = delete;
+    CatalogWriter &operator=(const CatalogWriter &) = delete;
+
+    /** @brief Hands the content of the buffer to the kernel */
+    void flush();
+
+    /** @brief Throws a std::runtime_error describing errno */
+    [[noreturn]] void fail(const std::string &what);
+
+    std::string path, tmpPath;
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t written = 0;
+};
+
+#endif // CATALOGWRITER_H
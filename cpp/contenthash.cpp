@@ -0,0 +1,167 @@
+#include <cstring>
+
+#include "contenthash.h"
+#include "mappedfile.h"
+
+namespace
+{
+    constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    // seed of the sampled hashes
+    constexpr uint64_t SAMPLED_SEED = 0x53414D504C4544ULL;
+
+    inline uint64_t rotate(uint64_t x, int bits)
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    inline uint64_t read64(const unsigned char *p)
+    {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        return value;
+    }
+
+    inline uint32_t read32(const unsigned char *p)
+    {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        return value;
+    }
+
+    inline uint64_t round(uint64_t lane, uint64_t input)
+    {
+        return rotate(lane + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t merge(uint64_t hash, uint64_t lane)
+    {
+        return (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+    }
+
+    // Consumes the whole 32-byte stripes of _data_, returns their size.
+    size_t stripes(uint64_t lanes[4], const unsigned char *data, size_t size)
+    {
+        uint64_t v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            v1 = round(v1, read64(data + i));
+            v2 = round(v2, read64(data + i + 8));
+            v3 = round(v3, read64(data + i + 16));
+            v4 = round(v4, read64(data + i + 24));
+        }
+        lanes[0] = v1;
+        lanes[1] = v2;
+        lanes[2] = v3;
+        lanes[3] = v4;
+        return i;
+    }
+}
+
+contenthash::Hasher::Hasher(uint64_t seed)
+    : seed(seed), lanes{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1}
+{
+}
+
+void contenthash::Hasher::update(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    total += size;
+    if (buffered + size < sizeof(buffer))
+    {
+        memcpy(buffer + buffered, bytes, size);
+        buffered += size;
+        return;
+    }
+    if (buffered > 0)
+    {
+        size_t fill = sizeof(buffer) - buffered;
+        memcpy(buffer + buffered, bytes, fill);
+        stripes(lanes, buffer, sizeof(buffer));
+        bytes += fill;
+        size -= fill;
+        buffered = 0;
+    }
+    size_t done = stripes(lanes, bytes, size);
+    buffered = size - done;
+    memcpy(buffer, bytes + done, buffered);
+}
+
+uint64_t contenthash::Hasher::digest() const
+{
+    uint64_t hash;
+    if (total >= 32)
+    {
+        hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+        for (uint64_t lane : lanes)
+            hash = merge(hash, lane);
+    }
+    else
+    {
+        hash = seed + PRIME5;
+    }
+    hash += total;
+
+    const unsigned char *p = buffer;
+    size_t left = buffered;
+    for (; left >= 8; p += 8, left -= 8)
+        hash = rotate(hash ^ round(0, read64(p)), 27) * PRIME1 + PRIME4;
+    if (left >= 4)
+    {
+        hash = rotate(hash ^ uint64_t(read32(p)) * PRIME1, 23) * PRIME2 + PRIME3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; ++p, --left)
+        hash = rotate(hash ^ *p * PRIME5, 11) * PRIME1;
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t contenthash::hash(const void *data, size_t size, uint64_t seed)
+{
+    Hasher hasher(seed);
+    hasher.update(data, size);
+    return hasher.digest();
+}
+
+uint64_t contenthash::hashFile(const std::string &path, Mode mode, uint64_t &bytes)
+{
+    MappedFile file(path);
+    uint64_t size = file.size();
+    if (mode != Mode::Sampled || size <= SAMPLE_THRESHOLD)
+    {
+        file.advise(true);
+        bytes = size;
+        return hash(file.data(), size);
+    }
+    file.advise(false);
+    Hasher hasher(SAMPLED_SEED);
+    hasher.update(&size, sizeof(size));
+    // the first sample starts at 0, the last one ends at the end of the file
+    uint64_t step = (size - SAMPLE_SIZE) / (SAMPLES - 1);
+    for (size_t i = 0; i < SAMPLES; ++i)
+        hasher.update(file.data() + i * step, SAMPLE_SIZE);
+    bytes = SAMPLES * SAMPLE_SIZE;
+    return hasher.digest();
+}
+
+bool contenthash::sameContent(const std::string &path, const std::string &other)
+{
+    MappedFile file(path), otherFile(other);
+    if (file.size() != otherFile.size())
+        return false;
+    file.advise(true);
+    otherFile.advise(true);
+    return file.size() == 0 || memcmp(file.data(), otherFile.data(), file.size()) == 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file contenthash.h
+ * @brief Header file for the content hash of media files
+ *
+ * This file declares the streaming 64-bit hash used to find files with the
+ * same content under different names.
+ */
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Content hashing of media files
+ *
+ * The hash is XXH64: four independent 64-bit multiply-rotate lanes consume 32
+ * bytes per step, so that the compiler can keep them in registers and the CPU
+ * run them in parallel, then are merged with the length and the last bytes.
+ * It is not cryptographic: it tells files apart, an adversary can forge
+ * collisions.
+ *
+ * Large videos are expensive to read in full: in sampled mode, files larger
+ * than SAMPLE_THRESHOLD are hashed on their size and SAMPLES blocks of
+ * SAMPLE_SIZE bytes spread evenly from the first to the last byte. Sampled
+ * hashes use another seed, so that they never match a full one.
+ */
+namespace contenthash
+{
+    /** @brief How much of a file is hashed */
+    enum class Mode
+    {
+        None,    ///< no hash
+        Sampled, ///< whole small files, samples of large ones
+        Full     ///< every byte
+    };
+
+    /** @brief Files hashed in full even in sampled mode */
+    constexpr uint64_t SAMPLE_THRESHOLD = 16 << 20;
+    constexpr size_t SAMPLES = 16;
+    constexpr size_t SAMPLE_SIZE = 64 << 10;
+
+    /**
+     * @class Hasher
+     * @brief Streaming XXH64
+     *
+     * Data may be passed in pieces of any size: the digest only depends on
+     * their concatenation.
+     */
+    class Hasher
+    {
+    public:
+        /** @brief Starts a hash with a seed */
+        explicit Hasher(uint64_t seed = 0);
+
+        /** @brief Hashes the next _size_ bytes */
+        void update(const void *data, size_t size);
+
+        /** @brief Returns the hash of the bytes passed so far */
+        uint64_t digest() const;
+
+    private:
+        uint64_t seed;
+        uint64_t lanes[4];
+        unsigned char buffer[32]; ///< bytes waiting for a full stripe
+        size_t buffered = 0;
+        uint64_t total = 0;
+    };
+
+    /** @brief Returns the XXH64 of a buffer */
+    uint64_t hash(const void *data, size_t size, uint64_t seed = 0);
+
+    /**
+     * @brief Hashes a file
+     *
+     * The file is memory-mapped: in sampled mode, only the pages of the
+     * samples are read.
+     *
+     * @param[in] path The file
+     * @param[in] mode Sampled or Full
+     * @param[out] bytes The number of bytes hashed
+     * @return The hash of the file
+     *
+     * @throws std::runtime_error if the file cannot be read
+     */
+    uint64_t hashFile(const std::string &path, Mode mode, uint64_t &bytes);
+
+    /**
+     * @brief Compares two files byte for byte
+     *
+     * Equal hashes do not prove equal contents, even less so sampled ones:
+     * this is the check to make before discarding a file.
+     *
+     * @return true if the files have the same size and bytes
+     *
+     * @throws std::runtime_error if a file cannot be read
+     */
+    bool sameContent(const std::string &path, const std::string &other);
+}
+
+#endif // CONTENTHASH_H
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crawler.h"
+
+namespace
+{
+    // number of files of a directory visited as one task
+    constexpr size_t CHUNK = 256;
+
+    bool candidate(const char *name)
+    {
+        const char *dot = strrchr(name, '.');
+        if (!dot || dot == name)
+            return true;
+        char extension[6] = {};
+        size_t length = strlen(dot + 1);
+        if (length >= sizeof(extension))
+            return false;
+        for (size_t i = 0; i < length; ++i)
+            extension[i] = static_cast<char>(tolower(static_cast<unsigned char>(dot[1 + i])));
+        static const char *const extensions[] = {"jpg", "jpeg", "jpe", "mp4", "m4v", "mov"};
+        for (const char *known : extensions)
+        {
+            if (strcmp(extension, known) == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+struct MediaCrawler::Task
+{
+    bool directory = false;
+    std::string path, relative;
+    std::vector<std::string> names; // files of the directory, for a chunk
+};
+
+struct MediaCrawler::Worker
+{
+    std::mutex mutex;
+    std::deque<Task> tasks;
+};
+
+MediaCrawler::MediaCrawler(unsigned threads, size_t maxOpenFiles)
+    : threads(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      maxOpenFiles(std::max<size_t>(maxOpenFiles, 1))
+{
+    this->threads = static_cast<unsigned>(std::min<size_t>(this->threads, this->maxOpenFiles));
+}
+
+bool MediaCrawler::classify(std::string_view head, MediaType &type)
+{
+    if (head.size() >= 3 && head.compare(0, 3, "\xFF\xD8\xFF") == 0)
+    {
+        type = MediaType::Photo;
+        return true;
+    }
+    // ISO base media files start with a box: 4-byte size, 4-character type
+    static const char *const boxes[] = {"ftyp", "moov", "mdat", "wide", "free", "skip"};
+    if (head.size() >= 8)
+    {
+        for (const char *box : boxes)
+        {
+            if (head.compare(4, 4, box) == 0)
+            {
+                type = MediaType::Video;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool MediaCrawler::inspect(const std::string &path, File &file)
+{
+    size_t slash = path.rfind('/');
+    if (!candidate(path.c_str() + (slash == std::string::npos ? 0 : slash + 1)))
+        return false;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    char head[16];
+    ssize_t size = -1;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        size = ::pread(fd, head, sizeof(head), 0);
+    ::close(fd);
+    if (size <= 0 || !classify(std::string_view(head, size), file.type))
+        return false;
+    file.path = path;
+    file.size = st.st_size;
+    file.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    file.inode = st.st_ino;
+    return true;
+}
+
+void MediaCrawler::acquire()
+{
+    std::unique_lock<std::mutex> lock(openMutex);
+    openAvailable.wait(lock, [this]
+                       { return open < maxOpenFiles; });
+    ++open;
+}
+
+void MediaCrawler::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(openMutex);
+        --open;
+    }
+    openAvailable.notify_one();
+}
+
+MediaCrawler::Progress MediaCrawler::crawl(const std::string &root, const Visit &visit, const Filter &filter)
+{
+    int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + root + ": " + strerror(errno));
+    ::close(fd);
+
+    std::string path = root;
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+    directories = files = media = errors = 0;
+    start = std::chrono::steady_clock::now();
+    running = true;
+
+    std::unique_ptr<Worker[]> owned(new Worker[threads]);
+    workers = owned.get();
+    Task first;
+    first.directory = true;
+    first.path = path;
+    push(0, std::move(first));
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i)
+        pool.emplace_back(&MediaCrawler::run, this, i, std::cref(visit), std::cref(filter));
+    run(0, visit, filter);
+    for (std::thread &thread : pool)
+        thread.join();
+
+    workers = nullptr;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    return getProgress();
+}
+
+MediaCrawler::Progress MediaCrawler::getProgress() const
+{
+    Progress progress;
+    progress.directories = directories;
+    progress.files = files;
+    progress.media = media;
+    progress.errors = errors;
+    progress.seconds = running ? std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                               : seconds.load();
+    return progress;
+}
+
+void MediaCrawler::push(unsigned index, Task &&task)
+{
+    ++pending;
+    std::lock_guard<std::mutex> lock(workers[index].mutex);
+    workers[index].tasks.push_back(std::move(task));
+}
+
+bool MediaCrawler::take(unsigned index, Task &task)
+{
+    {
+        Worker &own = workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        Worker &victim = workers[(index + i) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void MediaCrawler::run(unsigned index, const Visit &visit, const Filter &filter)
+{
+    unsigned idle = 0;
+    Task task;
+    while (true)
+    {
+        if (take(index, task))
+        {
+            idle = 0;
+            if (task.directory)
+                readDirectory(index, task.path, task.relative);
+            else
+                visitFiles(index, task, visit, filter);
+            // the tasks queued by this one were counted before
+            --pending;
+            continue;
+        }
+        if (pending == 0)
+            return;
+        // the other threads are busy with tasks that may queue more
+        if (++idle < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void MediaCrawler::readDirectory(unsigned index, const std::string &path, const std::string &relative)
+{
+    acquire();
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd >= 0 ? ::fdopendir(fd) : nullptr;
+    if (!dir)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        release();
+        ++errors;
+        return;
+    }
+    ++directories;
+
+    Task chunk;
+    chunk.path = path;
+    chunk.relative = relative;
+    std::string prefix = path == "/" ? path : path + "/";
+    std::string relativePrefix = relative.empty() ? relative : relative + "/";
+    while (const dirent *entry = ::readdir(dir))
+    {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (::fstatat(::dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                ++errors;
+                continue;
+            }
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+        }
+        if (type == DT_DIR)
+        {
+            Task directory;
+            directory.directory = true;
+            directory.path = prefix + name;
+            directory.relative = relativePrefix + name;
+            push(index, std::move(directory));
+        }
+        else if (type == DT_REG)
+        {
+            ++files;
+            if (!candidate(name))
+                continue;
+            chunk.names.emplace_back(name);
+            if (chunk.names.size() == CHUNK)
+            {
+                push(index, Task(chunk));
+                chunk.names.clear();
+            }
+        }
+    }
+    ::closedir(dir);
+    release();
+    if (!chunk.names.empty())
+        push(index, std::move(chunk));
+}
+
+void MediaCrawler::visitFiles(unsigned index, const Task &task, const Visit &visit, const Filter &filter)
+{
+    std::string prefix = task.path == "/" ? task.path : task.path + "/";
+    std::string relativePrefix = task.relative.empty() ? task.relative : task.relative + "/";
+    for (const std::string &name : task.names)
+    {
+        File file;
+        file.path = prefix + name;
+        if (filter)
+        {
+            struct stat st;
+            if (::stat(file.path.c_str(), &st) != 0)
+            {
+                ++errors;
+                continue;
+            }
+            file.relative = relativePrefix + name;
+            file.size = st.st_size;
+            file.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            file.inode = st.st_ino;
+            // an exception must not escape the thread, as for visit below
+            try
+            {
+                if (!filter(index, file))
+                    continue;
+            }
+            catch (const std::exception &)
+            {
+                ++errors;
+                continue;
+            }
+        }
+        acquire();
+        int fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            release();
+            ++errors;
+            continue;
+        }
+        char head[16];
+        ssize_t size = ::pread(fd, head, sizeof(head), 0);
+        ::close(fd);
+        if (size > 0 && classify(std::string_view(head, size), file.type))
+        {
+            ++media;
+            file.relative = relativePrefix + name;
+            // the descriptor reserved above is left to the visit function
+            try
+            {
+                visit(index, file);
+            }
+            catch (const std::exception &)
+            {
+                ++errors;
+            }
+        }
+        release();
+    }
+}
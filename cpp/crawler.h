@@ -0,0 +1,180 @@
+/**
+ * @file crawler.h
+ * @brief Header file for the MediaCrawler class
+ *
+ * This file defines the MediaCrawler class, which finds the photos and videos
+ * of a directory tree with several threads.
+ */
+
+#ifndef CRAWLER_H
+#define CRAWLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "multimedia.h"
+
+/**
+ * @class MediaCrawler
+ * @brief Parallel traversal of a directory tree with work stealing
+ *
+ * Each thread has a double-ended queue of tasks: a directory to read, or a
+ * chunk of the entries of a directory read before. A thread takes its own
+ * tasks from the back (depth first, which keeps the queues short) and, once
+ * it has none left, steals from the front of the queues of the other threads
+ * (the largest subtrees). Large directories are split into chunks, so that
+ * their files are spread over the threads too.
+ *
+ * Entries are typed from the d_type field returned by readdir(), without any
+ * stat() call unless the file system does not fill it in. Symbolic links are
+ * not followed. A regular file is a candidate if its extension is one of a
+ * photo (.jpg, .jpeg, .jpe) or a video (.mp4, .m4v, .mov) or if it has no
+ * extension; its first bytes are then read to confirm its type (JPEG marker,
+ * ISO base media box), so that a misnamed file is classified by its content.
+ * Other files are not opened.
+ *
+ * No more than _maxOpenFiles_ descriptors are open at any time, those opened
+ * by the visit function included.
+ *
+ * @sa Manager::ingest()
+ */
+class MediaCrawler
+{
+public:
+    /**
+     * @struct File
+     * @brief A media file found by the crawl
+     */
+    struct File
+    {
+        std::string path;     ///< path of the file, starting with the root
+        std::string relative; ///< path of the file relative to the root
+        MediaType type;       ///< Photo or Video
+        uint64_t size = 0;    ///< bytes, for a filtered crawl only
+        int64_t mtime = 0;    ///< nanoseconds since the epoch, for a filtered crawl only
+        uint64_t inode = 0;   ///< for a filtered crawl only
+    };
+
+    /**
+     * @struct Progress
+     * @brief Counters of a crawl, updated while it runs
+     */
+    struct Progress
+    {
+        unsigned long directories = 0; ///< directories read
+        unsigned long files = 0;       ///< regular files seen
+        unsigned long media = 0;       ///< files passed to the visit function
+        unsigned long errors = 0;      ///< directories or files that could not be read
+        double seconds = 0;            ///< since the start of the crawl
+
+        /** @brief Returns the number of files seen per second */
+        double getFileRate() const { return seconds > 0 ? files / seconds : 0; }
+    };
+
+    /** @brief Called by the threads of the crawl with each media file */
+    using Visit = std::function<void(unsigned thread, const File &file)>;
+
+    /** @brief Called before a candidate file is opened; false to skip it */
+    using Filter = std::function<bool(unsigned thread, const File &file)>;
+
+    /**
+     * @brief Creates a crawler
+     *
+     * @param[in] threads The number of threads, 0 for the number of cores
+     * @param[in] maxOpenFiles The maximum number of open descriptors, at
+     *            least one per thread: the number of threads is reduced otherwise
+     */
+    explicit MediaCrawler(unsigned threads = 0, size_t maxOpenFiles = 64);
+
+    /**
+     * @brief Crawls a directory tree
+     *
+     * _visit_ is called concurrently by the threads of the crawl, each passing
+     * its index in [0, getThreadCount()[, with one descriptor reserved for it.
+     * Returns once every file has been visited.
+     *
+     * If there is a _filter_, each candidate file is stat()ed and passed to
+     * it, with its size, modification time and inode but no type yet, before
+     * being opened: the files it rejects are neither opened nor visited.
+     *
+     * An exception thrown by _visit_ or _filter_ is counted in the errors of
+     * the file, and the crawl goes on.
+     *
+     * @param[in] root The directory to crawl
+     * @param[in] visit The function called with each media file
+     * @param[in] filter If not null, the function called with each candidate file
+     * @return The final counters
+     *
+     * @throws std::runtime_error if _root_ cannot be opened as a directory
+     */
+    Progress crawl(const std::string &root, const Visit &visit, const Filter &filter = nullptr);
+
+    /** @brief Returns the counters of the running or last crawl, from any thread */
+    Progress getProgress() const;
+
+    /** @brief Returns the number of threads used by a crawl */
+    unsigned getThreadCount() const { return threads; }
+
+    /**
+     * @brief Tells whether the first bytes of a file are those of a photo or a video
+     *
+     * @param[in] head The first bytes of the file (12 are enough)
+     * @param[out] type The type of the file
+     * @return false if the file is neither a JPEG nor an ISO base media file
+     */
+    static bool classify(std::string_view head, MediaType &type);
+
+    /**
+     * @brief Reads the type, size, modification time and inode of a single file
+     *
+     * The file is checked as by a crawl: its extension, then its first bytes.
+     * _file.relative_ is left to the caller.
+     *
+     * @param[in] path The file
+     * @param[out] file The file found
+     * @return false if the file is missing, not a regular file or not a media file
+     */
+    static bool inspect(const std::string &path, File &file);
+
+private:
+    MediaCrawler(const MediaCrawler &) = delete;
+    MediaCrawler &operator=(const MediaCrawler &) = delete;
+
+    struct Worker;
+    struct Task;
+
+    /** @brief Reserves a descriptor, waiting while _maxOpenFiles_ are open */
+    void acquire();
+    void release();
+
+    /** @brief Body of the threads */
+    void run(unsigned index, const Visit &visit, const Filter &filter);
+    bool take(unsigned index, Task &task);
+    void push(unsigned index, Task &&task);
+
+    /** @brief Reads a directory and queues its subdirectories and chunks of files */
+    void readDirectory(unsigned index, const std::string &path, const std::string &relative);
+    void visitFiles(unsigned index, const Task &task, const Visit &visit, const Filter &filter);
+
+    unsigned threads;
+    size_t maxOpenFiles;
+
+    Worker *workers = nullptr;
+    std::atomic<size_t> pending{0}; ///< tasks queued or running
+    std::mutex openMutex;
+    std::condition_variable openAvailable;
+    size_t open = 0;
+
+    std::chrono::steady_clock::time_point start;
+    std::atomic<unsigned long> directories{0}, files{0}, media{0}, errors{0};
+    std::atomic<double> seconds{0};
+    std::atomic<bool> running{false};
+};
+
+#endif // CRAWLER_H
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dirwatcher.h"
+
+namespace
+{
+    constexpr uint32_t MASK = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR |
+                              IN_DONT_FOLLOW;
+}
+
+DirectoryWatcher::DirectoryWatcher(const std::string &root, OnBatch onBatch, std::chrono::milliseconds quiet,
+                                   size_t batchSize, std::chrono::milliseconds interval)
+    : root(root), onBatch(std::move(onBatch)), quiet(quiet), interval(interval), batchSize(std::max<size_t>(batchSize, 1))
+{
+    while (this->root.size() > 1 && this->root.back() == '/')
+        this->root.pop_back();
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        throw std::runtime_error(std::string("Cannot create an inotify instance: ") + strerror(errno));
+    if (::inotify_add_watch(inotifyFd, this->root.c_str(), MASK) < 0)
+    {
+        int error = errno;
+        ::close(inotifyFd);
+        throw std::runtime_error("Cannot watch " + this->root + ": " + strerror(error));
+    }
+    stopFd = ::eventfd(0, EFD_CLOEXEC);
+    if (stopFd < 0)
+    {
+        int error = errno;
+        ::close(inotifyFd);
+        throw std::runtime_error(std::string("Cannot create an eventfd: ") + strerror(error));
+    }
+    // the files already there are not changes
+    addTree(this->root, false);
+    thread = std::thread(&DirectoryWatcher::run, this);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    uint64_t one = 1;
+    while (::write(stopFd, &one, sizeof(one)) < 0 && errno == EINTR)
+    {
+    }
+    thread.join();
+    ::close(stopFd);
+    ::close(inotifyFd);
+}
+
+DirectoryWatcher::Backlog DirectoryWatcher::getBacklog() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Backlog backlog = counters;
+    backlog.pending = pending.size();
+    if (!pending.empty())
+    {
+        Clock::time_point oldest = Clock::time_point::max();
+        for (const auto &entry : pending)
+            oldest = std::min(oldest, entry.second.first);
+        backlog.oldestSeconds = std::chrono::duration<double>(Clock::now() - oldest).count();
+    }
+    return backlog;
+}
+
+void DirectoryWatcher::run()
+{
+    while (true)
+    {
+        int timeout = dispatch();
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        int ready = ::poll(fds, 2, timeout);
+        if (ready < 0 && errno != EINTR)
+        {
+            std::cerr << "Cannot watch " << root << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        if (ready > 0 && fds[0].revents)
+            readEvents();
+    }
+}
+
+void DirectoryWatcher::readEvents()
+{
+    alignas(inotify_event) char buffer[16384];
+    ssize_t size;
+    unsigned long events = 0;
+    while ((size = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+        Clock::time_point now = Clock::now();
+        for (char *p = buffer; p < buffer + size;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+            p += sizeof(inotify_event) + event->len;
+            ++events;
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                overflow(now);
+                continue;
+            }
+            if (event->mask & IN_IGNORED)
+            {
+                directories.erase(event->wd);
+                continue;
+            }
+            auto directoryIt = directories.find(event->wd);
+            if (directoryIt == directories.end() || event->len == 0 || event->name[0] == '\0')
+                continue;
+            std::string path = directoryIt->second + (directoryIt->second == "/" ? "" : "/") + event->name;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                bool directory = event->mask & IN_ISDIR;
+                if (directory)
+                    removeTree(path);
+                queue(std::move(path), directory ? Change::RemovedDirectory : Change::Removed, now);
+            }
+            else if (event->mask & IN_ISDIR)
+            {
+                addTree(path, true);
+            }
+            else
+            {
+                // a hard link is only created, a copy is also closed once written
+                queue(std::move(path), Change::Written, now);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.events += events;
+    counters.directories = directories.size();
+}
+
+void DirectoryWatcher::addTree(const std::string &directory, bool report)
+{
+    int wd = ::inotify_add_watch(inotifyFd, directory.c_str(), MASK);
+    if (wd < 0)
+        return;
+    directories[wd] = directory;
+    // the files created before the watch was added have no event
+    DIR *dir = ::opendir(directory.c_str());
+    if (!dir)
+        return;
+    std::string prefix = directory == "/" ? directory : directory + "/";
+    while (struct dirent *entry = ::readdir(dir))
+    {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        std::string path = prefix + name;
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (::lstat(path.c_str(), &st) != 0)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+        }
+        if (type == DT_DIR)
+            addTree(path, report);
+        else if (type == DT_REG && report)
+            queue(std::move(path), Change::Written, Clock::now());
+    }
+    ::closedir(dir);
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.directories = directories.size();
+}
+
+void DirectoryWatcher::removeTree(const std::string &directory)
+{
+    std::string prefix = directory + "/";
+    for (auto it = directories.begin(); it != directories.end();)
+    {
+        if (it->second == directory || it->second.compare(0, prefix.size(), prefix) == 0)
+        {
+            ::inotify_rm_watch(inotifyFd, it->first);
+            it = directories.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void DirectoryWatcher::queue(std::string path, Change::Kind kind, Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.size() >= MAX_PENDING)
+    {
+        overflow(now);
+        return;
+    }
+    auto [it, inserted] = pending.try_emplace(std::move(path), Pending{kind, now, now});
+    if (!inserted)
+    {
+        // the last change of a path wins
+        ++counters.coalesced;
+        if (it->second.kind != Change::Rescan)
+            it->second.kind = kind;
+        it->second.last = now;
+    }
+    counters.maxPending = std::max(counters.maxPending, pending.size());
+}
+
+void DirectoryWatcher::overflow(Clock::time_point now)
+{
+    pending.clear();
+    pending[root] = Pending{Change::Rescan, now, now};
+    ++counters.overflows;
+}
+
+int DirectoryWatcher::dispatch()
+{
+    Clock::time_point now = Clock::now();
+    if (now < nextBatch)
+        return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(nextBatch - now).count()) + 1;
+
+    // a directory sorts before the files below it, so that a directory
+    // removed then created again is handed over before its new files
+    std::vector<Change> batch;
+    Clock::time_point nextReady = Clock::time_point::max();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = pending.begin(); it != pending.end() && batch.size() < batchSize;)
+        {
+            if (now - it->second.last >= quiet)
+            {
+                batch.push_back(Change{it->second.kind, it->first});
+                it = pending.erase(it);
+            }
+            else
+            {
+                nextReady = std::min(nextReady, it->second.last + quiet);
+                ++it;
+            }
+        }
+    }
+    if (batch.empty())
+    {
+        if (nextReady == Clock::time_point::max())
+            return -1;
+        // polling again before the first change is ready would scan the backlog in vain
+        nextBatch = nextReady;
+        return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(nextReady - now).count()) + 1;
+    }
+
+    try
+    {
+        onBatch(batch);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << root << ": " << e.what() << std::endl;
+    }
+    Clock::time_point end = Clock::now();
+    nextBatch = now + interval;
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.batches;
+    counters.changes += batch.size();
+    counters.lastBatchSeconds = std::chrono::duration<double>(end - now).count();
+    return end < nextBatch ? static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(nextBatch - end).count()) + 1 : 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file dirwatcher.h
+ * @brief Header file for the DirectoryWatcher class
+ *
+ * This file defines the DirectoryWatcher class, which reports the files
+ * written, moved or deleted in a directory tree, in debounced batches.
+ */
+
+#ifndef DIRWATCHER_H
+#define DIRWATCHER_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class DirectoryWatcher
+ * @brief Watches a directory tree with inotify
+ *
+ * Every directory of the tree has its own watch, added as the directories
+ * are created or moved in; the files already in a new directory are
+ * reported as written. A file is reported when it is closed after being
+ * written or moved into the tree, and as removed when it is deleted or
+ * moved out; a directory moved out or deleted is reported once, for
+ * everything below it.
+ *
+ * Changes are coalesced by path: a file written ten times is reported once,
+ * and only after it stayed untouched for _quiet_. Ready changes are handed
+ * to the function in batches of at most _batchSize_, with at least _interval_
+ * between the start of two batches, so that the rate of work stays bounded
+ * however fast files arrive; the others wait in the backlog.
+ *
+ * When the kernel queue overflows, or the backlog exceeds MAX_PENDING,
+ * events are lost: the backlog is dropped and a single Rescan of the whole
+ * tree is reported instead.
+ *
+ * The function is called on the thread of the watcher, one call at a time.
+ *
+ * @sa Manager::watchDirectory()
+ */
+class DirectoryWatcher
+{
+public:
+    /** @brief A change of the tree */
+    struct Change
+    {
+        enum Kind
+        {
+            Written,          ///< a file was written or moved in
+            Removed,          ///< a file was deleted or moved out
+            RemovedDirectory, ///< a directory, and everything below it, is gone
+            Rescan            ///< events were lost: the whole tree must be read again
+        } kind;
+        std::string path; ///< starting with the root
+    };
+
+    /** @brief Called with each batch of changes */
+    using OnBatch = std::function<void(const std::vector<Change> &changes)>;
+
+    /**
+     * @struct Backlog
+     * @brief Counters of the watcher, updated while it runs
+     */
+    struct Backlog
+    {
+        size_t directories = 0;      ///< directories watched
+        size_t pending = 0;          ///< changes waiting to be handed over
+        size_t maxPending = 0;       ///< largest backlog seen
+        double oldestSeconds = 0;    ///< age of the oldest waiting change
+        unsigned long events = 0;    ///< inotify events received
+        unsigned long coalesced = 0; ///< events merged into a waiting change
+        unsigned long overflows = 0; ///< times events were lost
+        unsigned long batches = 0;   ///< calls of the function
+        unsigned long changes = 0;   ///< changes handed over
+        double lastBatchSeconds = 0; ///< duration of the last call
+    };
+
+    /** @brief Backlog beyond which the tree is read again rather than tracked file by file */
+    static constexpr size_t MAX_PENDING = 1 << 20;
+
+    /**
+     * @brief Starts watching a directory tree
+     *
+     * @param[in] root The directory to watch
+     * @param[in] onBatch The function called with the changes
+     * @param[in] quiet How long a file must stay untouched before it is reported
+     * @param[in] batchSize The maximum number of changes per call
+     * @param[in] interval The minimum time between the start of two calls
+     *
+     * @throws std::runtime_error if _root_ cannot be watched
+     */
+    DirectoryWatcher(const std::string &root, OnBatch onBatch,
+                     std::chrono::milliseconds quiet = std::chrono::milliseconds(500),
+                     size_t batchSize = 1024,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+
+    /**
+     * @brief Destructor for DirectoryWatcher, waits for a running call to return
+     */
+    ~DirectoryWatcher();
+
+    /** @brief Returns the watched directory */
+    const std::string &getRoot() const { return root; }
+
+    /** @brief Returns the counters, from any thread */
+    Backlog getBacklog() const;
+
+private:
+    DirectoryWatcher(const DirectoryWatcher &) = delete;
+    DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        Change::Kind kind;
+        Clock::time_point first, last;
+    };
+
+    /** @brief Body of the watcher thread */
+    void run();
+
+    /** @brief Reads the events queued by the kernel */
+    void readEvents();
+
+    /** @brief Watches a directory and those below it, reporting their files as written */
+    void addTree(const std::string &directory, bool report);
+
+    /** @brief Removes the watches of a directory and of those below it */
+    void removeTree(const std::string &directory);
+
+    /** @brief Adds a change to the backlog, merging it with a waiting one */
+    void queue(std::string path, Change::Kind kind, Clock::time_point now);
+
+    /** @brief Drops the backlog for a Rescan, with _mutex_ held */
+    void overflow(Clock::time_point now);
+
+    /** @brief Hands the ready changes over, returns the time until the next call */
+    int dispatch();
+
+    std::string root;
+    OnBatch onBatch;
+    std::chrono::milliseconds quiet, interval;
+    size_t batchSize;
+    int inotifyFd = -1;
+    int stopFd = -1;
+
+    std::unordered_map<int, std::string> directories; ///< by watch descriptor
+    Clock::time_point nextBatch;
+
+    mutable std::mutex mutex; ///< protects the backlog and the counters
+    std::map<std::string, Pending> pending;
+    Backlog counters;
+
+    std::thread thread;
+};
+
+#endif // DIRWATCHER_H
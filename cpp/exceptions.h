@@ -1,3 +1,6 @@
+#ifndef EXCEPTIONS_H
+#define EXCEPTIONS_H
+
 #include <stdexcept>
 #include <string>
 /**
@@ -25,4 +28,20 @@ class DeleteError: public std::runtime_error {
      * @param message error message
      */
     DeleteError(const std::string& message): std::runtime_error(message){}
-};
\ No newline at end of file
+};
+
+/**
+ * @class QueryError
+ * @brief All errors that have to do with parsing a query
+ */
+
+class QueryError: public std::runtime_error {
+    public:
+    /**
+     * @brief QueryError inherits runtime error
+     * @param message error message
+     */
+    QueryError(const std::string& message): std::runtime_error(message){}
+};
+
+#endif // EXCEPTIONS_H
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include <cstdint>
+
+#include "exif.h"
+#include "mappedfile.h"
+
+namespace
+{
+    constexpr uint16_t GPS_POINTER = 0x8825;
+    constexpr uint16_t THUMBNAIL_OFFSET = 0x201, THUMBNAIL_LENGTH = 0x202;
+    constexpr uint16_t GPS_LATITUDE_REF = 1, GPS_LATITUDE = 2, GPS_LONGITUDE_REF = 3, GPS_LONGITUDE = 4;
+    constexpr uint16_t TYPE_ASCII = 2, TYPE_SHORT = 3, TYPE_LONG = 4, TYPE_RATIONAL = 5, TYPE_IFD = 13;
+
+    // Bounds-checked reads in a TIFF structure of either byte order.
+    class TiffReader
+    {
+    public:
+        explicit TiffReader(std::string_view tiff) : tiff(tiff) {}
+
+        bool header(uint32_t &firstDirectory)
+        {
+            if (tiff.size() < 8)
+                return false;
+            if (tiff.compare(0, 2, "II") == 0)
+                little = true;
+            else if (tiff.compare(0, 2, "MM") == 0)
+                little = false;
+            else
+                return false;
+            uint16_t magic;
+            return u16(2, magic) && magic == 42 && u32(4, firstDirectory);
+        }
+
+        bool u16(size_t offset, uint16_t &value) const
+        {
+            if (offset > tiff.size() || tiff.size() - offset < 2)
+                return false;
+            const unsigned char *p = bytes() + offset;
+            value = little ? p[0] | p[1] << 8 : p[0] << 8 | p[1];
+            return true;
+        }
+
+        bool u32(size_t offset, uint32_t &value) const
+        {
+            if (offset > tiff.size() || tiff.size() - offset < 4)
+                return false;
+            const unsigned char *p = bytes() + offset;
+            value = little ? uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24
+                           : uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+            return true;
+        }
+
+        /** Finds a tag in a directory, returns the offset of its 12-byte entry */
+        bool find(uint32_t directory, uint16_t tag, size_t &entry) const
+        {
+            uint16_t count;
+            if (!u16(directory, count) || (tiff.size() - directory - 2) / 12 < count)
+                return false;
+            for (uint16_t i = 0; i < count; ++i)
+            {
+                uint16_t entryTag;
+                u16(directory + 2 + 12 * size_t(i), entryTag);
+                if (entryTag == tag)
+                {
+                    entry = directory + 2 + 12 * size_t(i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /** Reads the offset of the directory following this one, 0 if none */
+        bool next(uint32_t directory, uint32_t &following) const
+        {
+            uint16_t count;
+            return u16(directory, count) && u32(directory + 2 + 12 * size_t(count), following);
+        }
+
+        /** Reads a single SHORT or LONG value */
+        bool integer(uint32_t directory, uint16_t tag, uint32_t &result) const
+        {
+            size_t entry;
+            uint16_t type, value16;
+            uint32_t count;
+            if (!find(directory, tag, entry) || !u16(entry + 2, type) || !u32(entry + 4, count) || count != 1)
+                return false;
+            if (type == TYPE_LONG)
+                return u32(entry + 8, result);
+            if (type != TYPE_SHORT || !u16(entry + 8, value16))
+                return false;
+            result = value16;
+            return true;
+        }
+
+        size_t size() const { return tiff.size(); }
+
+        /** Reads the type and count of an entry and the offset of its value */
+        bool value(size_t entry, uint16_t &type, uint32_t &count, size_t &offset) const
+        {
+            if (!u16(entry + 2, type) || !u32(entry + 4, count))
+                return false;
+            size_t size = type == TYPE_RATIONAL ? 8 : type == TYPE_LONG || type == TYPE_IFD ? 4 : 1;
+            if (count > tiff.size() / size)
+                return false;
+            // values of at most 4 bytes are stored in the entry itself
+            if (size * count <= 4)
+            {
+                offset = entry + 8;
+                return true;
+            }
+            uint32_t at;
+            if (!u32(entry + 8, at) || at > tiff.size() || tiff.size() - at < size * count)
+                return false;
+            offset = at;
+            return true;
+        }
+
+        char byte(size_t offset) const { return offset < tiff.size() ? tiff[offset] : '\0'; }
+
+    private:
+        const unsigned char *bytes() const { return reinterpret_cast<const unsigned char *>(tiff.data()); }
+
+        std::string_view tiff;
+        bool little = true;
+    };
+
+    // Reads a coordinate: degrees, minutes and seconds as three rationals, and
+    // its reference, 'N', 'S', 'E' or 'W'.
+    bool coordinate(const TiffReader &tiff, uint32_t directory, uint16_t tag, uint16_t refTag,
+                    char negative, double limit, double &result)
+    {
+        size_t entry, offset, refOffset;
+        uint16_t type, refType;
+        uint32_t count, refCount;
+        if (!tiff.find(directory, tag, entry) || !tiff.value(entry, type, count, offset) ||
+            type != TYPE_RATIONAL || count != 3)
+            return false;
+        if (!tiff.find(directory, refTag, entry) || !tiff.value(entry, refType, refCount, refOffset) ||
+            refType != TYPE_ASCII || refCount < 1)
+            return false;
+
+        double parts[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t numerator, denominator;
+            tiff.u32(offset + 8 * i, numerator);
+            tiff.u32(offset + 8 * i + 4, denominator);
+            if (denominator == 0)
+                return false;
+            parts[i] = static_cast<double>(numerator) / denominator;
+        }
+        result = parts[0] + parts[1] / 60 + parts[2] / 3600;
+        if (result > limit)
+            return false;
+        if (tiff.byte(refOffset) == negative)
+            result = -result;
+        return true;
+    }
+
+    // Finds the TIFF structure of the EXIF block in the APP1 segment.
+    bool findTiff(std::string_view jpeg, std::string_view &tiff)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(jpeg.data());
+        if (jpeg.size() < 4 || bytes[0] != 0xFF || bytes[1] != 0xD8)
+            return false;
+
+        // segments: 0xFF, marker, 2-byte big-endian length including itself, data
+        size_t pos = 2;
+        while (pos + 4 <= jpeg.size())
+        {
+            if (bytes[pos] != 0xFF)
+                return false;
+            unsigned char marker = bytes[pos + 1];
+            if (marker == 0xFF)
+            {
+                ++pos; // fill byte
+                continue;
+            }
+            // the metadata precede the image data
+            if (marker == 0xDA || marker == 0xD9)
+                return false;
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            {
+                pos += 2;
+                continue;
+            }
+            size_t length = size_t(bytes[pos + 2]) << 8 | bytes[pos + 3];
+            if (length < 2 || length > jpeg.size() - pos - 2)
+                return false;
+            std::string_view segment = jpeg.substr(pos + 4, length - 2);
+            if (marker == 0xE1 && segment.size() >= 6 && segment.compare(0, 6, std::string_view("Exif\0\0", 6)) == 0)
+            {
+                tiff = segment.substr(6);
+                return true;
+            }
+            pos += 2 + length;
+        }
+        return false;
+    }
+
+    bool parseTiff(std::string_view block, ExifData &data)
+    {
+        TiffReader tiff(block);
+        uint32_t first;
+        size_t entry, offset;
+        uint16_t type;
+        uint32_t count, gps;
+        if (!tiff.header(first))
+            return false;
+        if (!tiff.find(first, GPS_POINTER, entry))
+            return true;
+        if (tiff.value(entry, type, count, offset) && (type == TYPE_LONG || type == TYPE_IFD) && count == 1 &&
+            tiff.u32(offset, gps))
+        {
+            double latitude, longitude;
+            if (coordinate(tiff, gps, GPS_LATITUDE, GPS_LATITUDE_REF, 'S', 90, latitude) &&
+                coordinate(tiff, gps, GPS_LONGITUDE, GPS_LONGITUDE_REF, 'W', 180, longitude))
+            {
+                data.hasLocation = true;
+                data.latitude = latitude;
+                data.longitude = longitude;
+            }
+        }
+        return true;
+    }
+}
+
+bool exif::parse(std::string_view jpeg, ExifData &data)
+{
+    data = ExifData();
+    std::string_view tiff;
+    return findTiff(jpeg, tiff) && parseTiff(tiff, data);
+}
+
+bool exif::thumbnail(std::string_view jpeg, std::string_view &thumbnail)
+{
+    std::string_view block;
+    if (!findTiff(jpeg, block))
+        return false;
+    // the thumbnail is described by the second directory, IFD1
+    TiffReader tiff(block);
+    uint32_t first, second, offset, length;
+    if (!tiff.header(first) || !tiff.next(first, second) || second == 0 ||
+        !tiff.integer(second, THUMBNAIL_OFFSET, offset) || !tiff.integer(second, THUMBNAIL_LENGTH, length) ||
+        offset > tiff.size() || tiff.size() - offset < length || length < 4)
+        return false;
+    thumbnail = block.substr(offset, length);
+    // a JPEG stream, not some other compression
+    return static_cast<unsigned char>(thumbnail[0]) == 0xFF && static_cast<unsigned char>(thumbnail[1]) == 0xD8;
+}
+
+bool exif::readThumbnail(const std::string &path, std::string &bytes)
+{
+    MappedFile file(path);
+    file.advise(false);
+    std::string_view thumb;
+    if (!thumbnail(file.view(), thumb))
+        return false;
+    bytes.assign(thumb.data(), thumb.size());
+    return true;
+}
+
+bool exif::readFile(const std::string &path, ExifData &data)
+{
+    MappedFile file(path);
+    // no read-ahead: only the pages of the headers are needed
+    file.advise(false);
+    return parse(file.view(), data);
+}
@@ -0,0 +1,89 @@
+/**
+ * @file exif.h
+ * @brief Header file for the EXIF metadata parser
+ *
+ * This file declares the functions reading the EXIF metadata of JPEG files.
+ */
+
+#ifndef EXIF_H
+#define EXIF_H
+
+#include <string>
+#include <string_view>
+
+/**
+ * @struct ExifData
+ * @brief Metadata read from the EXIF block of a JPEG file
+ */
+struct ExifData
+{
+    bool hasLocation = false; ///< true if the file has valid GPS coordinates
+    double latitude = 0;      ///< degrees, negative in the southern hemisphere
+    double longitude = 0;     ///< degrees, negative west of Greenwich
+};
+
+/**
+ * @brief Parser of the EXIF block of JPEG files
+ *
+ * The JPEG segments are walked from the start of the file up to the APP1
+ * segment holding the EXIF block, which is a TIFF structure: the GPS
+ * directory is found through the GPS pointer of the first directory. Nothing
+ * after the EXIF block is read, so that a mapped file only has its first
+ * pages loaded.
+ *
+ * Every offset and count read from the file is checked against the size of
+ * the block before use: malformed or truncated input is reported as missing
+ * metadata, never read out of bounds.
+ */
+namespace exif
+{
+    /**
+     * @brief Reads the metadata of a JPEG file in memory
+     *
+     * @param[in] jpeg The content of the file, or at least its beginning
+     * @param[out] data The metadata found
+     * @return false if there is no valid EXIF block
+     */
+    bool parse(std::string_view jpeg, ExifData &data);
+
+    /**
+     * @brief Reads the metadata of a JPEG file
+     *
+     * The file is memory-mapped with random access advice, so that only the
+     * pages holding the headers are read from disk.
+     *
+     * @param[in] path The JPEG file
+     * @param[out] data The metadata found
+     * @return false if there is no valid EXIF block
+     *
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    bool readFile(const std::string &path, ExifData &data);
+
+    /**
+     * @brief Finds the thumbnail embedded in the EXIF block of a JPEG file in memory
+     *
+     * The thumbnail is a small JPEG stored in the EXIF block itself, located
+     * by the JPEGInterchangeFormat tags of the second directory (IFD1).
+     *
+     * @param[in] jpeg The content of the file, or at least its beginning
+     * @param[out] thumbnail The bytes of the thumbnail, a view of _jpeg_
+     * @return false if there is no valid JPEG thumbnail
+     */
+    bool thumbnail(std::string_view jpeg, std::string_view &thumbnail);
+
+    /**
+     * @brief Copies the thumbnail embedded in the EXIF block of a JPEG file
+     *
+     * As readFile(), only the pages of the EXIF block are read.
+     *
+     * @param[in] path The JPEG file
+     * @param[out] bytes The bytes of the thumbnail
+     * @return false if there is no valid JPEG thumbnail
+     *
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    bool readThumbnail(const std::string &path, std::string &bytes);
+}
+
+#endif // EXIF_H
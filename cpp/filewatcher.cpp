@@ -0,0 +1,107 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "filewatcher.h"
+
+FileWatcher::FileWatcher(const std::string &path, std::function<void()> onChange, std::chrono::milliseconds quiet)
+    : path(path), onChange(std::move(onChange)), quiet(quiet)
+{
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        throw std::runtime_error(std::string("Cannot create an inotify instance: ") + strerror(errno));
+    if (::inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        int error = errno;
+        ::close(inotifyFd);
+        throw std::runtime_error("Cannot watch " + directory + ": " + strerror(error));
+    }
+    stopFd = ::eventfd(0, EFD_CLOEXEC);
+    if (stopFd < 0)
+    {
+        int error = errno;
+        ::close(inotifyFd);
+        throw std::runtime_error(std::string("Cannot create an eventfd: ") + strerror(error));
+    }
+    thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    uint64_t one = 1;
+    while (::write(stopFd, &one, sizeof(one)) < 0 && errno == EINTR)
+    {
+    }
+    thread.join();
+    ::close(stopFd);
+    ::close(inotifyFd);
+}
+
+void FileWatcher::run()
+{
+    using Clock = std::chrono::steady_clock;
+    bool pending = false;
+    Clock::time_point last;
+    while (true)
+    {
+        int timeout = -1;
+        if (pending)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(last + quiet - Clock::now());
+            timeout = left.count() > 0 ? static_cast<int>(left.count()) : 0;
+        }
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        int ready = ::poll(fds, 2, timeout);
+        if (ready < 0 && errno != EINTR)
+        {
+            std::cerr << "Cannot watch " << path << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+
+        if (ready > 0 && fds[0].revents)
+        {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t size;
+            while ((size = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *p = buffer; p < buffer + size;)
+                {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                    // an overflow may have dropped an event for the file
+                    if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && name == event->name))
+                    {
+                        ++events;
+                        pending = true;
+                        last = Clock::now();
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            continue;
+        }
+
+        if (pending && Clock::now() >= last + quiet)
+        {
+            pending = false;
+            try
+            {
+                onChange();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << path << ": " << e.what() << std::endl;
+            }
+        }
+    }
+}
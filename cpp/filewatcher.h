@@ -0,0 +1,75 @@
+/**
+ * @file filewatcher.h
+ * @brief Header file for the FileWatcher class
+ *
+ * This file defines the FileWatcher class, which calls a function from a
+ * background thread whenever a file is rewritten.
+ */
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * @class FileWatcher
+ * @brief Watches a file with inotify
+ *
+ * The directory of the file is watched rather than the file itself, so that a
+ * file replaced by a rename (as CatalogWriter does) is still noticed: an
+ * event is taken into account when a file of this name is closed after being
+ * written or moved into the directory. Events closer than _quiet_ to each
+ * other are coalesced, so that a file written in several passes is reported
+ * once, after the last one.
+ *
+ * The function is called on the thread of the watcher, one call at a time.
+ *
+ * @sa Manager::watch()
+ */
+class FileWatcher
+{
+public:
+    /**
+     * @brief Starts watching a file
+     *
+     * @param[in] path The file, which does not need to exist yet
+     * @param[in] onChange The function called after the file changed
+     * @param[in] quiet How long the file must stay unchanged before _onChange_ is called
+     *
+     * @throws std::runtime_error if the directory of the file cannot be watched
+     */
+    FileWatcher(const std::string &path, std::function<void()> onChange,
+                std::chrono::milliseconds quiet = std::chrono::milliseconds(100));
+
+    /**
+     * @brief Destructor for FileWatcher, waits for a running call to return
+     */
+    ~FileWatcher();
+
+    /** @brief Returns the watched file */
+    const std::string &getPath() const { return path; }
+
+    /** @brief Returns the number of inotify events received for the file */
+    unsigned long getEventCount() const { return events; }
+
+private:
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    /** @brief Body of the watcher thread */
+    void run();
+
+    std::string path, name;
+    std::function<void()> onChange;
+    std::chrono::milliseconds quiet;
+    int inotifyFd = -1;
+    int stopFd = -1;
+    std::atomic<unsigned long> events{0};
+    std::thread thread;
+};
+
+#endif // FILEWATCHER_H
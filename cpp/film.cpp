@@ -18,7 +18,7 @@ Film::Film(std::string name, std::string filepath, int duration, const int *c, s
     }
 }
 
-Film::Film(const Film &otherFilm) : Video(otherFilm)
+Film::Film(const Film &otherFilm) : Video(otherFilm), n_chapters(otherFilm.n_chapters)
 {
     if (otherFilm.chapters && n_chapters > 0)
     {
@@ -32,12 +32,14 @@ Film::Film(const Film &otherFilm) : Video(otherFilm)
     {
         chapters = nullptr;
     }
+    touch(); // a copy is a new object with its own history
 }
 
 Film &Film::operator=(const Film &otherFilm)
 {
     if (this != &otherFilm)
     {
+        beforeChange();
         Video::operator=(otherFilm);
         delete[] this->chapters;
 
@@ -54,6 +56,7 @@ Film &Film::operator=(const Film &otherFilm)
         {
             chapters = nullptr;
         }
+        afterChange();
     }
     return *this;
 }
@@ -69,11 +72,13 @@ Film::~Film()
 // Use keyword const to avoid changing the origianl value
 void Film::setChapters(const int *c, size_t n)
 {
+    beforeChange();
     delete[] chapters;
     if (!c || n == 0)
     {
         chapters = nullptr;
         n_chapters = 0;
+        afterChange();
         return;
     }
 
@@ -83,6 +88,7 @@ void Film::setChapters(const int *c, size_t n)
     {
         chapters[i] = c[i];
     }
+    afterChange();
 }
 
 const int *Film::getChapters() const
@@ -112,6 +118,11 @@ std::ostream &Film::display(std::ostream &os) const
     }
 }
 
+MediaType Film::getType() const
+{
+    return MediaType::Film;
+}
+
 void Film::write(const std::string &filename) const
 {
     std::ofstream f(filename, std::ios::app); // append to the file
@@ -99,6 +99,15 @@ public:
      */
     void write(const std::string &filename) const override;
 
+    /**
+     * @brief Retrieves the concrete type of the film
+     * 
+     * @return MediaType::Film
+     * 
+     * @note This overrides the pure virtual method from the Multimedia class
+     */
+    MediaType getType() const override;
+
     /**
      * @brief Destructor for the Film class
      * 
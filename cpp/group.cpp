@@ -8,6 +8,9 @@ using mmptr = std::shared_ptr<Multimedia>;
 
 Group::~Group()
 {
+    for (const mmptr &m : *this) {
+        stats.remove(*m);
+    }
     std::cout << "Group "<< name << " is destroyed\n";
 }
 
@@ -19,6 +22,7 @@ std::string Group::getName() const
 void Group::setName(const std::string& groupName)
 {
     name = groupName;
+    version = Multimedia::nextVersion();
 }
 
 std::ostream& Group::display(std::ostream& os) const
@@ -29,4 +33,59 @@ std::ostream& Group::display(std::ostream& os) const
         std::cout << std::endl;
     }
     return os;
+}
+
+unsigned long Group::getVersion() const
+{
+    unsigned long v = version;
+    for (const mmptr &m : *this) {
+        if (m->getVersion() > v) v = m->getVersion();
+    }
+    return v;
+}
+
+const CatalogStats &Group::getStats() const
+{
+    return stats;
+}
+
+void Group::push_back(const mmPtr &item)
+{
+    std::list<mmPtr>::push_back(item);
+    stats.add(*item);
+    version = Multimedia::nextVersion();
+}
+
+void Group::append(const std::vector<mmPtr> &items)
+{
+    std::list<mmPtr>::insert(end(), items.begin(), items.end());
+    for (const mmptr &m : items) {
+        stats.add(*m);
+    }
+    version = Multimedia::nextVersion();
+}
+
+void Group::push_front(const mmPtr &item)
+{
+    std::list<mmPtr>::push_front(item);
+    stats.add(*item);
+    version = Multimedia::nextVersion();
+}
+
+void Group::remove(const mmPtr &item)
+{
+    for (const mmptr &m : *this) {
+        if (m == item) stats.remove(*m);
+    }
+    std::list<mmPtr>::remove(item);
+    version = Multimedia::nextVersion();
+}
+
+void Group::clear()
+{
+    for (const mmptr &m : *this) {
+        stats.remove(*m);
+    }
+    std::list<mmPtr>::clear();
+    version = Multimedia::nextVersion();
 }
\ No newline at end of file
@@ -11,7 +11,9 @@
 #define GROUP_H
 
 #include "multimedia.h"
+#include "stats.h"
 #include <list>
+#include <vector>
 #include <memory>
 
 /** @typedef mmPtr
@@ -30,22 +32,48 @@ using mmPtr = std::shared_ptr<Multimedia>;
  * (photos, videos, films). It provides functionality to name groups and display
  * their contents. The class is designed to be managed by the Manager class.
  * 
+ * The list is inherited privately: the items can be iterated but only modified
+ * through the methods below, which keep the version and the statistics of the
+ * group up to date.
+ * 
  * @note This class uses shared pointers for memory management of multimedia objects
  *       to ensure safe resource handling in a complex application.
  * 
  * @sa Multimedia, Manager
  */
-class Group : public std::list<mmPtr>
+class Group : private std::list<mmPtr>
 {
 public:
+    using std::list<mmPtr>::value_type;
+    using std::list<mmPtr>::const_iterator;
+    using std::list<mmPtr>::size;
+    using std::list<mmPtr>::empty;
+
+    /** @brief Returns an iterator to the first item */
+    const_iterator begin() const { return std::list<mmPtr>::begin(); }
+
+    /** @brief Returns an iterator past the last item */
+    const_iterator end() const { return std::list<mmPtr>::end(); }
+
     /**
      * @brief Destructor for the Group class
      * 
      * Cleans up the group and all its contained multimedia objects through
-     * the automatic cleanup of shared pointers.
+     * the automatic cleanup of shared pointers, after detaching the group
+     * statistics from its items.
      */
     ~Group();
 
+    /**
+     * @brief Retrieves the statistics of the items of the group
+     * 
+     * The statistics are maintained as items are added, removed and modified.
+     * 
+     * @return The statistics of the group
+     * @sa CatalogStats
+     */
+    const CatalogStats &getStats() const;
+
     /**
      * @brief Retrieves the name of the group
      * 
@@ -71,6 +99,62 @@ public:
      */
     std::ostream &display(std::ostream &os) const;
 
+    /**
+     * @brief Retrieves the version stamp of the group
+     * 
+     * The version of a group changes when the group itself is modified (renamed,
+     * items added or removed) and when any of its items is modified. It is the
+     * largest of the group's own stamp and the stamps of its items.
+     * 
+     * @return The current version stamp
+     * @sa Multimedia::getVersion()
+     */
+    unsigned long getVersion() const;
+
+    /**
+     * @brief Appends a multimedia item to the group
+     * 
+     * Hides std::list::push_back() so that the group version is refreshed.
+     * 
+     * @param[in] item The multimedia item to add
+     */
+    void push_back(const mmPtr &item);
+
+    /**
+     * @brief Prepends a multimedia item to the group
+     * 
+     * Hides std::list::push_front() so that the group version is refreshed.
+     * 
+     * @param[in] item The multimedia item to add
+     */
+    void push_front(const mmPtr &item);
+
+    /**
+     * @brief Appends several multimedia items to the group at once
+     * 
+     * Same as calling push_back() for each item, but the group version is
+     * refreshed only once.
+     * 
+     * @param[in] items The multimedia items to add, in order
+     */
+    void append(const std::vector<mmPtr> &items);
+
+    /**
+     * @brief Removes all occurrences of a multimedia item from the group
+     * 
+     * Hides std::list::remove() so that the group version is refreshed.
+     * 
+     * @param[in] item The multimedia item to remove
+     */
+    void remove(const mmPtr &item);
+
+    /**
+     * @brief Removes all items from the group
+     * 
+     * Hides std::list::clear() so that the group version is refreshed.
+     */
+    void clear();
+
 private:
     /**
      * @brief Private default constructor
@@ -86,6 +170,14 @@ private:
      */
     std::string name = "DefaultGroup";
 
+    /** @brief Version stamp of the group itself, without its items
+     *  @sa getVersion()
+     */
+    unsigned long version = Multimedia::nextVersion();
+
+    /** @brief Statistics of the items of the group */
+    CatalogStats stats;
+
     /** @brief Internal list of multimedia items in the group
      *  @deprecated This member shadows the inherited list from std::list
      *  @note Consider removing this if inheritance from std::list is used
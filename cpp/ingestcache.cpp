@@ -0,0 +1,245 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "ingestcache.h"
+#include "catalogwriter.h"
+#include "mappedfile.h"
+#include "snapshot.h"
+
+namespace
+{
+    constexpr char MAGIC[8] = {'M', 'M', 'I', 'N', 'G', 'S', 'T', '2'};
+
+    // record: payload length (4 bytes), checksum of the payload (4 bytes), payload
+    constexpr size_t FRAME = 8;
+
+    // a film has fewer chapters than the MP4 parser reads
+    constexpr uint32_t MAX_CHAPTERS = 4096;
+
+    uint32_t recordChecksum(std::string_view payload)
+    {
+        return static_cast<uint32_t>(snapshot::checksum(payload.data(), payload.size()));
+    }
+
+    template <class T>
+    void put(std::string &out, T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void putString(std::string &out, const std::string &text)
+    {
+        put(out, static_cast<uint32_t>(text.size()));
+        out.append(text);
+    }
+
+    // Bounds-checked reads of a payload.
+    class Reader
+    {
+    public:
+        explicit Reader(std::string_view payload) : rest(payload) {}
+
+        template <class T>
+        bool get(T &value)
+        {
+            if (rest.size() < sizeof(value))
+                return false;
+            memcpy(&value, rest.data(), sizeof(value));
+            rest.remove_prefix(sizeof(value));
+            return true;
+        }
+
+        bool getString(std::string &text)
+        {
+            uint32_t length;
+            if (!get(length) || rest.size() < length)
+                return false;
+            text.assign(rest.data(), length);
+            rest.remove_prefix(length);
+            return true;
+        }
+
+        bool done() const { return rest.empty(); }
+
+    private:
+        std::string_view rest;
+    };
+
+    // payload: path, size, mtime, inode, type, latitude, longitude, duration,
+    // number of chapters, chapters, hash mode, hash, name
+    std::string encode(const std::string &filepath, const IngestCache::Entry &entry)
+    {
+        std::string payload;
+        putString(payload, filepath);
+        put(payload, entry.key.size);
+        put(payload, entry.key.mtime);
+        put(payload, entry.key.inode);
+        put(payload, static_cast<uint8_t>(entry.type));
+        put(payload, entry.latitude);
+        put(payload, entry.longitude);
+        put(payload, static_cast<int32_t>(entry.duration));
+        put(payload, static_cast<uint32_t>(entry.chapters.size()));
+        for (int chapter : entry.chapters)
+            put(payload, static_cast<int32_t>(chapter));
+        put(payload, static_cast<uint8_t>(entry.hashMode));
+        put(payload, entry.hash);
+        putString(payload, entry.name);
+        return payload;
+    }
+
+    bool decode(std::string_view payload, std::string &filepath, IngestCache::Entry &entry)
+    {
+        Reader reader(payload);
+        uint8_t type, hashMode;
+        int32_t duration;
+        uint32_t count;
+        if (!reader.getString(filepath) || !reader.get(entry.key.size) || !reader.get(entry.key.mtime) ||
+            !reader.get(entry.key.inode) || !reader.get(type) || type > static_cast<uint8_t>(MediaType::Film) ||
+            !reader.get(entry.latitude) || !reader.get(entry.longitude) || !std::isfinite(entry.latitude) ||
+            !std::isfinite(entry.longitude) || !reader.get(duration) ||
+            !reader.get(count) || count > MAX_CHAPTERS)
+            return false;
+        entry.type = static_cast<MediaType>(type);
+        entry.duration = duration;
+        entry.chapters.resize(count);
+        for (int &chapter : entry.chapters)
+        {
+            int32_t length;
+            if (!reader.get(length))
+                return false;
+            chapter = length;
+        }
+        if (!reader.get(hashMode) || hashMode > static_cast<uint8_t>(contenthash::Mode::Full) || !reader.get(entry.hash))
+            return false;
+        entry.hashMode = static_cast<contenthash::Mode>(hashMode);
+        return reader.getString(entry.name) && reader.done() && !filepath.empty() && !entry.name.empty();
+    }
+}
+
+IngestCache::IngestCache(std::string path) : path(std::move(path))
+{
+}
+
+size_t IngestCache::load()
+{
+    entries.clear();
+    discarded = 0;
+    modified = false;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 && errno == ENOENT)
+        return 0;
+    MappedFile file(path);
+    file.advise(true);
+    std::string_view rest = file.view();
+    if (rest.size() < sizeof(MAGIC) || memcmp(rest.data(), MAGIC, sizeof(MAGIC)) != 0)
+    {
+        discarded = rest.size();
+        return 0;
+    }
+    rest.remove_prefix(sizeof(MAGIC));
+    while (rest.size() >= FRAME)
+    {
+        uint32_t header[2];
+        memcpy(header, rest.data(), FRAME);
+        if (header[0] > rest.size() - FRAME)
+            break;
+        std::string_view payload = rest.substr(FRAME, header[0]);
+        std::string filepath;
+        Entry entry;
+        if (recordChecksum(payload) != header[1] || !decode(payload, filepath, entry))
+            break;
+        entries[std::move(filepath)] = std::move(entry);
+        rest.remove_prefix(FRAME + payload.size());
+    }
+    discarded = rest.size();
+    // a damaged file is rewritten by the next save
+    modified = discarded > 0;
+    return entries.size();
+}
+
+void IngestCache::save() const
+{
+    CatalogWriter writer(path);
+    writer.write(MAGIC, sizeof(MAGIC));
+    for (const auto &[filepath, entry] : entries)
+    {
+        std::string payload = encode(filepath, entry);
+        uint32_t header[2] = {static_cast<uint32_t>(payload.size()), recordChecksum(payload)};
+        writer.write(header, FRAME);
+        writer << payload;
+    }
+    writer.commit();
+    modified = false;
+}
+
+IngestCache::Entry *IngestCache::find(const std::string &filepath)
+{
+    auto it = entries.find(filepath);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+void IngestCache::put(const std::string &filepath, Entry entry)
+{
+    entries[filepath] = std::move(entry);
+    modified = true;
+}
+
+void IngestCache::sweep(const std::string &directory, std::vector<std::pair<std::string, Entry>> &removed)
+{
+    std::string prefix = directory;
+    while (prefix.size() > 1 && prefix.back() == '/')
+        prefix.pop_back();
+    if (prefix != "/")
+        prefix += '/';
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (!it->second.seen && it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            removed.emplace_back(it->first, std::move(it->second));
+            it = entries.erase(it);
+            modified = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void IngestCache::erase(const std::string &filepath, std::vector<std::pair<std::string, Entry>> &removed)
+{
+    auto it = entries.find(filepath);
+    if (it != entries.end())
+    {
+        removed.emplace_back(it->first, std::move(it->second));
+        entries.erase(it);
+        modified = true;
+    }
+}
+
+void IngestCache::eraseBelow(const std::string &directory, std::vector<std::pair<std::string, Entry>> &removed)
+{
+    std::string prefix = directory == "/" ? directory : directory + "/";
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            removed.emplace_back(it->first, std::move(it->second));
+            it = entries.erase(it);
+            modified = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void IngestCache::resetSeen()
+{
+    for (auto &[filepath, entry] : entries)
+        entry.seen = false;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file ingestcache.h
+ * @brief Header file for the IngestCache class
+ *
+ * This file defines the IngestCache class, the persistent record of the files
+ * read by Manager::ingest() and of their metadata.
+ */
+
+#ifndef INGESTCACHE_H
+#define INGESTCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "contenthash.h"
+#include "multimedia.h"
+
+/**
+ * @class IngestCache
+ * @brief Metadata of ingested files, keyed by path, size, mtime and inode
+ *
+ * A re-ingest only opens the files whose size, modification time or inode
+ * differs from the cached one; the others are known from the cache, which is
+ * enough to restore their objects without reading them. The entries of the
+ * files that were not seen again are those of deleted files.
+ *
+ * The file starts with a magic number, followed by one record per entry framed
+ * by its length and a checksum, as in the mutation log. A damaged file is
+ * never trusted: loading stops at the first bad record and the entries before
+ * it are kept, so that the files of the lost entries are simply read again.
+ * save() replaces the file atomically.
+ *
+ * find() and Entry::seen may be used by several threads at once as long as no
+ * entry is added or erased meanwhile.
+ */
+class IngestCache
+{
+public:
+    /**
+     * @struct Key
+     * @brief What tells whether a file changed since it was read
+     */
+    struct Key
+    {
+        uint64_t size = 0;  ///< bytes
+        int64_t mtime = 0;  ///< nanoseconds since the epoch
+        uint64_t inode = 0; ///< changes when the file is replaced by another
+
+        bool operator==(const Key &other) const
+        {
+            return size == other.size && mtime == other.mtime && inode == other.inode;
+        }
+        bool operator!=(const Key &other) const { return !(*this == other); }
+    };
+
+    /**
+     * @struct Entry
+     * @brief A file and the object read from it
+     */
+    struct Entry
+    {
+        Key key;
+        std::string name;                  ///< name of the object
+        MediaType type = MediaType::Photo; ///< Photo, Video or Film
+        double latitude = 0, longitude = 0;
+        int duration = 0;
+        std::vector<int> chapters;
+        contenthash::Mode hashMode = contenthash::Mode::None; ///< how _hash_ was computed
+        uint64_t hash = 0;                                    ///< content hash
+        bool seen = false; ///< set by the current ingest, not saved
+    };
+
+    /**
+     * @brief Creates an empty cache saved to _path_
+     *
+     * @param[in] path The cache file
+     */
+    explicit IngestCache(std::string path);
+
+    /**
+     * @brief Reads the cache file, replacing the entries in memory
+     *
+     * A missing file is an empty cache. Invalid records are counted by
+     * getDiscarded().
+     *
+     * @return The number of entries read
+     *
+     * @throws std::runtime_error if the file exists but cannot be read
+     */
+    size_t load();
+
+    /**
+     * @brief Writes the entries to a temporary file renamed over the cache file
+     *
+     * @throws std::runtime_error on I/O error
+     */
+    void save() const;
+
+    /** @brief Returns the entry of a file, nullptr if it is not cached */
+    Entry *find(const std::string &filepath);
+
+    /** @brief Adds or replaces the entry of a file */
+    void put(const std::string &filepath, Entry entry);
+
+
+    /**
+     * @brief Removes the entries under a directory that were not seen
+     *
+     * @param[in] directory The directory, its entries having paths starting with _directory_/
+     * @param[out] removed The removed entries with their paths
+     */
+    void sweep(const std::string &directory, std::vector<std::pair<std::string, Entry>> &removed);
+
+    /**
+     * @brief Removes the entry of a file
+     *
+     * @param[in] filepath The file
+     * @param[out] removed The removed entry with its path, if any
+     */
+    void erase(const std::string &filepath, std::vector<std::pair<std::string, Entry>> &removed);
+
+    /**
+     * @brief Removes the entries under a directory
+     *
+     * @param[in] directory The directory, its entries having paths starting with _directory_/
+     * @param[out] removed The removed entries with their paths
+     */
+    void eraseBelow(const std::string &directory, std::vector<std::pair<std::string, Entry>> &removed);
+
+    /** @brief Clears the seen flag of every entry */
+    void resetSeen();
+
+    /** @brief Returns the number of entries */
+    size_t size() const { return entries.size(); }
+
+    /** @brief Returns the cache file */
+    const std::string &getPath() const { return path; }
+
+    /** @brief Returns the number of bytes of the cache file ignored by the last load() */
+    size_t getDiscarded() const { return discarded; }
+
+    /** @brief Tells whether the entries changed since the last load() or save() */
+    bool isModified() const { return modified; }
+
+private:
+    std::string path;
+    std::unordered_map<std::string, Entry> entries;
+    size_t discarded = 0;
+    mutable bool modified = false;
+};
+
+#endif // INGESTCACHE_H
@@ -0,0 +1,138 @@
+#include <chrono>
+
+#include "lazycatalog.h"
+
+LazyCatalog::LazyCatalog(const std::string &path, size_t capacity, Factory factory)
+    : reader(path, false), capacity(capacity > 0 ? capacity : 1), factory(std::move(factory)),
+      firstVersion(Multimedia::reserveVersions(reader.mediaCount())), erased(reader.mediaCount(), false)
+{
+    cache.reserve(this->capacity);
+}
+
+std::shared_ptr<Multimedia> LazyCatalog::make(size_t index) const
+{
+    return factory(reader.media(index), firstVersion + index);
+}
+
+std::shared_ptr<Multimedia> LazyCatalog::get(size_t index)
+{
+    auto slotIt = cache.find(index);
+    if (slotIt != cache.end())
+    {
+        ++hits;
+        recent.splice(recent.begin(), recent, slotIt->second.recent);
+        return slotIt->second.media;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<Multimedia> media = make(index);
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    int bucket = 0;
+    while (bucket < 63 && (uint64_t(1) << bucket) < elapsed)
+        ++bucket;
+    ++latencies[bucket];
+    ++misses;
+
+    if (cache.size() >= capacity)
+    {
+        cache.erase(recent.back());
+        recent.pop_back();
+        ++evictions;
+    }
+    recent.push_front(index);
+    cache.emplace(index, Slot{media, recent.begin()});
+    return media;
+}
+
+std::shared_ptr<Multimedia> LazyCatalog::find(std::string_view name)
+{
+    size_t index = reader.findMedia(name);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index == SnapshotReader::npos || erased[index])
+        return nullptr;
+    return get(index);
+}
+
+bool LazyCatalog::contains(std::string_view name) const
+{
+    size_t index = reader.findMedia(name);
+    std::lock_guard<std::mutex> lock(mutex);
+    return index != SnapshotReader::npos && !erased[index];
+}
+
+std::shared_ptr<Multimedia> LazyCatalog::erase(std::string_view name)
+{
+    size_t index = reader.findMedia(name);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index == SnapshotReader::npos || erased[index])
+        return nullptr;
+    erased[index] = true;
+    ++erasedCount;
+
+    std::shared_ptr<Multimedia> media;
+    auto slotIt = cache.find(index);
+    if (slotIt != cache.end())
+    {
+        media = slotIt->second.media;
+        recent.erase(slotIt->second.recent);
+        cache.erase(slotIt);
+    }
+    return media;
+}
+
+void LazyCatalog::forEach(const std::function<void(const std::shared_ptr<Multimedia> &)> &visit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t index = 0; index < reader.mediaCount(); ++index)
+    {
+        if (erased[index])
+            continue;
+        auto slotIt = cache.find(index);
+        visit(slotIt != cache.end() ? slotIt->second.media : make(index));
+    }
+}
+
+size_t LazyCatalog::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reader.mediaCount() - erasedCount;
+}
+
+size_t LazyCatalog::getResident() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.size();
+}
+
+unsigned long LazyCatalog::getHits() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+unsigned long LazyCatalog::getMisses() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+unsigned long LazyCatalog::getEvictions() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return evictions;
+}
+
+uint64_t LazyCatalog::getLatencyPercentile(double fraction) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (misses == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(fraction * (misses - 1)) + 1, seen = 0;
+    for (int bucket = 0; bucket < 64; ++bucket)
+    {
+        seen += latencies[bucket];
+        if (seen >= rank)
+            return uint64_t(1) << bucket;
+    }
+    return uint64_t(1) << 63;
+}
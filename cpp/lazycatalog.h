@@ -0,0 +1,140 @@
+/**
+ * @file lazycatalog.h
+ * @brief Header file for the LazyCatalog class
+ *
+ * This file defines the LazyCatalog class, which materialises the multimedia
+ * objects of a mapped snapshot on demand.
+ */
+
+#ifndef LAZYCATALOG_H
+#define LAZYCATALOG_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "multimedia.h"
+#include "snapshot.h"
+
+/**
+ * @class LazyCatalog
+ * @brief Read-only catalog backed by a snapshot, with a bounded object cache
+ *
+ * Nothing but the mapping is resident when the catalog is opened: the media
+ * table of the snapshot, sorted by name, serves as the name index and is
+ * searched in place. An object is constructed the first time it is looked up
+ * and kept in a least-recently-used cache of bounded size afterwards.
+ *
+ * Entries can be erased, which only marks them in a bit vector. The cache is
+ * protected by a mutex so that concurrent readers may share the catalog.
+ *
+ * A version stamp is reserved for every entry when the snapshot is opened:
+ * an object evicted and materialised again keeps its version, so that
+ * clients comparing versions do not see a change.
+ *
+ * @sa Manager::openSnapshot()
+ */
+class LazyCatalog
+{
+public:
+    /** @brief Builds the object described by a snapshot entry, with a given version stamp */
+    using Factory = std::function<std::shared_ptr<Multimedia>(const SnapshotMedia &, unsigned long version)>;
+
+    /**
+     * @brief Opens a snapshot
+     *
+     * The section checksums are not verified, since that would read the whole
+     * file; entries are still bounds-checked when decoded.
+     *
+     * @param[in] path The snapshot file
+     * @param[in] capacity The maximum number of cached objects
+     * @param[in] factory The function constructing the objects
+     *
+     * @throws std::runtime_error if the snapshot cannot be opened
+     */
+    LazyCatalog(const std::string &path, size_t capacity, Factory factory);
+
+    /**
+     * @brief Returns the object with this name, materialising it if needed
+     * @return nullptr if there is no such entry or it was erased
+     */
+    std::shared_ptr<Multimedia> find(std::string_view name);
+
+    /** @brief Tells whether an entry with this name exists, without materialising it */
+    bool contains(std::string_view name) const;
+
+    /**
+     * @brief Marks the entry with this name as erased
+     * @return the object if it was materialised before, so that it can be kept
+     */
+    std::shared_ptr<Multimedia> erase(std::string_view name);
+
+    /** @brief Materialises every entry not erased, in name order */
+    void forEach(const std::function<void(const std::shared_ptr<Multimedia> &)> &visit);
+
+    /** @brief Returns the underlying snapshot */
+    const SnapshotReader &getSnapshot() const { return reader; }
+
+    /** @brief Returns the number of entries not erased */
+    size_t size() const;
+
+    /** @brief Returns the maximum number of cached objects */
+    size_t getCapacity() const { return capacity; }
+
+    /** @brief Returns the number of cached objects */
+    size_t getResident() const;
+
+    /** @brief Returns the number of lookups served from the cache */
+    unsigned long getHits() const;
+
+    /** @brief Returns the number of objects materialised */
+    unsigned long getMisses() const;
+
+    /** @brief Returns the number of objects evicted from the cache */
+    unsigned long getEvictions() const;
+
+    /**
+     * @brief Returns a percentile of the time taken to materialise an object
+     *
+     * Latencies are recorded in power-of-two buckets; the upper bound of the
+     * bucket is returned.
+     *
+     * @param[in] fraction The percentile, between 0 and 1 (0.99 for p99)
+     * @return The latency in nanoseconds, 0 if nothing was materialised
+     */
+    uint64_t getLatencyPercentile(double fraction) const;
+
+private:
+    struct Slot
+    {
+        std::shared_ptr<Multimedia> media;
+        std::list<size_t>::iterator recent;
+    };
+
+    /** @brief Returns the cached object of an entry or materialises it, with the mutex held */
+    std::shared_ptr<Multimedia> get(size_t index);
+
+    /** @brief Materialises an entry with its version */
+    std::shared_ptr<Multimedia> make(size_t index) const;
+
+    SnapshotReader reader;
+    size_t capacity;
+    Factory factory;
+    unsigned long firstVersion; ///< version of the first entry, the others follow
+
+    mutable std::mutex mutex;
+    std::unordered_map<size_t, Slot> cache;
+    std::list<size_t> recent; ///< cached entries, most recently used first
+    std::vector<bool> erased;
+    size_t erasedCount = 0;
+    unsigned long hits = 0, misses = 0, evictions = 0;
+    uint64_t latencies[64] = {};
+};
+
+#endif // LAZYCATALOG_H
@@ -12,6 +12,7 @@
 #include <sstream>
 #include <memory>
 #include "tcpserver.h"
+#include "router.h"
 
 using namespace std;
 using mmPtr = std::shared_ptr<Multimedia>;
@@ -181,14 +182,18 @@ int main(int argc, const char *argv[])
   }
 
   // write
-  for (const auto &pair : m1->getMedias())
+  try
   {
-    mmPtr media = pair.second;
-    media->write(f);
+    m1->save(f);
   }
-  // write
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+  // read
   Manager *m2 = new Manager();
-  m2->read(f);
+  m2->readParallel(f);
   // for (const auto &pair : m2->getMedias())
   // {
   //   std::cout << pair.first << ": " << pair.second << std::endl;
@@ -198,6 +203,7 @@ int main(int argc, const char *argv[])
     m2->searchAndDisplay("test-photo", std::cout);
     m2->searchAndDisplay("test-video", std::cout);
     m2->searchAndDisplay("ToyStory", std::cout);
+    m2->searchAndDisplay("My favorites", std::cout);
   }
   catch (const std::exception &e)
   {
@@ -213,50 +219,70 @@ int main(int argc, const char *argv[])
   gPtr g = nullptr;
   int chap_num = 5;
   int *chapters = new int[chap_num]{10, 20, 30, 40, 50};
+  // arguments: [--log <base path>] [--watch <catalog>] [--load <catalog>] [--verbose] [snapshot]
+  const char *snapshotPath = nullptr;
+  const char *logPath = nullptr;
+  const char *watchPath = nullptr;
+  const char *loadPath = nullptr;
+  bool verbose = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--log" && i + 1 < argc)
+      logPath = argv[++i];
+    else if (std::string(argv[i]) == "--watch" && i + 1 < argc)
+      watchPath = argv[++i];
+    else if (std::string(argv[i]) == "--load" && i + 1 < argc)
+      loadPath = argv[++i];
+    else if (std::string(argv[i]) == "--verbose")
+      verbose = true;
+    else
+      snapshotPath = argv[i];
+  }
   try
   {
-    pPtr photo = m->createPhoto("test-photo",
-                                "/home/vivian_withana/paradigm/TP1/test-photo.JPG",
-                                10, 10);
-    vPtr video = m->createVideo("test-video",
-                                "/home/vivian_withana/paradigm/TP1/test-video.mp4",
-                                10);
-    g = m->createGroup("My favorites");
-    g->push_back(photo);
-    g->push_back(video);
-    m->createFilm("ToyStory", "./ToyStory", 20, chapters, chap_num);
+    // optional snapshot to serve, opened lazily
+    if (snapshotPath)
+    {
+      m->openSnapshot(snapshotPath);
+    }
+    // optional write-ahead log, which brings back the previous catalog
+    if (logPath)
+    {
+      m->openLog(logPath);
+    }
+    // optional text catalog, reloaded whenever it is rewritten
+    if (watchPath)
+    {
+      m->reload(watchPath);
+      m->watch(watchPath);
+    }
+    // optional text catalog, loaded while the server already answers
+    if (loadPath)
+    {
+      m->readAsync(loadPath);
+    }
+    else if (!watchPath && !snapshotPath && (!logPath || m->getStats().getCount() == 0))
+    {
+      pPtr photo = m->createPhoto("test-photo",
+                                  "/home/vivian_withana/paradigm/TP1/test-photo.JPG",
+                                  10, 10);
+      vPtr video = m->createVideo("test-video",
+                                  "/home/vivian_withana/paradigm/TP1/test-video.mp4",
+                                  10);
+      // created with its members, so that they are logged with the group
+      g = m->createGroup("My favorites", {photo, video});
+      m->createFilm("ToyStory", "./ToyStory", 20, chapters, chap_num);
+    }
   }
   catch (const std::exception &e)
   {
     std::cerr << e.what() << '\n';
     return -1;
   }
-  auto *server = new TCPServer([&](std::string const &request, std::string &response)
-                               {
-      std::cout << "request: " << request << std::endl;
-      std::stringstream ss(request);
-      std::string action, name;
-      ss >> action >> name;
-      if (action == "search")
-      {
-        std::ostringstream oss;
-        try
-        {
-          m->searchAndDisplay(name, oss);
-        }
-        catch(const std::exception& e)
-        {
-          std::cerr << e.what() << '\n';
-        }
-        response = oss.str();
-      } else {
-        // std::stringstream ss;
-          m->playMedia(name);
-          // ss << "Playing "<<name;
-          // response = ss.str();
-      }
-      std::cout << "response: " << response << std::endl;
-      return true; });
+  // requests are dispatched to the command handlers by the router
+  CommandRouter router(*m);
+  router.setVerbose(verbose);
+  auto *server = new TCPServer(router);
   // lance la boucle infinie du serveur
   std::cout << "Starting Server on port " << PORT << std::endl;
 
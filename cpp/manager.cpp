@@ -1,11 +1,25 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdlib.h>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <charconv>
+#include <type_traits>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <sys/stat.h>
 
 #include "multimedia.h"
 #include "group.h"
@@ -14,6 +28,13 @@
 #include "film.h"
 #include "manager.h"
 #include "exceptions.h"
+#include "topk.h"
+#include "catalogwriter.h"
+#include "catalogparser.h"
+#include "mappedfile.h"
+#include "snapshot.h"
+#include "exif.h"
+#include "mp4.h"
 
 using mmPtr = std::shared_ptr<Multimedia>;
 using pPtr = std::shared_ptr<Photo>;
@@ -21,47 +42,139 @@ using vPtr = std::shared_ptr<Video>;
 using fPtr = std::shared_ptr<Film>;
 using gPtr = std::shared_ptr<Group>;
 
+Manager::~Manager()
+{
+    {
+        std::lock_guard<std::mutex> lock(watchesMutex);
+        watches.clear();
+    }
+    watcher.reset();
+    stopLoading = true;
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+    if (compactor.joinable())
+    {
+        compactor.join();
+    }
+    if (saveWaiter.joinable())
+    {
+        saveWaiter.join();
+    }
+    for (const auto &pair : mediaCollection)
+    {
+        stats.remove(*pair.second);
+    }
+}
+
 pPtr Manager::createPhoto(std::string name, std::string filepath, double latitude, double longitude)
 {
     pPtr p = pPtr(new Photo(name, filepath, latitude, longitude));
-    if (mediaCollection.count(name) > 0)
+    if (mediaExists(name))
     {
         throw NamingError("Photo name already exists!");
     }
     mediaCollection[name] = p;
+    addName(name);
+    stats.add(*p);
+    logMedia(name, *p);
     return p;
 }
 
+pPtr Manager::importPhoto(std::string name, std::string filepath)
+{
+    ExifData exif;
+    exif::readFile(filepath, exif);
+    return createPhoto(std::move(name), std::move(filepath), exif.latitude, exif.longitude);
+}
+
 vPtr Manager::createVideo(std::string name, std::string filepath, int duration)
 {
     vPtr v = vPtr(new Video(name, filepath, duration));
-    if (mediaCollection.count(name) > 0)
+    if (mediaExists(name))
     {
         throw NamingError("Video name already exists!");
     }
     mediaCollection[name] = v;
+    addName(name);
+    stats.add(*v);
+    logMedia(name, *v);
     return v;
 }
 
+namespace
+{
+    // Converts the metadata of an MP4 file to a duration and chapter lengths in
+    // whole seconds, the boundaries being rounded so that the lengths add up to
+    // the duration.
+    std::vector<int> chapterLengths(const Mp4Data &mp4, int &duration)
+    {
+        duration = static_cast<int>(std::min(std::round(mp4.duration), 2147483647.0));
+        std::vector<int> lengths;
+        int start = 0; // the first chapter starts at 0
+        for (size_t i = 1; i <= mp4.chapters.size(); ++i)
+        {
+            int end = i < mp4.chapters.size() ? static_cast<int>(std::min(std::round(mp4.chapters[i]), double(duration))) : duration;
+            end = std::max(end, start);
+            lengths.push_back(end - start);
+            start = end;
+        }
+        return lengths;
+    }
+}
+
+vPtr Manager::importVideo(std::string name, std::string filepath)
+{
+    Mp4Data mp4;
+    mp4::readFile(filepath, mp4);
+    int duration;
+    std::vector<int> chapters = chapterLengths(mp4, duration);
+    if (chapters.empty())
+    {
+        return createVideo(std::move(name), std::move(filepath), duration);
+    }
+    return createFilm(std::move(name), std::move(filepath), duration, chapters.data(), chapters.size());
+}
+
 fPtr Manager::createFilm(std::string name, std::string filepath, int duration, const int *chapters, size_t n_chapters)
 {
     fPtr f = fPtr(new Film(name, filepath, duration, chapters, n_chapters));
-    if (mediaCollection.count(name) > 0)
+    if (mediaExists(name))
     {
         throw NamingError("Film name already exists!");
     }
     mediaCollection[name] = f;
+    addName(name);
+    stats.add(*f);
+    logMedia(name, *f);
     return f;
 }
 
 fPtr Manager::copyAndCreateFilm(const Film &otherFilm)
 {
     fPtr f = fPtr(new Film(otherFilm));
-    mediaCollection[otherFilm.getName()] = f;
+    mmPtr &slot = mediaCollection[otherFilm.getName()];
+    bool isNew = !slot;
+    if (slot)
+    {
+        stats.remove(*slot);
+    }
+    slot = f;
+    stats.add(*f);
+    if (isNew)
+    {
+        addName(otherFilm.getName());
+        if (lazy)
+        {
+            lazy->erase(otherFilm.getName());
+        }
+    }
+    logMedia(otherFilm.getName(), *f);
     return f;
 }
 
-gPtr Manager::createGroup(std::string groupName)
+gPtr Manager::createGroup(std::string groupName, const std::vector<mmPtr> &members)
 {
     gPtr group = gPtr(new Group());
     group->setName(groupName);
@@ -69,155 +182,2533 @@ gPtr Manager::createGroup(std::string groupName)
     {
         throw NamingError("Group name already exists!");
     }
+    group->append(members);
     mediaGroups[groupName] = group;
+    addName(groupName);
+    logGroup(groupName, *group);
     return group;
 }
 
 std::ostream &Manager::searchAndDisplay(const std::string &name, std::ostream &os) const
 {
-    auto mediaIt = mediaCollection.find(name);
-    if (mediaIt != mediaCollection.end())
+    if (!trySearchAndDisplay(name, os))
+    {
+        throw NamingError("No group or multimedia with this name exists!");
+    }
+    return os;
+}
+
+bool Manager::trySearchAndDisplay(const std::string &name, std::ostream &os) const
+{
+    bool maybe = mayExist(name);
+    const Multimedia *media = maybe ? lookupMedia(name) : nullptr;
+    if (!media)
+    {
+        media = lookupLazy(name);
+    }
+    if (media)
+    {
+        media->display(os);
+        return true;
+    }
+    if (const Group *group = maybe ? lookupGroup(name) : nullptr)
     {
-        mediaIt->second->display(os);
-        return os;
+        group->display(os);
+        return true;
     }
+    return false;
+}
+
+const Multimedia *Manager::findMedia(const std::string &name) const noexcept
+{
+    // the name filter only covers the collections, not the opened snapshot
+    const Multimedia *media = mayExist(name) ? lookupMedia(name) : nullptr;
+    return media ? media : lookupLazy(name);
+}
+
+const Group *Manager::findGroup(const std::string &name) const noexcept
+{
+    return mayExist(name) ? lookupGroup(name) : nullptr;
+}
+
+const Multimedia *Manager::lookupMedia(const std::string &name) const noexcept
+{
+    auto mediaIt = mediaCollection.find(name);
+    return mediaIt != mediaCollection.end() ? mediaIt->second.get() : nullptr;
+}
 
+const Group *Manager::lookupGroup(const std::string &name) const noexcept
+{
     auto groupIt = mediaGroups.find(name);
-    if (groupIt != mediaGroups.end())
+    return groupIt != mediaGroups.end() ? groupIt->second.get() : nullptr;
+}
+
+const Multimedia *Manager::lookupLazy(const std::string &name) const noexcept
+{
+    if (!lazy)
+    {
+        return nullptr;
+    }
+    // keeps the object alive until the next lookup of the thread, even if it
+    // is evicted from the cache in between
+    thread_local mmPtr pinned;
+    try
+    {
+        pinned = lazy->find(name);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Cannot materialise " << name << ": " << e.what() << '\n';
+        pinned = nullptr;
+    }
+    return pinned.get();
+}
+
+bool Manager::mediaExists(const std::string &name) const
+{
+    return mediaCollection.count(name) > 0 || (lazy && lazy->contains(name));
+}
+
+std::optional<unsigned long> Manager::findVersion(const std::string &name) const noexcept
+{
+    bool maybe = mayExist(name);
+    const Multimedia *media = maybe ? lookupMedia(name) : nullptr;
+    if (!media)
+    {
+        media = lookupLazy(name);
+    }
+    if (media)
+    {
+        return media->getVersion();
+    }
+    if (const Group *group = maybe ? lookupGroup(name) : nullptr)
+    {
+        return group->getVersion();
+    }
+    return std::nullopt;
+}
+
+unsigned long Manager::getVersion(const std::string &name) const
+{
+    std::optional<unsigned long> version = findVersion(name);
+    if (!version)
+    {
+        throw NamingError("No group or multimedia with this name exists!");
+    }
+    return *version;
+}
+
+namespace
+{
+    // Streams the matches of a range of the name index (already in name order).
+    template <class It>
+    size_t scanInOrder(It first, It last, const Query &query,
+                       const std::function<void(const Multimedia &)> &emit)
+    {
+        size_t skip = query.getOffset(), limit = query.getLimit(), count = 0;
+        for (It it = first; it != last && count < limit; ++it)
+        {
+            const Multimedia &media = *it->second;
+            if (!query.matches(media))
+                continue;
+            if (skip > 0)
+            {
+                --skip;
+                continue;
+            }
+            emit(media);
+            ++count;
+        }
+        return count;
+    }
+
+    struct RankedMedia
+    {
+        bool missing; // objects without the ordering field are sorted last
+        double key;
+        const Multimedia *media;
+    };
+
+    struct RankedLess
     {
-        groupIt->second->display(os);
-        return os;
+        bool descending;
+        bool operator()(const RankedMedia &a, const RankedMedia &b) const
+        {
+            if (a.missing != b.missing)
+                return b.missing;
+            if (a.key != b.key)
+                return descending ? a.key > b.key : a.key < b.key;
+            return a.media->getName() < b.media->getName();
+        }
+    };
+}
+
+size_t Manager::runQuery(const Query &query, const std::function<void(const Multimedia &)> &emit) const
+{
+    requireMaterialized();
+    // use the name index to restrict the scanned range
+    auto first = mediaCollection.begin();
+    auto last = mediaCollection.end();
+    bool inclusive = false;
+    if (const std::string *name = query.getNameEquals())
+    {
+        first = mediaCollection.find(*name);
+        last = first == mediaCollection.end() ? first : std::next(first);
+    }
+    else
+    {
+        if (const std::string *lower = query.getNameLower(inclusive))
+            first = inclusive ? mediaCollection.lower_bound(*lower) : mediaCollection.upper_bound(*lower);
+        if (const std::string *upper = query.getNameUpper(inclusive))
+            last = inclusive ? mediaCollection.upper_bound(*upper) : mediaCollection.lower_bound(*upper);
+        // contradictory bounds (name>"z" and name<"b") give an empty range
+        if (first == mediaCollection.end() || (last != mediaCollection.end() && last->first < first->first))
+            last = first;
+    }
+
+    if (!query.isOrdered() || query.getOrderBy() == Query::Field::Name)
+    {
+        if (query.isDescending())
+        {
+            using rIt = std::map<std::string, mmPtr>::const_reverse_iterator;
+            return scanInOrder(rIt(last), rIt(first), query, emit);
+        }
+        return scanInOrder(first, last, query, emit);
+    }
+
+    // numeric ordering: keep the best offset + limit matches only
+    size_t limit = query.getLimit(), offset = query.getOffset();
+    size_t k = offset > Query::NO_LIMIT - limit ? Query::NO_LIMIT : offset + limit;
+    TopK<RankedMedia, RankedLess> best(k, RankedLess{query.isDescending()});
+    for (auto it = first; it != last; ++it)
+    {
+        const Multimedia &media = *it->second;
+        if (!query.matches(media))
+            continue;
+        RankedMedia ranked{false, 0, &media};
+        ranked.missing = !Query::numericValue(media, query.getOrderBy(), ranked.key);
+        best.push(ranked);
     }
 
-    throw NamingError("No group or multimedia with this name exists!");
+    std::vector<RankedMedia> sorted = best.takeSorted();
+    size_t count = 0;
+    for (size_t i = query.getOffset(); i < sorted.size(); ++i, ++count)
+        emit(*sorted[i].media);
+    return count;
 }
 
 void Manager::playMedia(const std::string &name) const
 {
-    auto mediaIt = mediaCollection.find(name);
-    if (mediaIt != mediaCollection.end())
+    if (!tryPlayMedia(name))
     {
-        mediaIt->second->play();
-        return;
+        std::cout << "No multimedia found with the name: " << name << std::endl;
+    }
+}
+
+bool Manager::tryPlayMedia(const std::string &name) const
+{
+    const Multimedia *media = findMedia(name);
+    if (!media)
+    {
+        return false;
     }
-    std::cout << "No multimedia found with the name: " << name << std::endl;
+    media->play();
+    return true;
 }
 
 void Manager::deleteByName(const std::string &name)
 {
+    // objects are deleted before groups of the same name, as by tryDeleteByName()
+    const char *kind = mediaExists(name) ? "Multimedia object" : "Group";
+    if (!tryDeleteByName(name))
+    {
+        throw NamingError("No multimedia or group found with the name " + name);
+    }
+    std::cout << kind << " with name " << name << " deleted.\n";
+}
+
+bool Manager::tryDeleteByName(const std::string &name)
+{
+    if (lazy && lazy->contains(name))
+    {
+        lazy->erase(name);
+        forgetContent(name);
+        logDelete(name);
+        return true;
+    }
+    if (!mayExist(name))
+    {
+        return false;
+    }
     auto mediaIt = mediaCollection.find(name);
     if (mediaIt != mediaCollection.end())
     {
+        stats.remove(*mediaIt->second);
         mediaCollection.erase(mediaIt);
-        std::cout << "Multimedia object with name " << name << " deleted.\n";
-        return;
+        nameFilter.erase(name);
+        forgetContent(name);
+        logDelete(name);
+        return true;
     }
 
     auto groupIt = mediaGroups.find(name);
     if (groupIt != mediaGroups.end())
     {
         mediaGroups.erase(groupIt);
-        std::cout << "Group with name " << name << " deleted.\n";
-        return;
+        nameFilter.erase(name);
+        logDelete(name);
+        return true;
     }
-
-    // std::cout << "No multimedia or group found with the name: " << name << std::endl;
-    throw NamingError("No multimedia or group found with the name " + name);
+    return false;
 }
 
 void Manager::read(const std::string &filename)
 {
-    std::string line;
-    std::ifstream f(filename);
-    if (!f.is_open())
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file.reset(new MappedFile(filename));
+    }
+    catch (const std::exception &e)
     {
         std::cerr << "Error opening file: " << filename << std::endl;
         return;
     }
-    while (std::getline(f, line))
-    {
-        //std::cout << "Getting line: " << line << std::endl;
-        std::stringstream ss(line);
-        std::string className;
-        std::string Name;
-        std::string Filepath;
-        std::string Latitude;
-        std::string Longitude;
-        std::string Duration;
-        std::string N_chapters;
-        ss >> className;
-        if (className == "Photo")
-        {
-            ss >> Name >> Filepath >> Latitude >> Longitude;
-            double latitudeNum;
-            double longitudeNum;
-            latitudeNum = atof(Latitude.c_str());
-            longitudeNum = atof(Longitude.c_str());
-            try
+    file->advise(true);
+
+    CatalogParser parser(file->view());
+    CatalogRecord record;
+    std::vector<mmPtr> byId;
+    while (parser.next(record))
+    {
+        bool media = record.kind != CatalogRecord::Group;
+        if (media)
+        {
+            byId.emplace_back();
+        }
+        try
+        {
+            mmPtr created = addRecord(record, byId);
+            if (media)
             {
-                createPhoto(Name, Filepath, latitudeNum, longitudeNum);
+                byId.back() = created;
             }
-            catch (const std::exception &e)
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << filename << ":" << record.line << ": " << e.what() << '\n';
+        }
+    }
+    for (const CatalogParser::Error &error : parser.getErrors())
+    {
+        std::cerr << filename << ":" << error.line << ": " << error.message << '\n';
+    }
+}
+
+namespace
+{
+    const char *typeName(MediaType type)
+    {
+        return type == MediaType::Photo ? "Photo" : type == MediaType::Video ? "Video"
+                                                                               : "Film";
+    }
+
+    // Objects parsed and constructed by one thread of readParallel(), in file order.
+    struct StagedChunk
+    {
+        struct Entry
+        {
+            size_t line;   // relative to the chunk
+            mmPtr media;   // nullptr for a group
+            size_t group;  // index in groups for a group
+        };
+        std::vector<Entry> entries;
+        std::vector<CatalogRecord> groups;
+        std::vector<CatalogParser::Error> errors;
+        size_t lines = 0;
+    };
+}
+
+void Manager::readParallel(const std::string &filename, unsigned threads)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file.reset(new MappedFile(filename));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return;
+    }
+    file->advise(true);
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::string_view text = file->view();
+
+    // newline-aligned chunk boundaries
+    std::vector<size_t> bounds(1, 0);
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        size_t bound = std::max(bounds.back(), text.size() * i / threads);
+        size_t newline = text.find('\n', bound);
+        bound = newline == std::string_view::npos ? text.size() : newline + 1;
+        if (bound > bounds.back() && bound < text.size())
+        {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(text.size());
+
+    // parse and construct in parallel
+    std::vector<StagedChunk> chunks(bounds.size() - 1);
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        workers.emplace_back([&, c]
+                             {
+            StagedChunk &chunk = chunks[c];
+            CatalogParser parser(text.substr(bounds[c], bounds[c + 1] - bounds[c]));
+            CatalogRecord record;
+            while (parser.next(record))
             {
-                std::cerr << e.what() << '\n';
-                return;
+                std::string name(record.name);
+                std::string filepath(record.filepath);
+                mmPtr media;
+                switch (record.kind)
+                {
+                case CatalogRecord::Photo:
+                    media.reset(new Photo(name, filepath, record.latitude, record.longitude));
+                    break;
+                case CatalogRecord::Video:
+                    media.reset(new Video(name, filepath, record.duration));
+                    break;
+                case CatalogRecord::Film:
+                    media.reset(new Film(name, filepath, record.duration,
+                                         record.chapters.data(), record.chapters.size()));
+                    break;
+                case CatalogRecord::Group:
+                    chunk.groups.push_back(record);
+                    chunk.entries.push_back({record.line, nullptr, chunk.groups.size() - 1});
+                    continue;
+                }
+                chunk.entries.push_back({record.line, std::move(media), 0});
             }
+            chunk.errors = parser.getErrors();
+            chunk.lines = parser.getLine(); });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    // merge in file order
+    std::vector<CatalogParser::Error> errors;
+    std::vector<mmPtr> byId;
+    size_t firstLine = 0;
+    for (StagedChunk &chunk : chunks)
+    {
+        for (const CatalogParser::Error &error : chunk.errors)
+        {
+            errors.push_back({firstLine + error.line, error.message});
         }
-        else if (className == "Video")
+        for (StagedChunk::Entry &entry : chunk.entries)
         {
-            ss >> Name >> Filepath >> Duration;
-            int durationNum;
-            durationNum = atoi(Duration.c_str());
-            try
+            size_t line = firstLine + entry.line;
+            if (entry.media)
             {
-                createVideo(Name, Filepath, durationNum);
+                // saved catalogs are sorted by name, so end() is usually the right hint
+                const std::string &name = entry.media->name;
+                auto it = mediaCollection.try_emplace(mediaCollection.end(), name, entry.media);
+                if (it->second != entry.media)
+                {
+                    errors.push_back({line, std::string(typeName(entry.media->getType())) + " name already exists!"});
+                    byId.emplace_back();
+                    continue;
+                }
+                byId.push_back(entry.media);
+                stats.add(*entry.media);
+                logMedia(name, *entry.media);
+                continue;
             }
-            catch (const std::exception &e)
+
+            const CatalogRecord &record = chunk.groups[entry.group];
+            std::string name(record.name);
+            if (mediaGroups.count(name) > 0)
             {
-                std::cerr << e.what() << '\n';
-                return;
+                errors.push_back({line, "Group name already exists!"});
+                continue;
             }
+            gPtr group = buildGroup(record, byId);
+            mediaGroups[name] = group;
+            logGroup(name, *group);
         }
-        else if (className == "Film")
+        firstLine += chunk.lines;
+    }
+    rebuildNameFilter(nameFilter.getCapacity(), nameFilter.getFalsePositiveRate());
+
+    std::stable_sort(errors.begin(), errors.end(), [](const CatalogParser::Error &a, const CatalogParser::Error &b)
+                     { return a.line < b.line; });
+    for (const CatalogParser::Error &error : errors)
+    {
+        std::cerr << filename << ":" << error.line << ": " << error.message << '\n';
+    }
+}
+
+std::shared_ptr<const CatalogLoad> Manager::readAsync(const std::string &filename, size_t batchSize)
+{
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+    std::shared_ptr<MappedFile> file(new MappedFile(filename));
+    file->advise(true);
+    std::shared_ptr<CatalogLoad> progress(new CatalogLoad(filename, file->size()));
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loading = progress;
+    }
+    batchSize = std::max<size_t>(batchSize, 1);
+
+    loader = std::thread([this, file, progress, filename, batchSize]
+                         {
+        CatalogParser parser(file->view());
+        std::vector<CatalogRecord> batch(batchSize);
+        std::vector<mmPtr> byId;
+        std::vector<CatalogParser::Error> errors;
+        size_t count = batchSize;
+        while (count == batchSize && !stopLoading)
         {
-            ss >> Name >> Filepath >> Duration >> N_chapters;
-            int chaptersNum;
-            chaptersNum = atoi(N_chapters.c_str());
-            int durationNum;
-            durationNum = atoi(Duration.c_str());
-            if (chaptersNum != 0)
+            // parsing is done without the lock, only the insertions hold it
+            count = 0;
+            while (count < batchSize && parser.next(batch[count]))
+            {
+                ++count;
+            }
+            unsigned long added = 0;
+            errors.clear();
             {
-                int *chapters = new int[chaptersNum];
-                for (int i = 0; i < chaptersNum; ++i)
+                auto exclusive = writeLock();
+                for (size_t i = 0; i < count; ++i)
                 {
-                    std::string chapter;
-                    ss >> chapter;
-                    chapters[i] = atoi(chapter.c_str());
-                }
-                try
+                    const CatalogRecord &record = batch[i];
+                    bool media = record.kind != CatalogRecord::Group;
+                    if (media)
+                    {
+                        byId.emplace_back();
+                    }
+                    try
                     {
-                        createFilm(Name, Filepath, durationNum, chapters, chaptersNum);
-                        delete[] chapters;
+                        mmPtr created = addRecord(record, byId);
+                        if (media)
+                        {
+                            byId.back() = created;
+                        }
+                        ++added;
                     }
                     catch (const std::exception &e)
                     {
-                        std::cerr << e.what() << '\n';
-                        return;
+                        errors.push_back({record.line, e.what()});
                     }
+                }
             }
-            else
+            try
             {
-                throw std::invalid_argument("Chapters cannot be empty!");
+                commitMutations();
             }
+            catch (const std::exception &e)
+            {
+                std::cerr << filename << ": " << e.what() << '\n';
+            }
+            for (const CatalogParser::Error &error : errors)
+            {
+                std::cerr << filename << ":" << error.line << ": " << error.message << '\n';
+            }
+            progress->advance(parser.consumed(), added, errors.size());
         }
-        else
+        for (const CatalogParser::Error &error : parser.getErrors())
+        {
+            std::cerr << filename << ":" << error.line << ": " << error.message << '\n';
+        }
+        progress->advance(parser.consumed(), 0, parser.getErrors().size());
+        progress->finish(); });
+    return progress;
+}
+
+bool Manager::isLoading() const
+{
+    std::lock_guard<std::mutex> lock(loadMutex);
+    return loading && !loading->isDone();
+}
+
+std::shared_ptr<const CatalogLoad> Manager::getLoad() const
+{
+    std::lock_guard<std::mutex> lock(loadMutex);
+    return loading;
+}
+
+mmPtr Manager::addRecord(const CatalogRecord &record, const std::vector<mmPtr> &byId)
+{
+    std::string name(record.name);
+    switch (record.kind)
+    {
+    case CatalogRecord::Photo:
+        return createPhoto(name, std::string(record.filepath), record.latitude, record.longitude);
+    case CatalogRecord::Video:
+        return createVideo(name, std::string(record.filepath), record.duration);
+    case CatalogRecord::Film:
+        return createFilm(name, std::string(record.filepath), record.duration,
+                          record.chapters.data(), record.chapters.size());
+    case CatalogRecord::Group:
+        break;
+    }
+
+    // same as createGroup(), but the group is logged with its members
+    if (mediaGroups.count(name) > 0)
+    {
+        throw NamingError("Group name already exists!");
+    }
+    gPtr group = buildGroup(record, byId);
+    mediaGroups[name] = group;
+    addName(name);
+    logGroup(name, *group);
+    return nullptr;
+}
+
+gPtr Manager::buildGroup(const CatalogRecord &record, const std::vector<mmPtr> &byId) const
+{
+    gPtr group = gPtr(new Group());
+    group->setName(std::string(record.name));
+    std::vector<mmPtr> members;
+    members.reserve(record.members.size() + record.memberIds.size());
+    for (std::string_view member : record.members)
+    {
+        auto mediaIt = mediaCollection.find(std::string(member));
+        if (mediaIt != mediaCollection.end())
+        {
+            members.push_back(mediaIt->second);
+        }
+    }
+    // members that were not loaded (duplicate names...) are left out
+    for (size_t id : record.memberIds)
+    {
+        if (id < byId.size() && byId[id])
         {
-            std::cerr << "Class type " << className << " doesn't exist" << std::endl;
+            members.push_back(byId[id]);
         }
     }
+    group->append(members);
+    return group;
 }
 
-std::map<std::string, mmPtr> Manager::getMedias() const
+namespace
 {
-    return mediaCollection;
+    // Builds one line of the text catalog, for the log records.
+    struct LineBuilder
+    {
+        std::string text;
+
+        LineBuilder &operator<<(std::string_view part)
+        {
+            text += part;
+            return *this;
+        }
+
+        LineBuilder &operator<<(char c)
+        {
+            text += c;
+            return *this;
+        }
+
+        template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+        LineBuilder &operator<<(T value)
+        {
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            text.append(digits, result.ptr);
+            return *this;
+        }
+    };
+
+    // Writes an object in the format of Photo::write(), Video::write() and
+    // Film::write(), without the end of line.
+    template <class Out>
+    void writeMedia(Out &out, const std::string &name, const Multimedia &media)
+    {
+        switch (media.getType())
+        {
+        case MediaType::Photo:
+        {
+            const Photo &photo = static_cast<const Photo &>(media);
+            out << "Photo " << name << ' ' << photo.getFilepath() << ' '
+                << photo.getLatitude() << ' ' << photo.getLongitude();
+            break;
+        }
+        case MediaType::Video:
+        {
+            const Video &video = static_cast<const Video &>(media);
+            out << "Video " << name << ' ' << video.getFilepath() << ' '
+                << video.getDuration();
+            break;
+        }
+        case MediaType::Film:
+        {
+            const Film &film = static_cast<const Film &>(media);
+            out << "Film " << name << ' ' << film.getFilepath() << ' '
+                << film.getDuration() << ' ' << film.getChapterNumber();
+            const int *chapters = film.getChapters();
+            for (size_t i = 0; chapters && i < film.getChapterNumber(); ++i)
+            {
+                out << ' ' << chapters[i];
+            }
+            break;
+        }
+        }
+    }
+
+    // Writes a group line with the names of the members that are still in
+    // the collection, without the end of line.
+    template <class Out>
+    void writeGroup(Out &out, const std::string &name, const Group &group,
+                    const std::map<std::string, mmPtr> &medias)
+    {
+        std::vector<const std::string *> members;
+        for (const mmPtr &media : group)
+        {
+            auto mediaIt = medias.find(media->getName());
+            if (mediaIt != medias.end() && mediaIt->second == media)
+            {
+                members.push_back(&mediaIt->first);
+            }
+        }
+        out << "Group " << members.size();
+        for (const std::string *member : members)
+        {
+            out << ' ' << *member;
+        }
+        out << ' ' << name;
+    }
+}
+
+void Manager::save(const std::string &filename) const
+{
+    requireMaterialized();
+    CatalogWriter out(filename);
+    std::unordered_map<const Multimedia *, size_t> ids;
+    if (!mediaGroups.empty())
+    {
+        ids.reserve(mediaCollection.size());
+    }
+    for (const auto &pair : mediaCollection)
+    {
+        writeMedia(out, pair.first, *pair.second);
+        out << '\n';
+        if (!mediaGroups.empty())
+        {
+            ids.emplace(pair.second.get(), ids.size());
+        }
+    }
+
+    std::vector<long long> members;
+    for (const auto &pair : mediaGroups)
+    {
+        members.clear();
+        for (const mmPtr &media : *pair.second)
+        {
+            auto idIt = ids.find(media.get());
+            if (idIt != ids.end())
+            {
+                members.push_back(static_cast<long long>(idIt->second));
+            }
+        }
+        // each ID is written as the difference with the previous one
+        out << "GroupIds " << members.size();
+        long long previous = 0;
+        for (long long id : members)
+        {
+            out << ' ' << id - previous;
+            previous = id;
+        }
+        out << ' ' << pair.first << '\n';
+    }
+    out.commit();
+}
+
+void Manager::saveSnapshot(const std::string &filename) const
+{
+    requireMaterialized();
+    writeSnapshot(filename, mediaCollection, copyGroups(mediaGroups));
+}
+
+Manager::GroupMembers Manager::copyGroups(const std::map<std::string, gPtr> &groups)
+{
+    GroupMembers copy;
+    copy.reserve(groups.size());
+    for (const auto &pair : groups)
+    {
+        copy.emplace_back(pair.first, std::vector<mmPtr>(pair.second->begin(), pair.second->end()));
+    }
+    return copy;
+}
+
+void Manager::writeSnapshot(const std::string &filename, const std::map<std::string, mmPtr> &medias,
+                            const GroupMembers &groups, unsigned long logSegment)
+{
+    SnapshotWriter out;
+    out.setLogSegment(logSegment);
+    std::unordered_map<const Multimedia *, uint32_t> indices;
+    if (!groups.empty())
+    {
+        indices.reserve(medias.size());
+    }
+    for (const auto &pair : medias)
+    {
+        uint32_t index = out.addMedia(pair.first, *pair.second);
+        if (!groups.empty())
+        {
+            indices.emplace(pair.second.get(), index);
+        }
+    }
+
+    std::vector<uint32_t> members;
+    for (const auto &pair : groups)
+    {
+        members.clear();
+        for (const mmPtr &media : pair.second)
+        {
+            auto indexIt = indices.find(media.get());
+            if (indexIt != indices.end())
+            {
+                members.push_back(indexIt->second);
+            }
+        }
+        out.addGroup(pair.first, members);
+    }
+    out.commit(filename);
+}
+
+unsigned long Manager::loadSnapshot(const std::string &filename)
+{
+    SnapshotReader in(filename);
+    materializeAll();
+    std::vector<mmPtr> medias(in.mediaCount());
+    for (size_t i = 0; i < in.mediaCount(); ++i)
+    {
+        SnapshotMedia entry = in.media(i);
+        mmPtr media = makeMedia(entry);
+        const std::string &name = media->getName();
+        // the snapshot is sorted by name, so end() is the right hint when loading into an empty catalog
+        auto it = mediaCollection.try_emplace(mediaCollection.end(), name, media);
+        if (it->second != media)
+        {
+            std::cerr << filename << ": " << typeName(entry.type) << " name already exists! (" << name << ")" << '\n';
+            continue;
+        }
+        stats.add(*media);
+        logMedia(name, *media);
+        medias[i] = media;
+    }
+
+    std::vector<mmPtr> members;
+    for (size_t i = 0; i < in.groupCount(); ++i)
+    {
+        SnapshotGroup entry = in.group(i);
+        std::string name(entry.name);
+        if (mediaGroups.count(name) > 0)
+        {
+            std::cerr << filename << ": Group name already exists! (" << name << ")" << '\n';
+            continue;
+        }
+        gPtr group = gPtr(new Group());
+        group->setName(name);
+        members.clear();
+        for (size_t m = 0; m < entry.memberCount; ++m)
+        {
+            if (const mmPtr &media = medias[entry.members[m]])
+            {
+                members.push_back(media);
+            }
+        }
+        group->append(members);
+        mediaGroups.try_emplace(mediaGroups.end(), name, group);
+        logGroup(name, *group);
+    }
+    rebuildNameFilter(nameFilter.getCapacity(), nameFilter.getFalsePositiveRate());
+    return in.logSegment();
+}
+
+mmPtr Manager::makeMedia(const SnapshotMedia &entry, unsigned long version)
+{
+    std::string name(entry.name);
+    std::string filepath(entry.filepath);
+    mmPtr media;
+    switch (entry.type)
+    {
+    case MediaType::Photo:
+        media.reset(new Photo(name, filepath, entry.latitude, entry.longitude));
+        break;
+    case MediaType::Video:
+        media.reset(new Video(name, filepath, entry.duration));
+        break;
+    case MediaType::Film:
+        media.reset(new Film(name, filepath, entry.duration, entry.chapters, entry.chapterCount));
+        break;
+    }
+    if (media && version != 0)
+    {
+        media->version = version;
+    }
+    return media;
+}
+
+void Manager::openSnapshot(const std::string &filename, size_t cacheCapacity)
+{
+    std::unique_ptr<LazyCatalog> catalog(new LazyCatalog(filename, cacheCapacity, &Manager::makeMedia));
+    materializeAll();
+
+    // objects already in the catalog hide those of the snapshot
+    for (const auto &pair : mediaCollection)
+    {
+        if (catalog->contains(pair.first))
+        {
+            catalog->erase(pair.first);
+            std::cerr << filename << ": " << typeName(pair.second->getType()) << " name already exists! (" << pair.first << ")" << '\n';
+        }
+    }
+
+    // groups are few: they are loaded eagerly and their members moved to the collections
+    const SnapshotReader &in = catalog->getSnapshot();
+    for (size_t i = 0; i < in.groupCount(); ++i)
+    {
+        SnapshotGroup entry = in.group(i);
+        std::string name(entry.name);
+        if (mediaGroups.count(name) > 0)
+        {
+            std::cerr << filename << ": Group name already exists! (" << name << ")" << '\n';
+            continue;
+        }
+        gPtr group = gPtr(new Group());
+        group->setName(name);
+        for (size_t m = 0; m < entry.memberCount; ++m)
+        {
+            std::string member(in.media(entry.members[m]).name);
+            mmPtr media = catalog->find(member);
+            if (media)
+            {
+                catalog->erase(member);
+                mediaCollection.emplace(member, media);
+                stats.add(*media);
+                logMedia(member, *media);
+            }
+            else
+            {
+                // already moved for another group
+                auto mediaIt = mediaCollection.find(member);
+                if (mediaIt == mediaCollection.end())
+                {
+                    continue;
+                }
+                media = mediaIt->second;
+            }
+            group->push_back(media);
+        }
+        mediaGroups.emplace(name, group);
+        logGroup(name, *group);
+    }
+    lazy = std::move(catalog);
+    rebuildNameFilter(nameFilter.getCapacity(), nameFilter.getFalsePositiveRate());
+}
+
+const LazyCatalog *Manager::getLazyCatalog() const
+{
+    return lazy.get();
+}
+
+void Manager::materializeAll()
+{
+    if (!lazy)
+    {
+        return;
+    }
+    // a corrupted entry throws: nothing changes until every entry is materialised
+    std::map<std::string, mmPtr> staged;
+    lazy->forEach([&](const mmPtr &media)
+                  {
+        // the snapshot is in name order, so each object goes after the previous one
+        staged.emplace_hint(staged.end(), media->getName(), media); });
+    for (const auto &pair : staged)
+    {
+        stats.add(*pair.second);
+    }
+    mediaCollection.merge(staged);
+    lazy.reset();
+    rebuildNameFilter(nameFilter.getCapacity(), nameFilter.getFalsePositiveRate());
+}
+
+void Manager::requireMaterialized() const
+{
+    if (lazy)
+    {
+        throw std::logic_error("The snapshot opened lazily must be materialised first, under writeLock()");
+    }
+}
+
+void Manager::materialize()
+{
+    materializeAll();
+}
+
+std::shared_lock<std::shared_mutex> Manager::readLock() const
+{
+    return std::shared_lock<std::shared_mutex>(mutex);
+}
+
+std::unique_lock<std::shared_mutex> Manager::writeLock()
+{
+    return std::unique_lock<std::shared_mutex>(mutex);
+}
+
+namespace
+{
+    // sequence number of the last record appended by the thread, see commitMutations()
+    thread_local uint64_t lastRecord = 0;
+
+    std::string segmentPath(const std::string &base, unsigned long segment)
+    {
+        return base + ".log." + std::to_string(segment);
+    }
+
+    // numbers of the existing log segments, in increasing order
+    std::vector<unsigned long> listSegments(const std::string &base)
+    {
+        size_t slash = base.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : base.substr(0, slash + 1);
+        std::string prefix = (slash == std::string::npos ? base : base.substr(slash + 1)) + ".log.";
+        std::vector<unsigned long> segments;
+        DIR *dir = ::opendir(directory.c_str());
+        if (!dir)
+        {
+            return segments;
+        }
+        while (const dirent *entry = ::readdir(dir))
+        {
+            std::string_view file = entry->d_name;
+            if (file.size() <= prefix.size() || file.substr(0, prefix.size()) != prefix)
+                continue;
+            unsigned long segment;
+            auto result = std::from_chars(file.data() + prefix.size(), file.data() + file.size(), segment);
+            if (result.ec == std::errc() && result.ptr == file.data() + file.size())
+                segments.push_back(segment);
+        }
+        ::closedir(dir);
+        std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+}
+
+void Manager::openLog(const std::string &basePath, size_t batchSize, std::chrono::microseconds maxDelay,
+                      size_t compactionSize)
+{
+    if (log)
+    {
+        throw std::runtime_error("A log is already open");
+    }
+    std::string snapshotPath = basePath + ".snap";
+    unsigned long folded = 0;
+    if (::access(snapshotPath.c_str(), F_OK) == 0)
+    {
+        folded = loadSnapshot(snapshotPath);
+    }
+    std::vector<unsigned long> segments = listSegments(basePath);
+    for (unsigned long segment : segments)
+    {
+        // left behind by a compaction interrupted before removing them
+        if (segment <= folded)
+            continue;
+        std::string path = segmentPath(basePath, segment);
+        if (!MutationLog::replay(path, [this](std::string_view record)
+                                 { replayRecord(record); }))
+        {
+            std::cerr << path << ": incomplete record at the end of the log" << '\n';
+        }
+    }
+
+    logBase = basePath;
+    logSegment = std::max(folded, segments.empty() ? 0 : segments.back()) + 1;
+    this->compactionSize = compactionSize;
+    log.reset(new MutationLog(segmentPath(logBase, logSegment), batchSize, maxDelay));
+}
+
+void Manager::replayRecord(std::string_view record)
+{
+    constexpr std::string_view DELETE = "Delete ";
+    if (record.substr(0, DELETE.size()) == DELETE)
+    {
+        tryDeleteByName(std::string(record.substr(DELETE.size())));
+        return;
+    }
+
+    CatalogParser parser(record);
+    CatalogRecord parsed;
+    if (!parser.next(parsed))
+    {
+        std::cerr << "Invalid log record: " << record << '\n';
+        return;
+    }
+    std::string name(parsed.name);
+    if (parsed.kind == CatalogRecord::Group)
+    {
+        // members added after the creation of the group are only in the snapshot
+        if (mediaGroups.count(name) > 0)
+            return;
+    }
+    else if (mediaExists(name))
+    {
+        // creations are replayed as replacements
+        tryDeleteByName(name);
+    }
+    try
+    {
+        addRecord(parsed, {});
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid log record: " << record << ": " << e.what() << '\n';
+    }
+}
+
+void Manager::logRecord(std::string_view record)
+{
+    if (log)
+    {
+        lastRecord = log->append(record);
+    }
+}
+
+void Manager::logMedia(const std::string &name, const Multimedia &media)
+{
+    if (log)
+    {
+        LineBuilder line;
+        writeMedia(line, name, media);
+        logRecord(line.text);
+    }
+}
+
+void Manager::logGroup(const std::string &name, const Group &group)
+{
+    if (log)
+    {
+        LineBuilder line;
+        writeGroup(line, name, group, mediaCollection);
+        logRecord(line.text);
+    }
+}
+
+void Manager::logDelete(const std::string &name)
+{
+    if (log)
+    {
+        logRecord("Delete " + name);
+    }
+}
+
+void Manager::commitMutations()
+{
+    if (!log)
+    {
+        return;
+    }
+    log->waitDurable(lastRecord);
+    if (log->size() > compactionSize)
+    {
+        compact();
+    }
+}
+
+bool Manager::compact()
+{
+    if (!log || compacting.exchange(true))
+    {
+        return false;
+    }
+    if (compactor.joinable())
+    {
+        compactor.join();
+    }
+
+    std::map<std::string, mmPtr> medias;
+    GroupMembers groups;
+    unsigned long folded = logSegment;
+    try
+    {
+        if (lazy)
+        {
+            auto lock = writeLock();
+            materializeAll();
+        }
+        // writers are excluded: the new segment starts exactly after the copied state
+        auto lock = readLock();
+        log->switchTo(segmentPath(logBase, folded + 1));
+        logSegment = folded + 1;
+        medias = mediaCollection;
+        groups = copyGroups(mediaGroups);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Cannot compact the log: " << e.what() << '\n';
+        compacting = false;
+        return false;
+    }
+
+    compactor = std::thread([this, folded, medias = std::move(medias), groups = std::move(groups)]
+                            {
+        try
+        {
+            writeSnapshot(logBase + ".snap", medias, groups, folded);
+            for (unsigned long segment : listSegments(logBase))
+            {
+                if (segment <= folded)
+                    ::unlink(segmentPath(logBase, segment).c_str());
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Cannot compact the log: " << e.what() << '\n';
+        }
+        compacting = false; });
+    return true;
+}
+
+bool Manager::isCompacting() const
+{
+    return compacting;
+}
+
+const MutationLog *Manager::getLog() const
+{
+    return log.get();
+}
+
+bool Manager::backgroundSave(const std::string &filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        if (lastSave.state == SaveStatus::Running)
+        {
+            return false;
+        }
+        lastSave = SaveStatus{SaveStatus::Running, filename};
+    }
+    if (saveWaiter.joinable())
+    {
+        saveWaiter.join();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    {
+        auto shared = readLock();
+        std::unique_lock<std::shared_mutex> exclusive;
+        if (lazy)
+        {
+            shared.unlock();
+            exclusive = writeLock();
+        }
+        pid = ::fork();
+        if (pid == 0)
+        {
+            // only this thread exists in the child: no lock, no output, no destructors
+            bool snapshot = filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".snap") == 0;
+            int status = 0;
+            try
+            {
+                // the lock copied into the child is held exclusively if a snapshot is opened lazily
+                materializeAll();
+                if (snapshot)
+                    saveSnapshot(filename);
+                else
+                    save(filename);
+            }
+            catch (...)
+            {
+                status = 1;
+            }
+            ::_exit(status);
+        }
+    }
+    if (pid < 0)
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        lastSave.state = SaveStatus::Failed;
+        lastSave.finished = std::time(nullptr);
+        return false;
+    }
+
+    saveWaiter = std::thread([this, pid, start]
+                             {
+        int status = 0;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        std::lock_guard<std::mutex> lock(saveMutex);
+        lastSave.state = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? SaveStatus::Succeeded : SaveStatus::Failed;
+        lastSave.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lastSave.finished = std::time(nullptr); });
+    return true;
+}
+
+Manager::SaveStatus Manager::getLastSave() const
+{
+    std::lock_guard<std::mutex> lock(saveMutex);
+    return lastSave;
+}
+
+namespace
+{
+    bool sameMedia(const Multimedia &a, const Multimedia &b)
+    {
+        if (a.getType() != b.getType() || a.getFilepath() != b.getFilepath())
+        {
+            return false;
+        }
+        switch (a.getType())
+        {
+        case MediaType::Photo:
+        {
+            const Photo &photoA = static_cast<const Photo &>(a), &photoB = static_cast<const Photo &>(b);
+            return photoA.getLatitude() == photoB.getLatitude() && photoA.getLongitude() == photoB.getLongitude();
+        }
+        case MediaType::Video:
+            return static_cast<const Video &>(a).getDuration() == static_cast<const Video &>(b).getDuration();
+        case MediaType::Film:
+        {
+            const Film &filmA = static_cast<const Film &>(a), &filmB = static_cast<const Film &>(b);
+            if (filmA.getDuration() != filmB.getDuration() || filmA.getChapterNumber() != filmB.getChapterNumber())
+            {
+                return false;
+            }
+            const int *chaptersA = filmA.getChapters(), *chaptersB = filmB.getChapters();
+            return filmA.getChapterNumber() == 0 ||
+                   std::equal(chaptersA, chaptersA + filmA.getChapterNumber(), chaptersB);
+        }
+        }
+        return false;
+    }
+
+    // Changes that make a catalog identical to another one, computed by reload().
+    struct CatalogDelta
+    {
+        std::vector<mmPtr> media;           // new or changed objects
+        std::vector<std::string> removed;   // objects no longer in the catalog
+        std::vector<std::pair<std::string, std::vector<mmPtr>>> groups; // new or changed groups
+        std::vector<std::string> removedGroups;
+        size_t added = 0;
+    };
+}
+
+bool Manager::reload(const std::string &filename)
+{
+    using Clock = std::chrono::steady_clock;
+    std::lock_guard<std::mutex> turn(reloading);
+    ReloadStatus status;
+    status.state = ReloadStatus::Running;
+    status.filename = filename;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        status.count = lastReload.count + 1;
+        lastReload = status;
+    }
+    auto finish = [&](bool succeeded)
+    {
+        status.state = succeeded ? ReloadStatus::Succeeded : ReloadStatus::Failed;
+        status.finished = std::time(nullptr);
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        lastReload = status;
+        return succeeded;
+    };
+
+    // a missing file would otherwise empty the catalog
+    if (::access(filename.c_str(), R_OK) != 0)
+    {
+        std::cerr << "Cannot reload " << filename << ": " << strerror(errno) << std::endl;
+        return finish(false);
+    }
+    auto start = Clock::now();
+    Manager next;
+    next.readParallel(filename);
+    auto loaded = Clock::now();
+    status.loadSeconds = std::chrono::duration<double>(loaded - start).count();
+
+    // the delta is computed and applied under the same lock, so that no
+    // mutation of another thread can slip in between and be undone
+    auto exclusive = writeLock();
+    try
+    {
+        materializeAll();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Cannot reload " << filename << ": " << e.what() << std::endl;
+        return finish(false);
+    }
+
+    CatalogDelta delta;
+    {
+        // both collections are in name order
+        auto current = mediaCollection.begin();
+        for (const auto &pair : next.mediaCollection)
+        {
+            while (current != mediaCollection.end() && current->first < pair.first)
+            {
+                delta.removed.push_back(current->first);
+                ++current;
+            }
+            if (current != mediaCollection.end() && current->first == pair.first)
+            {
+                if (!sameMedia(*current->second, *pair.second))
+                {
+                    delta.media.push_back(pair.second);
+                }
+                ++current;
+                continue;
+            }
+            delta.media.push_back(pair.second);
+            ++delta.added;
+        }
+        for (; current != mediaCollection.end(); ++current)
+        {
+            delta.removed.push_back(current->first);
+        }
+
+        // members are the objects of the catalog after the swap
+        std::unordered_map<std::string_view, const mmPtr *> replaced;
+        replaced.reserve(delta.media.size());
+        for (const mmPtr &media : delta.media)
+        {
+            replaced.emplace(media->name, &media);
+        }
+        for (const auto &pair : next.mediaGroups)
+        {
+            auto groupIt = mediaGroups.find(pair.first);
+            bool same = groupIt != mediaGroups.end() && groupIt->second->size() == pair.second->size();
+            std::vector<mmPtr> members;
+            members.reserve(pair.second->size());
+            auto oldMember = same ? groupIt->second->begin() : Group::const_iterator();
+            for (const mmPtr &member : *pair.second)
+            {
+                auto replacedIt = replaced.find(member->name);
+                if (replacedIt != replaced.end())
+                {
+                    members.push_back(*replacedIt->second);
+                    same = false;
+                    continue;
+                }
+                const mmPtr &kept = mediaCollection.find(member->name)->second;
+                members.push_back(kept);
+                same = same && *oldMember++ == kept;
+            }
+            if (!same)
+            {
+                delta.groups.emplace_back(pair.first, std::move(members));
+            }
+        }
+        for (const auto &pair : mediaGroups)
+        {
+            if (next.mediaGroups.count(pair.first) == 0)
+            {
+                delta.removedGroups.push_back(pair.first);
+            }
+        }
+    }
+    auto diffed = Clock::now();
+    status.diffSeconds = std::chrono::duration<double>(diffed - loaded).count();
+
+    // nothing of the private catalog may be shared: detach its statistics first
+    next.mediaGroups.clear();
+    for (const auto &pair : next.mediaCollection)
+    {
+        next.stats.remove(*pair.second);
+    }
+    next.mediaCollection.clear();
+
+    {
+        auto swapStart = Clock::now();
+        for (const std::string &name : delta.removed)
+        {
+            auto mediaIt = mediaCollection.find(name);
+            if (mediaIt != mediaCollection.end())
+            {
+                stats.remove(*mediaIt->second);
+                mediaCollection.erase(mediaIt);
+                nameFilter.erase(name);
+                forgetContent(name);
+                logDelete(name);
+            }
+        }
+        for (const mmPtr &media : delta.media)
+        {
+            mmPtr &slot = mediaCollection[media->name];
+            if (slot)
+            {
+                stats.remove(*slot);
+                forgetContent(media->name);
+            }
+            else
+            {
+                addName(media->name);
+            }
+            slot = media;
+            stats.add(*media);
+            logMedia(media->name, *media);
+        }
+        for (const std::string &name : delta.removedGroups)
+        {
+            if (mediaGroups.erase(name) > 0)
+            {
+                nameFilter.erase(name);
+                logDelete(name);
+            }
+        }
+        for (auto &pair : delta.groups)
+        {
+            gPtr group = gPtr(new Group());
+            group->setName(pair.first);
+            group->append(pair.second);
+            gPtr &slot = mediaGroups[pair.first];
+            if (slot)
+            {
+                // replaying a group record does not replace an existing group
+                logDelete(pair.first);
+            }
+            else
+            {
+                addName(pair.first);
+            }
+            slot = group;
+            logGroup(pair.first, *group);
+        }
+        status.swapSeconds = std::chrono::duration<double>(Clock::now() - swapStart).count();
+    }
+    exclusive.unlock();
+    status.added = delta.added;
+    status.changed = delta.media.size() - delta.added;
+    status.removed = delta.removed.size();
+    status.groupsChanged = delta.groups.size();
+    status.groupsRemoved = delta.removedGroups.size();
+    try
+    {
+        commitMutations();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Cannot reload " << filename << ": " << e.what() << std::endl;
+        return finish(false);
+    }
+    return finish(true);
+}
+
+void Manager::watch(const std::string &filename)
+{
+    watcher.reset();
+    watcher.reset(new FileWatcher(filename, [this, filename]
+                                  { reload(filename); }));
+}
+
+Manager::ReloadStatus Manager::getLastReload() const
+{
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    return lastReload;
+}
+
+namespace
+{
+    // An object found by ingest(), with the file it was read from.
+    struct IngestItem
+    {
+        std::string filepath;
+        IngestCache::Entry entry;
+    };
+
+    IngestCache::Key cacheKey(const MediaCrawler::File &file)
+    {
+        IngestCache::Key key;
+        key.size = file.size;
+        key.mtime = file.mtime;
+        key.inode = file.inode;
+        return key;
+    }
+
+    // Paths are fields of the space-separated catalog and log lines, and reach
+    // the viewers of play() only as an argv, never through a shell. Blanks and
+    // control characters, which would split the lines or reach the terminals
+    // of the clients, are refused.
+    bool storablePath(std::string_view path)
+    {
+        return std::none_of(path.begin(), path.end(), [](unsigned char c)
+                            { return c <= ' ' || c == 0x7f; });
+    }
+
+    // Reads the metadata of a media file, and hashes it unless _hashing_ is None.
+    IngestItem readItem(const MediaCrawler::File &file, contenthash::Mode hashing, uint64_t &hashedBytes,
+                        uint64_t &hashNanoseconds)
+    {
+        IngestItem item;
+        item.filepath = file.path;
+        IngestCache::Entry &entry = item.entry;
+        entry.name = file.relative;
+        entry.key = cacheKey(file);
+        if (file.type == MediaType::Photo)
+        {
+            ExifData exif;
+            exif::readFile(file.path, exif);
+            entry.latitude = exif.latitude;
+            entry.longitude = exif.longitude;
+        }
+        else
+        {
+            Mp4Data mp4;
+            mp4::readFile(file.path, mp4);
+            entry.chapters = chapterLengths(mp4, entry.duration);
+            entry.type = entry.chapters.empty() ? MediaType::Video : MediaType::Film;
+        }
+        if (hashing != contenthash::Mode::None)
+        {
+            auto hashStart = std::chrono::steady_clock::now();
+            uint64_t bytes;
+            entry.hash = contenthash::hashFile(file.path, hashing, bytes);
+            entry.hashMode = hashing;
+            hashedBytes += bytes;
+            hashNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hashStart).count();
+        }
+        return item;
+    }
+}
+
+Manager::IngestStats Manager::ingest(const std::string &directory, unsigned threads, size_t maxOpenFiles,
+                                     size_t batchSize, const std::function<void(const IngestStats &)> &progress,
+                                     std::chrono::milliseconds progressInterval, IngestCache *cache,
+                                     contenthash::Mode hashing)
+{
+    MediaCrawler crawler(threads, maxOpenFiles);
+    std::vector<std::vector<IngestItem>> batches(crawler.getThreadCount());
+    // the cache is read by the crawl: its new entries are added at the end
+    std::vector<std::vector<IngestItem>> added(crawler.getThreadCount());
+    std::atomic<unsigned long> photos{0}, videos{0}, films{0}, skipped{0}, failed{0}, unchanged{0}, removed{0};
+    std::atomic<unsigned long> duplicates{0};
+    std::atomic<uint64_t> hashedBytes{0}, hashNanoseconds{0};
+    std::mutex skippedMutex;
+    std::vector<std::string> skippedPaths;
+    // objects found unchanged whose hash is not indexed, e.g. after a restart
+    std::vector<std::vector<std::pair<std::string, uint64_t>>> unindexed(crawler.getThreadCount());
+    auto counters = [&]
+    {
+        MediaCrawler::Progress crawled = crawler.getProgress();
+        IngestStats stats;
+        stats.directories = crawled.directories;
+        stats.files = crawled.files;
+        stats.photos = photos;
+        stats.videos = videos;
+        stats.films = films;
+        stats.unchanged = unchanged;
+        stats.removed = removed;
+        stats.duplicates = duplicates;
+        stats.hashedBytes = hashedBytes;
+        stats.hashSeconds = hashNanoseconds / 1e9;
+        stats.skipped = skipped;
+        {
+            std::lock_guard<std::mutex> lock(skippedMutex);
+            stats.skippedPaths = skippedPaths;
+        }
+        stats.errors = crawled.errors + failed;
+        stats.seconds = crawled.seconds;
+        return stats;
+    };
+    std::mutex progressMutex;
+    auto lastProgress = std::chrono::steady_clock::now();
+
+    auto flush = [&](unsigned thread)
+    {
+        std::vector<IngestItem> &batch = batches[thread];
+        {
+            auto exclusive = writeLock();
+            // replaced objects are kept alive until their groups are updated
+            std::unordered_map<const Multimedia *, mmPtr> replacements;
+            std::vector<mmPtr> replaced;
+            for (IngestItem &item : batch)
+            {
+                const IngestCache::Entry &entry = item.entry;
+                // the object of a file read again is replaced
+                mmPtr previous;
+                if (deleteFileObject(entry.name, item.filepath, previous) && previous)
+                {
+                    replacements[previous.get()] = nullptr;
+                    replaced.push_back(previous);
+                }
+                try
+                {
+                    mmPtr created = createFromEntry(item.filepath, entry);
+                    ++(entry.type == MediaType::Photo ? photos : entry.type == MediaType::Video ? videos : films);
+                    if (previous)
+                    {
+                        replacements[previous.get()] = created;
+                    }
+                    if (entry.hashMode != contenthash::Mode::None && indexContent(entry.name, entry.hash))
+                    {
+                        ++duplicates;
+                    }
+                    if (cache)
+                    {
+                        added[thread].push_back(std::move(item));
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    ++failed;
+                }
+            }
+            replaceInGroups(replacements);
+        }
+        batch.clear();
+        commitMutations();
+        if (progress)
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastProgress >= progressInterval)
+            {
+                lastProgress = now;
+                progress(counters());
+            }
+        }
+    };
+
+    batchSize = std::max<size_t>(batchSize, 1);
+    auto queue = [&](unsigned thread, IngestItem &&item)
+    {
+        batches[thread].push_back(std::move(item));
+        if (batches[thread].size() >= batchSize)
+        {
+            flush(thread);
+        }
+    };
+
+    // the files whose key did not change are not opened: their object is
+    // restored from the cache if it is missing
+    MediaCrawler::Filter filter;
+    if (cache)
+    {
+        cache->resetSeen();
+        filter = [&](unsigned thread, const MediaCrawler::File &file)
+        {
+            IngestCache::Entry *entry = cache->find(file.path);
+            if (!entry)
+            {
+                return true;
+            }
+            entry->seen = true;
+            // a file hashed another way is read again
+            if (entry->key != cacheKey(file) || (hashing != contenthash::Mode::None && entry->hashMode != hashing))
+            {
+                return true;
+            }
+            ++unchanged;
+            bool exists, indexed;
+            {
+                auto shared = readLock();
+                exists = findMedia(file.relative) != nullptr;
+                indexed = contentHashes.count(file.relative) > 0;
+            }
+            if (exists && !indexed && entry->hashMode != contenthash::Mode::None)
+            {
+                unindexed[thread].emplace_back(file.relative, entry->hash);
+            }
+            if (!exists)
+            {
+                IngestItem item{file.path, *entry};
+                item.entry.name = file.relative;
+                queue(thread, std::move(item));
+            }
+            return false;
+        };
+    }
+
+    MediaCrawler::Progress crawled = crawler.crawl(directory, [&](unsigned thread, const MediaCrawler::File &file)
+                                                   {
+        if (!storablePath(file.path))
+        {
+            ++skipped;
+            std::lock_guard<std::mutex> lock(skippedMutex);
+            if (skippedPaths.size() < MAX_SKIPPED_PATHS)
+                skippedPaths.push_back(file.relative);
+            return;
+        }
+        // the metadata are read by the threads of the crawl, without lock
+        uint64_t bytes = 0, nanoseconds = 0;
+        IngestItem item = readItem(file, hashing, bytes, nanoseconds);
+        hashedBytes += bytes;
+        hashNanoseconds += nanoseconds;
+        queue(thread, std::move(item)); }, filter);
+    for (unsigned thread = 0; thread < batches.size(); ++thread)
+    {
+        if (!batches[thread].empty())
+        {
+            flush(thread);
+        }
+    }
+
+    {
+        auto exclusive = writeLock();
+        for (const auto &known : unindexed)
+        {
+            for (const auto &[name, hash] : known)
+            {
+                indexContent(name, hash);
+            }
+        }
+    }
+
+    if (cache)
+    {
+        for (std::vector<IngestItem> &items : added)
+        {
+            for (IngestItem &item : items)
+            {
+                item.entry.seen = true;
+                cache->put(item.filepath, std::move(item.entry));
+            }
+        }
+        // an unreadable directory is not a deleted one: nothing is removed
+        // unless the whole tree was read
+        if (crawled.errors == 0)
+        {
+            std::vector<std::pair<std::string, IngestCache::Entry>> gone;
+            cache->sweep(directory, gone);
+            {
+                auto exclusive = writeLock();
+                std::unordered_map<const Multimedia *, mmPtr> replacements;
+                std::vector<mmPtr> deleted;
+                for (const auto &[filepath, entry] : gone)
+                {
+                    mmPtr previous;
+                    if (deleteFileObject(entry.name, filepath, previous))
+                    {
+                        if (previous)
+                        {
+                            replacements[previous.get()] = nullptr;
+                            deleted.push_back(previous);
+                        }
+                        ++removed;
+                    }
+                }
+                replaceInGroups(replacements);
+            }
+            commitMutations();
+        }
+    }
+    return counters();
+}
+
+mmPtr Manager::createFromEntry(const std::string &filepath, const IngestCache::Entry &entry)
+{
+    if (entry.type == MediaType::Photo)
+    {
+        return createPhoto(entry.name, filepath, entry.latitude, entry.longitude);
+    }
+    if (entry.type == MediaType::Video)
+    {
+        return createVideo(entry.name, filepath, entry.duration);
+    }
+    return createFilm(entry.name, filepath, entry.duration, entry.chapters.data(), entry.chapters.size());
+}
+
+Manager::IngestStats Manager::watchDirectory(const std::string &directory, std::chrono::milliseconds quiet,
+                                             size_t batchSize, std::chrono::milliseconds interval,
+                                             contenthash::Mode hashing)
+{
+    auto watch = std::make_shared<DirectoryWatch>();
+    watch->directory = directory;
+    while (watch->directory.size() > 1 && watch->directory.back() == '/')
+    {
+        watch->directory.pop_back();
+    }
+    watch->hashing = hashing;
+    watch->stats.directory = watch->directory;
+    // the changes made during the initial ingest wait for it in the backlog
+    std::unique_lock<std::mutex> busy(watch->busy);
+    DirectoryWatch *target = watch.get();
+    watch->watcher.reset(new DirectoryWatcher(
+        watch->directory, [this, target](const std::vector<DirectoryWatcher::Change> &changes)
+        { applyChanges(*target, changes); },
+        quiet, batchSize, interval));
+    std::shared_ptr<DirectoryWatch> previous;
+    {
+        std::lock_guard<std::mutex> lock(watchesMutex);
+        previous = std::move(watches[watch->directory]);
+        watches[watch->directory] = watch;
+    }
+    previous.reset();
+    IngestStats stats;
+    try
+    {
+        stats = ingest(watch->directory, 0, 64, 256, nullptr, std::chrono::seconds(1), &watch->cache, hashing);
+    }
+    catch (const std::exception &)
+    {
+        busy.unlock();
+        unwatchDirectory(watch->directory);
+        throw;
+    }
+    std::lock_guard<std::mutex> lock(watch->statsMutex);
+    watch->stats.added += stats.photos + stats.videos + stats.films;
+    watch->stats.errors += stats.errors;
+    watch->stats.skipped += stats.skipped;
+    return stats;
+}
+
+bool Manager::unwatchDirectory(const std::string &directory)
+{
+    std::string root = directory;
+    while (root.size() > 1 && root.back() == '/')
+    {
+        root.pop_back();
+    }
+    std::shared_ptr<DirectoryWatch> watch;
+    {
+        std::lock_guard<std::mutex> lock(watchesMutex);
+        auto watchIt = watches.find(root);
+        if (watchIt == watches.end())
+        {
+            return false;
+        }
+        watch = std::move(watchIt->second);
+        watches.erase(watchIt);
+    }
+    // waits for the batch being applied, if any
+    watch.reset();
+    return true;
+}
+
+std::vector<Manager::WatchStats> Manager::getWatchStats() const
+{
+    std::vector<WatchStats> all;
+    std::lock_guard<std::mutex> lock(watchesMutex);
+    for (const auto &pair : watches)
+    {
+        const DirectoryWatch &watch = *pair.second;
+        {
+            std::lock_guard<std::mutex> statsLock(watch.statsMutex);
+            all.push_back(watch.stats);
+        }
+        all.back().backlog = watch.watcher->getBacklog();
+    }
+    return all;
+}
+
+void Manager::applyChanges(DirectoryWatch &watch, const std::vector<DirectoryWatcher::Change> &changes)
+{
+    std::lock_guard<std::mutex> busy(watch.busy);
+    auto start = std::chrono::steady_clock::now();
+    WatchStats counters;
+    const std::string &root = watch.directory;
+    std::string prefix = root == "/" ? root : root + "/";
+
+    // the files are read without lock; a file that cannot be read as a media
+    // file any more is treated as deleted
+    std::vector<IngestItem> written;
+    std::vector<std::string> gone, goneDirectories;
+    bool rescan = false;
+    for (const DirectoryWatcher::Change &change : changes)
+    {
+        if (change.kind == DirectoryWatcher::Change::Rescan)
+        {
+            rescan = true;
+            continue;
+        }
+        if (change.kind == DirectoryWatcher::Change::RemovedDirectory)
+        {
+            goneDirectories.push_back(change.path);
+            continue;
+        }
+        MediaCrawler::File file;
+        if (change.kind == DirectoryWatcher::Change::Removed || !MediaCrawler::inspect(change.path, file))
+        {
+            gone.push_back(change.path);
+            continue;
+        }
+        if (!storablePath(change.path))
+        {
+            ++counters.skipped;
+            continue;
+        }
+        file.relative = change.path.substr(prefix.size());
+        const IngestCache::Entry *cached = watch.cache.find(file.path);
+        if (cached && cached->key == cacheKey(file) &&
+            (watch.hashing == contenthash::Mode::None || cached->hashMode == watch.hashing))
+        {
+            // restored below if its object was deleted meanwhile
+            written.push_back(IngestItem{file.path, *cached});
+            continue;
+        }
+        try
+        {
+            uint64_t bytes = 0, nanoseconds = 0;
+            written.push_back(readItem(file, watch.hashing, bytes, nanoseconds));
+        }
+        catch (const std::exception &)
+        {
+            ++counters.errors;
+        }
+    }
+
+    {
+        auto exclusive = writeLock();
+        // objects replaced or deleted are kept alive until their groups are updated
+        std::unordered_map<const Multimedia *, mmPtr> replacements;
+        std::vector<mmPtr> previous;
+        std::vector<std::pair<std::string, IngestCache::Entry>> removed;
+        for (const std::string &path : goneDirectories)
+        {
+            watch.cache.eraseBelow(path, removed);
+        }
+        for (const std::string &path : gone)
+        {
+            watch.cache.erase(path, removed);
+        }
+        for (const auto &[filepath, entry] : removed)
+        {
+            mmPtr object;
+            if (deleteFileObject(entry.name, filepath, object))
+            {
+                if (object)
+                {
+                    replacements[object.get()] = nullptr;
+                    previous.push_back(object);
+                }
+                ++counters.removed;
+            }
+        }
+        for (IngestItem &item : written)
+        {
+            IngestCache::Entry &entry = item.entry;
+            const IngestCache::Entry *cached = watch.cache.find(item.filepath);
+            const Multimedia *existing = findMedia(entry.name);
+            if (cached && cached->key == entry.key && cached->hashMode == entry.hashMode && existing &&
+                existing->getFilepath() == item.filepath)
+            {
+                ++counters.unchanged;
+                continue;
+            }
+            mmPtr object;
+            bool replacing = deleteFileObject(entry.name, item.filepath, object);
+            if (object)
+            {
+                replacements[object.get()] = nullptr;
+                previous.push_back(object);
+            }
+            try
+            {
+                mmPtr created = createFromEntry(item.filepath, entry);
+                if (object)
+                {
+                    replacements[object.get()] = created;
+                }
+                if (entry.hashMode != contenthash::Mode::None)
+                {
+                    indexContent(entry.name, entry.hash);
+                }
+                ++(replacing ? counters.updated : counters.added);
+                entry.seen = true;
+                watch.cache.put(item.filepath, std::move(entry));
+            }
+            catch (const std::exception &)
+            {
+                ++counters.errors;
+            }
+        }
+        counters.groups = replaceInGroups(replacements);
+    }
+    commitMutations();
+
+    // a lost event may hide any change: the whole tree is read again
+    if (rescan)
+    {
+        IngestStats stats = ingest(root, 0, 64, 256, nullptr, std::chrono::seconds(1), &watch.cache, watch.hashing);
+        counters.added += stats.photos + stats.videos + stats.films;
+        counters.removed += stats.removed;
+        counters.unchanged += stats.unchanged;
+        counters.errors += stats.errors;
+        counters.skipped += stats.skipped;
+        ++counters.rescans;
+    }
+
+    std::lock_guard<std::mutex> lock(watch.statsMutex);
+    WatchStats &stats = watch.stats;
+    stats.added += counters.added;
+    stats.updated += counters.updated;
+    stats.removed += counters.removed;
+    stats.unchanged += counters.unchanged;
+    stats.groups += counters.groups;
+    stats.skipped += counters.skipped;
+    stats.errors += counters.errors;
+    stats.rescans += counters.rescans;
+    stats.applySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Manager::indexContent(const std::string &name, uint64_t hash)
+{
+    forgetContent(name);
+    contentHashes[name] = hash;
+    std::set<std::string> &names = contentIndex[hash];
+    names.insert(name);
+    return names.size() > 1;
+}
+
+void Manager::forgetContent(const std::string &name)
+{
+    auto hashIt = contentHashes.find(name);
+    if (hashIt == contentHashes.end())
+    {
+        return;
+    }
+    auto indexIt = contentIndex.find(hashIt->second);
+    std::set<std::string> &names = indexIt->second;
+    names.erase(name);
+    if (names.empty())
+    {
+        contentIndex.erase(indexIt);
+    }
+    contentHashes.erase(hashIt);
+}
+
+std::vector<std::vector<std::string>> Manager::findDuplicates(size_t limit) const
+{
+    std::vector<std::vector<std::string>> sets;
+    for (const auto &pair : contentIndex)
+    {
+        if (pair.second.size() > 1)
+        {
+            sets.emplace_back(pair.second.begin(), pair.second.end());
+        }
+    }
+    std::sort(sets.begin(), sets.end(), [](const std::vector<std::string> &a, const std::vector<std::string> &b)
+              { return a.size() != b.size() ? a.size() > b.size() : a.front() < b.front(); });
+    if (limit > 0 && sets.size() > limit)
+    {
+        sets.resize(limit);
+    }
+    return sets;
+}
+
+namespace
+{
+    // equal hashes, sampled ones in particular, are not enough to delete an object
+    bool confirmDuplicate(const std::string &keptPath, const std::string &path)
+    {
+        try
+        {
+            return contenthash::sameContent(keptPath, path);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+}
+
+size_t Manager::collapseDuplicates(size_t *groups)
+{
+    // each duplicate is replaced by the object with the smallest name
+    struct Candidate
+    {
+        std::string name, keptName;
+        mmPtr media, kept;
+        std::string filepath, keptPath;
+    };
+    std::vector<Candidate> candidates;
+    {
+        auto shared = readLock();
+        for (const std::vector<std::string> &names : findDuplicates())
+        {
+            auto keptIt = mediaCollection.find(names.front());
+            if (keptIt == mediaCollection.end())
+            {
+                continue;
+            }
+            for (size_t i = 1; i < names.size(); ++i)
+            {
+                auto mediaIt = mediaCollection.find(names[i]);
+                if (mediaIt != mediaCollection.end())
+                {
+                    candidates.push_back(Candidate{names[i], names.front(), mediaIt->second, keptIt->second,
+                                                   mediaIt->second->getFilepath(), keptIt->second->getFilepath()});
+                }
+            }
+        }
+    }
+
+    // the files may be large videos: they are compared without lock
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [](const Candidate &candidate)
+                                    { return !confirmDuplicate(candidate.keptPath, candidate.filepath); }),
+                     candidates.end());
+
+    std::unordered_map<const Multimedia *, mmPtr> replacements;
+    std::vector<std::string> duplicates;
+    size_t modified;
+    {
+        auto exclusive = writeLock();
+        for (const Candidate &candidate : candidates)
+        {
+            // either object may have been replaced or deleted meanwhile
+            auto mediaIt = mediaCollection.find(candidate.name);
+            auto keptIt = mediaCollection.find(candidate.keptName);
+            if (mediaIt != mediaCollection.end() && mediaIt->second == candidate.media &&
+                mediaIt->second->getFilepath() == candidate.filepath &&
+                keptIt != mediaCollection.end() && keptIt->second == candidate.kept &&
+                keptIt->second->getFilepath() == candidate.keptPath)
+            {
+                replacements[candidate.media.get()] = candidate.kept;
+                duplicates.push_back(candidate.name);
+            }
+        }
+        modified = replaceInGroups(replacements);
+        for (const std::string &name : duplicates)
+        {
+            tryDeleteByName(name);
+        }
+    }
+    commitMutations();
+    if (groups)
+    {
+        *groups = modified;
+    }
+    return duplicates.size();
+}
+
+bool Manager::deleteFileObject(const std::string &name, const std::string &filepath, mmPtr &previous)
+{
+    const Multimedia *existing = findMedia(name);
+    if (!existing || existing->getFilepath() != filepath)
+    {
+        return false;
+    }
+    auto mediaIt = mediaCollection.find(name);
+    previous = mediaIt != mediaCollection.end() ? mediaIt->second : nullptr;
+    return tryDeleteByName(name);
+}
+
+size_t Manager::replaceInGroups(const std::unordered_map<const Multimedia *, mmPtr> &replacements)
+{
+    if (replacements.empty())
+    {
+        return 0;
+    }
+    size_t modified = 0;
+    for (auto &pair : mediaGroups)
+    {
+        Group &group = *pair.second;
+        bool holds = false;
+        for (const mmPtr &item : group)
+        {
+            holds = holds || replacements.count(item.get()) > 0;
+        }
+        if (!holds)
+        {
+            continue;
+        }
+        std::vector<mmPtr> members;
+        std::unordered_set<const Multimedia *> present;
+        for (const mmPtr &item : group)
+        {
+            auto replacementIt = replacements.find(item.get());
+            const mmPtr &member = replacementIt != replacements.end() ? replacementIt->second : item;
+            if (member && present.insert(member.get()).second)
+            {
+                members.push_back(member);
+            }
+        }
+        group.clear();
+        group.append(members);
+        // replaying a group record does not replace an existing group
+        logDelete(pair.first);
+        logGroup(pair.first, group);
+        ++modified;
+    }
+    return modified;
+}
+
+ThumbnailCache::Bytes Manager::getThumbnail(const std::string &name)
+{
+    const Multimedia *media = findMedia(name);
+    if (!media || media->getType() != MediaType::Photo)
+    {
+        return nullptr;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::string filepath = media->getFilepath();
+    struct stat st;
+    if (::stat(filepath.c_str(), &st) != 0)
+    {
+        throw std::runtime_error("cannot stat " + filepath + ": " + strerror(errno));
+    }
+    int64_t mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    ThumbnailCache::Bytes thumbnail = thumbnails.find(filepath, st.st_size, mtime);
+    bool hit = thumbnail != nullptr;
+    if (!hit)
+    {
+        // a photo without thumbnail is cached as an empty one
+        auto bytes = std::make_shared<std::string>();
+        if (!exif::readThumbnail(filepath, *bytes))
+        {
+            bytes->clear();
+        }
+        thumbnail = std::move(bytes);
+        thumbnails.put(filepath, st.st_size, mtime, thumbnail);
+    }
+    thumbnails.record(hit, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count());
+    return thumbnail;
+}
+
+const ThumbnailCache &Manager::getThumbnailCache() const
+{
+    return thumbnails;
+}
+
+void Manager::textToSnapshot(const std::string &textFile, const std::string &snapshotFile)
+{
+    Manager manager;
+    manager.readParallel(textFile);
+    manager.saveSnapshot(snapshotFile);
+}
+
+void Manager::snapshotToText(const std::string &snapshotFile, const std::string &textFile)
+{
+    Manager manager;
+    manager.loadSnapshot(snapshotFile);
+    manager.save(textFile);
+}
+
+std::map<std::string, mmPtr> Manager::getMedias() const
+{
+    requireMaterialized();
+    return mediaCollection;
+}
+
+void Manager::setNameFilterRate(double falsePositiveRate)
+{
+    rebuildNameFilter(nameFilter.getCapacity(), falsePositiveRate);
+}
+
+const CountingBloomFilter &Manager::getNameFilter() const
+{
+    return nameFilter;
+}
+
+unsigned long Manager::getLookupCount() const
+{
+    return lookups;
+}
+
+unsigned long Manager::getSkippedLookupCount() const
+{
+    return skippedLookups;
+}
+
+bool Manager::mayExist(const std::string &name) const noexcept
+{
+    ++lookups;
+    if (nameFilter.mayContain(name))
+    {
+        return true;
+    }
+    ++skippedLookups;
+    return false;
+}
+
+void Manager::addName(const std::string &name)
+{
+    // the name is already in a collection: growing re-inserts it with the others
+    if (nameFilter.size() >= nameFilter.getCapacity())
+    {
+        rebuildNameFilter(2 * nameFilter.getCapacity(), nameFilter.getFalsePositiveRate());
+    }
+    else
+    {
+        nameFilter.insert(name);
+    }
+}
+
+void Manager::rebuildNameFilter(size_t capacity, double falsePositiveRate)
+{
+    size_t needed = mediaCollection.size() + mediaGroups.size();
+    CountingBloomFilter filter(capacity > needed ? capacity : needed, falsePositiveRate);
+    for (const auto &pair : mediaCollection)
+    {
+        filter.insert(pair.first);
+    }
+    for (const auto &pair : mediaGroups)
+    {
+        filter.insert(pair.first);
+    }
+    nameFilter = std::move(filter);
+}
+
+const CatalogStats &Manager::getStats() const
+{
+    requireMaterialized();
+    return stats;
+}
+
+const CatalogStats &Manager::getGroupStats(const std::string &groupName) const
+{
+    auto groupIt = mediaGroups.find(groupName);
+    if (groupIt == mediaGroups.end())
+    {
+        throw NamingError("No group found with the name " + groupName);
+    }
+    return groupIt->second->getStats();
+}
+
+void Manager::forEachMedia(const std::function<bool(const Multimedia &)> &visit,
+                           const std::string *after) const
+{
+    requireMaterialized();
+    auto it = after ? mediaCollection.upper_bound(*after) : mediaCollection.begin();
+    for (; it != mediaCollection.end(); ++it)
+    {
+        if (!visit(*it->second))
+            return;
+    }
+}
+
+namespace
+{
+    // Cursors are the hex encoding of the sort key of the last listed object:
+    // "n<name>" when listing by name, "d<duration>:<name>" when listing by duration.
+    std::string encodeCursor(const std::string &key)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string cursor;
+        cursor.reserve(2 * key.size());
+        for (unsigned char c : key)
+        {
+            cursor += digits[c >> 4];
+            cursor += digits[c & 15];
+        }
+        return cursor;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    }
+
+    std::string decodeCursor(const std::string &cursor)
+    {
+        if (cursor.size() % 2 != 0)
+            throw std::invalid_argument("Invalid cursor");
+        std::string key;
+        key.reserve(cursor.size() / 2);
+        for (size_t i = 0; i < cursor.size(); i += 2)
+        {
+            int hi = hexValue(cursor[i]);
+            int lo = hexValue(cursor[i + 1]);
+            if (hi < 0 || lo < 0)
+                throw std::invalid_argument("Invalid cursor");
+            key += char(hi * 16 + lo);
+        }
+        return key;
+    }
+
+    struct DurationKey
+    {
+        int duration;
+        const Multimedia *media;
+
+        bool operator<(const DurationKey &other) const
+        {
+            if (duration != other.duration)
+                return duration < other.duration;
+            return media->getName() < other.media->getName();
+        }
+    };
+}
+
+std::string Manager::listMedias(const std::function<void(const Multimedia &)> &emit, size_t limit,
+                                bool byDuration, const MediaType *type, const std::string &cursor) const
+{
+    requireMaterialized();
+    // a page cannot be larger than the collection, and limit + 1 must not wrap
+    limit = std::min(limit, mediaCollection.size());
+    std::string key = decodeCursor(cursor);
+    if (!key.empty() && key[0] != (byDuration ? 'd' : 'n'))
+        throw std::invalid_argument("Cursor does not match this ordering");
+
+    if (!byDuration)
+    {
+        std::string after = key.empty() ? "" : key.substr(1);
+        std::string last;
+        size_t count = 0;
+        bool more = false;
+        forEachMedia([&](const Multimedia &media)
+                     {
+                         if (type && media.getType() != *type)
+                             return true;
+                         if (count == limit)
+                         {
+                             more = true;
+                             return false;
+                         }
+                         emit(media);
+                         last = media.getName();
+                         ++count;
+                         return true; },
+                     key.empty() ? nullptr : &after);
+        return more ? encodeCursor("n" + last) : "";
+    }
+
+    // by duration: select the limit + 1 smallest keys after the cursor
+    bool hasAfter = !key.empty();
+    int afterDuration = 0;
+    std::string afterName;
+    if (hasAfter)
+    {
+        size_t colon = key.find(':');
+        if (colon == std::string::npos)
+            throw std::invalid_argument("Invalid cursor");
+        afterDuration = atoi(key.substr(1, colon - 1).c_str());
+        afterName = key.substr(colon + 1);
+    }
+
+    TopK<DurationKey> best(limit + 1);
+    for (const auto &pair : mediaCollection)
+    {
+        const Multimedia &media = *pair.second;
+        MediaType t = media.getType();
+        if (t == MediaType::Photo || (type && t != *type))
+            continue;
+        int duration = static_cast<const Video &>(media).getDuration();
+        if (hasAfter && (duration < afterDuration || (duration == afterDuration && pair.first <= afterName)))
+            continue;
+        best.push(DurationKey{duration, &media});
+    }
+
+    std::vector<DurationKey> page = best.takeSorted();
+    bool more = page.size() > limit;
+    if (more)
+        page.pop_back();
+    for (const DurationKey &entry : page)
+        emit(*entry.media);
+    if (!more || page.empty())
+        return "";
+    const DurationKey &last = page.back();
+    return encodeCursor("d" + std::to_string(last.duration) + ":" + last.media->getName());
 }
\ No newline at end of file
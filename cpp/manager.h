@@ -13,12 +13,35 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <functional>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 #include "multimedia.h"
 #include "group.h"
 #include "photo.h"
 #include "video.h"
 #include "film.h"
+#include "query.h"
+#include "bloomfilter.h"
+#include "lazycatalog.h"
+#include "mutationlog.h"
+#include "filewatcher.h"
+#include "catalogload.h"
+#include "contenthash.h"
+#include "crawler.h"
+#include "ingestcache.h"
+#include "thumbcache.h"
+#include "dirwatcher.h"
+
+struct CatalogRecord;
 
 /** @typedef mmPtr
  *  @brief Alias for shared pointer to Multimedia objects
@@ -57,6 +80,10 @@ using gPtr = std::shared_ptr<Group>;
  * 
  * @note The Manager uses maps for efficient lookup of multimedia objects and groups by name
  * 
+ * @note The Manager does not lock itself: when it is shared between threads,
+ * readers hold readLock() and writers hold writeLock() around their calls, as
+ * CommandRouter does.
+ * 
  * @sa Multimedia, Photo, Video, Film, Group
  */
 class Manager
@@ -73,9 +100,10 @@ public:
      * @brief Destructor for Manager
      * 
      * Cleans up all managed multimedia objects and groups through automatic
-     * cleanup of shared pointers.
+     * cleanup of shared pointers, after detaching the catalog statistics
+     * from the objects.
      */
-    ~Manager() = default;
+    ~Manager();
 
     /**
      * @brief Creates a new Photo object and adds it to the media collection
@@ -90,10 +118,28 @@ public:
      * 
      * @return A shared pointer to the newly created Photo object
      * 
+     * @throws std::invalid_argument if a coordinate is not a finite number
      * @sa Photo
      */
     pPtr createPhoto(std::string name = "", std::string filepath = "", double latitude = 0, double longitude = 0);
 
+    /**
+     * @brief Creates a Photo located by the EXIF metadata of its file
+     * 
+     * Same as createPhoto(), but the latitude and longitude are read from the
+     * GPS directory of the EXIF block of the JPEG file _filepath_; they are 0
+     * if the file has no valid GPS coordinates.
+     * 
+     * @param[in] name The name/identifier of the photo
+     * @param[in] filepath The file path to the JPEG file
+     * 
+     * @return A shared pointer to the newly created Photo object
+     * 
+     * @throws std::runtime_error if the file cannot be opened
+     * @sa exif::readFile()
+     */
+    pPtr importPhoto(std::string name, std::string filepath);
+
     /**
      * @brief Creates a new Video object and adds it to the media collection
      * 
@@ -110,6 +156,25 @@ public:
      */
     vPtr createVideo(std::string name = "", std::string filepath = "", int duration = 0);
 
+    /**
+     * @brief Creates a Video or a Film described by the metadata of its file
+     * 
+     * The duration and the chapters are read from the movie box of the MP4
+     * file _filepath_. A Film is created if the file has chapters, whose
+     * lengths are rounded to whole seconds so that they add up to the
+     * duration; otherwise a Video is created. The duration is 0 if the file
+     * has no valid movie box.
+     * 
+     * @param[in] name The name/identifier of the video
+     * @param[in] filepath The file path to the MP4 file
+     * 
+     * @return A shared pointer to the newly created Video or Film object
+     * 
+     * @throws std::runtime_error if the file cannot be opened
+     * @sa mp4::readFile()
+     */
+    vPtr importVideo(std::string name, std::string filepath);
+
     /**
      * @brief Creates a new Film object and adds it to the media collection
      * 
@@ -148,12 +213,14 @@ public:
      * Creates a Group with the specified name for organizing multimedia objects.
      * 
      * @param[in] groupName The name of the group (default: "DefaultGroup")
+     * @param[in] members The initial members of the group, which are logged
+     *            with it, unlike the members added later through the Group
      * 
      * @return A shared pointer to the newly created Group object
      * 
      * @sa Group
      */
-    gPtr createGroup(std::string groupName = "DefaultGroup");
+    gPtr createGroup(std::string groupName = "DefaultGroup", const std::vector<mmPtr> &members = {});
 
     /**
      * @brief Searches for and displays a multimedia object or group by name
@@ -165,9 +232,147 @@ public:
      * @param[in,out] os The output stream to display the results
      * 
      * @return A reference to the modified output stream
+     * 
+     * @throws NamingError if no multimedia object or group has this name
+     * @sa trySearchAndDisplay()
      */
     std::ostream &searchAndDisplay(const std::string &name, std::ostream &os) const;
 
+    /**
+     * @brief Searches for and displays a multimedia object or group, without throwing
+     * 
+     * Same as searchAndDisplay() but reports a miss through its return value,
+     * which is much cheaper than unwinding an exception when many requests
+     * are for unknown names.
+     * 
+     * @param[in] name The name of the multimedia object or group to search for
+     * @param[in,out] os The output stream to display the results
+     * 
+     * @return false if no multimedia object or group has this name
+     */
+    bool trySearchAndDisplay(const std::string &name, std::ostream &os) const;
+
+    /**
+     * @brief Finds a multimedia object by name, without throwing
+     * 
+     * The returned pointer is not shared: it remains valid as long as the
+     * object stays in the collection.
+     * 
+     * @param[in] name The name of the multimedia object
+     * 
+     * @return The multimedia object, or nullptr if no object has this name
+     */
+    const Multimedia *findMedia(const std::string &name) const noexcept;
+
+    /**
+     * @brief Finds a group by name, without throwing
+     * 
+     * @param[in] name The name of the group
+     * 
+     * @return The group, or nullptr if no group has this name
+     */
+    const Group *findGroup(const std::string &name) const noexcept;
+
+    /**
+     * @brief Retrieves the version stamp of a multimedia object or group, without throwing
+     * 
+     * @param[in] name The name of the multimedia object or group
+     * 
+     * @return The current version stamp, or an empty optional if nothing has this name
+     * @sa getVersion()
+     */
+    std::optional<unsigned long> findVersion(const std::string &name) const noexcept;
+
+    /**
+     * @brief Lists the objects that have the same content
+     * 
+     * Only the objects added by ingest() with a content hash are known.
+     * 
+     * @param[in] limit The maximum number of sets returned, 0 for all
+     * 
+     * @return The sets of names of objects with the same content hash, each
+     *         sorted, by decreasing size
+     */
+    std::vector<std::vector<std::string>> findDuplicates(size_t limit = 0) const;
+
+    /**
+     * @brief Keeps one object of each set returned by findDuplicates()
+     * 
+     * The object with the smallest name is kept; the others are deleted and
+     * replaced by it in the groups that held them. Hashes may collide, and
+     * sampled ones only cover parts of large files: an object is only deleted
+     * once its file is found identical, byte for byte, to the file of the kept
+     * one. Files that cannot be read are kept.
+     * 
+     * The candidates are listed under readLock() and their files compared
+     * without lock; under writeLock(), only those whose objects are still in
+     * the catalog with the same files are deleted. Must be called without
+     * holding the locks.
+     * 
+     * @param[out] groups If not null, set to the number of groups modified
+     * 
+     * @return The number of objects deleted
+     * 
+     * @throws std::runtime_error if the deletions could not be logged
+     */
+    size_t collapseDuplicates(size_t *groups = nullptr);
+
+    /**
+     * @brief Returns the thumbnail embedded in the EXIF block of a photo
+     * 
+     * Thumbnails are kept in a cache bounded by THUMBNAIL_CACHE_BYTES and
+     * read again when the size or modification time of the file changes.
+     * Safe under readLock(): the cache has its own mutex.
+     * 
+     * @param[in] name The name of the photo
+     * 
+     * @return nullptr if no photo has this name, an empty string if the photo
+     *         has no thumbnail
+     * @throws std::runtime_error if the file of the photo cannot be read
+     */
+    ThumbnailCache::Bytes getThumbnail(const std::string &name);
+
+    /** @brief Returns the cache of getThumbnail(), for its statistics */
+    const ThumbnailCache &getThumbnailCache() const;
+
+    /** @brief Total size of the thumbnails kept by getThumbnail() */
+    static constexpr size_t THUMBNAIL_CACHE_BYTES = 32 << 20;
+
+    /**
+     * @brief Retrieves the version stamp of a multimedia object or group by name
+     * 
+     * Searches both the media collection and groups collection. Clients that
+     * cached the output of searchAndDisplay() together with this version can
+     * skip fetching it again as long as the version is unchanged.
+     * 
+     * @param[in] name The name of the multimedia object or group
+     * 
+     * @return The current version stamp of the object or group
+     * 
+     * @throws NamingError if no multimedia object or group has this name
+     * 
+     * @sa Multimedia::getVersion(), Group::getVersion()
+     */
+    unsigned long getVersion(const std::string &name) const;
+
+    /**
+     * @brief Runs a compiled query over the media collection
+     * 
+     * Restricts the scan to the range of the name index allowed by the name
+     * constraints of the query, evaluates the query on each object of that range
+     * and streams the matching objects to _emit_, honouring the order by, limit
+     * and offset clauses. Results ordered by a numeric field are selected with
+     * a bounded heap of offset + limit entries instead of a full sort.
+     * 
+     * @param[in] query The compiled query
+     * @param[in] emit Called with each result, in order
+     * 
+     * @return The number of results passed to _emit_
+     * 
+     * @sa Query
+     */
+    size_t runQuery(const Query &query, const std::function<void(const Multimedia &)> &emit) const;
+
     /**
      * @brief Plays a multimedia object by name
      * 
@@ -178,6 +383,17 @@ public:
      */
     void playMedia(const std::string &name) const;
 
+    /**
+     * @brief Plays a multimedia object by name, reporting a miss to the caller
+     * 
+     * Same as playMedia() but nothing is printed when the object does not exist.
+     * 
+     * @param[in] name The name of the multimedia object to play
+     * 
+     * @return false if no multimedia object has this name
+     */
+    bool tryPlayMedia(const std::string &name) const;
+
     /**
      * @brief Deletes a multimedia object or group by name
      * 
@@ -185,9 +401,24 @@ public:
      * the respective collection.
      * 
      * @param[in] name The name of the multimedia object or group to delete
+     * 
+     * @throws NamingError if no multimedia object or group has this name
+     * @sa tryDeleteByName()
      */
     void deleteByName(const std::string &name);
 
+    /**
+     * @brief Deletes a multimedia object or group by name, without throwing
+     * 
+     * Unlike deleteByName(), prints nothing: it is also used by the bulk
+     * operations (log replay, ingest, collapseDuplicates()...).
+     * 
+     * @param[in] name The name of the multimedia object or group to delete
+     * 
+     * @return false if no multimedia object or group has this name
+     */
+    bool tryDeleteByName(const std::string &name);
+
     /**
      * @brief Reads multimedia data from a file and constructs objects
      * 
@@ -195,10 +426,445 @@ public:
      * multimedia objects, adding them to the media collection. This enables
      * persistence and recovery of multimedia data.
      * 
+     * Groups saved by save() are rebuilt as well; their members must appear
+     * before them in the file.
+     * 
+     * The file is memory-mapped and parsed in place by a CatalogParser. Malformed
+     * lines and lines whose name already exists are reported on std::cerr with
+     * their line number and skipped; the rest of the file is still loaded.
+     * 
      * @param[in] filename The path to the file to read from
      */
     void read(const std::string& filename);
 
+    /**
+     * @brief Reads multimedia data from a file using several threads
+     * 
+     * Produces the same collections and reports the same errors as read(), but
+     * the file is split into newline-aligned chunks that are parsed in parallel,
+     * each thread constructing the objects of its chunk in a private staging
+     * buffer. The staged objects are then merged into the collections in file
+     * order, in one bulk insert: when a name appears several times, the first
+     * occurrence is kept and the others are reported, as read() does.
+     * 
+     * @param[in] filename The path to the file to read from
+     * @param[in] threads The number of threads, 0 for the number of cores
+     */
+    void readParallel(const std::string &filename, unsigned threads = 0);
+
+    /**
+     * @brief Reads a text catalog in the background
+     * 
+     * Same as read(), but the file is loaded by another thread, which parses
+     * _batchSize_ lines at a time without lock and adds them under
+     * writeLock(), so that the catalog can be served while it fills: objects
+     * are found as soon as their batch is added, and isLoading() tells that a
+     * name not found yet may still come. Must be called without holding the
+     * locks; a load started before is waited for first.
+     * 
+     * @param[in] filename The path to the file to read from
+     * @param[in] batchSize The number of lines added per write lock
+     * @return The handle reporting the progress of the load
+     * 
+     * @throws std::runtime_error if the file cannot be opened
+     * @sa CatalogLoad
+     */
+    std::shared_ptr<const CatalogLoad> readAsync(const std::string &filename, size_t batchSize = 4096);
+
+    /** @brief Returns true while a load started by readAsync() is running */
+    bool isLoading() const;
+
+    /** @brief Returns the handle of the last load started by readAsync(), or nullptr */
+    std::shared_ptr<const CatalogLoad> getLoad() const;
+
+    /**
+     * @brief Saves the whole catalog to a file
+     * 
+     * Writes every multimedia object in the format of Photo::write(),
+     * Video::write() and Film::write(), followed by one line per group:
+     * `GroupIds <n> <first ID> <differences...> <group name>` (the group name
+     * comes last so that it may contain spaces). The ID of an object is its
+     * rank in the file, so that members are stored as small integers instead
+     * of repeated names, and read() rebuilds groups by indexing instead of
+     * name lookups. Group members that are no longer in the media collection
+     * are not saved.
+     * 
+     * The catalog is streamed in a single pass through one large buffer into a
+     * temporary file, which then atomically replaces _filename_.
+     * 
+     * @param[in] filename The path to the file to write
+     * 
+     * @throws std::runtime_error on I/O error, in which case _filename_ is unchanged
+     * @sa CatalogWriter, read()
+     */
+    void save(const std::string &filename) const;
+
+    /**
+     * @brief Saves the whole catalog to a binary snapshot
+     * 
+     * Same content as save(), in the format described in snapshot.h: groups
+     * refer to their members by index instead of by name.
+     * 
+     * @param[in] filename The path to the file to write
+     * 
+     * @throws std::runtime_error on I/O error, in which case _filename_ is unchanged
+     * @sa SnapshotWriter
+     */
+    void saveSnapshot(const std::string &filename) const;
+
+    /**
+     * @brief Loads a binary snapshot written by saveSnapshot()
+     * 
+     * The snapshot is memory-mapped and its checksums verified before anything
+     * is added, so a corrupted file leaves the collections unchanged. Names that
+     * already exist are reported on std::cerr and skipped, as read() does.
+     * 
+     * @param[in] filename The path to the snapshot
+     * 
+     * @return The last log segment folded into the snapshot by compact(), 0 if none
+     * 
+     * @throws std::runtime_error if the file cannot be read, has an unsupported
+     *         version or is corrupted
+     * @sa SnapshotReader
+     */
+    unsigned long loadSnapshot(const std::string &filename);
+
+    /**
+     * @brief Converts a text catalog to a binary snapshot
+     * 
+     * @param[in] textFile The catalog to read with read()
+     * @param[in] snapshotFile The snapshot to write with saveSnapshot()
+     */
+    static void textToSnapshot(const std::string &textFile, const std::string &snapshotFile);
+
+    /**
+     * @brief Converts a binary snapshot to a text catalog
+     * 
+     * @param[in] snapshotFile The snapshot to load with loadSnapshot()
+     * @param[in] textFile The catalog to write with save()
+     */
+    static void snapshotToText(const std::string &snapshotFile, const std::string &textFile);
+
+    /**
+     * @brief Opens a binary snapshot without loading it
+     * 
+     * Only the groups and their members are constructed. The other objects of
+     * the snapshot are found by binary search in the mapped file and
+     * materialised on first access, then kept in a cache of _cacheCapacity_
+     * objects; they can be deleted, and their names cannot be reused.
+     * 
+     * The const operations over the whole catalog (runQuery(), listMedias(),
+     * getStats(), save()...) cannot materialise the remaining objects while
+     * other readers share the Manager: materialize() must be called first,
+     * under writeLock(), after which the Manager behaves as if loadSnapshot()
+     * had been called. They throw std::logic_error otherwise. The Manager
+     * operations that modify the catalog materialise the snapshot by
+     * themselves.
+     * 
+     * Each object keeps the version stamp it was given when the snapshot was
+     * opened, even if it is evicted from the cache and materialised again.
+     * 
+     * Names that already exist are reported on std::cerr and hidden in the
+     * snapshot.
+     * 
+     * @param[in] filename The path to the snapshot
+     * @param[in] cacheCapacity The maximum number of materialised objects kept
+     * 
+     * @throws std::runtime_error if the snapshot cannot be opened
+     * @sa LazyCatalog
+     */
+    void openSnapshot(const std::string &filename, size_t cacheCapacity = 4096);
+
+    /** @brief Returns the snapshot opened by openSnapshot(), or nullptr */
+    const LazyCatalog *getLazyCatalog() const;
+
+    /**
+     * @brief Materialises every object of the snapshot opened by openSnapshot()
+     * 
+     * Must be called under writeLock() before the const operations over the
+     * whole catalog, which can then run under readLock().
+     * 
+     * @throws std::runtime_error or std::out_of_range if an entry of the
+     *         snapshot is corrupted, in which case the snapshot stays open and
+     *         nothing is materialised
+     */
+    void materialize();
+
+    /**
+     * @brief Makes the catalog durable with a write-ahead log
+     * 
+     * Loads _basePath_.snap if it exists, then replays the log segments
+     * _basePath_.log.1, _basePath_.log.2... in order, and appends every
+     * following mutation (creations, copyAndCreateFilm(), deletions and bulk
+     * loads) as a record of a new segment. Records are synced in batches by a
+     * MutationLog (group commit); commitMutations() waits for them.
+     * 
+     * Changes made directly through the objects or groups returned by the
+     * Manager (setters, Group::push_back()...) and objects of a snapshot opened
+     * by openSnapshot() are not logged; they reach the disk with the next
+     * compaction.
+     * 
+     * The snapshot records the last segment folded into it, so the segments
+     * left behind by a crash in the middle of a compaction are not replayed
+     * over it. Replaying a record that creates an existing object replaces it.
+     * 
+     * @param[in] basePath The path of the snapshot and log files, without extension
+     * @param[in] batchSize The number of pending records that triggers a sync
+     * @param[in] maxDelay The longest time a record waits before being synced
+     * @param[in] compactionSize The log size in bytes above which commitMutations()
+     *            starts a compaction
+     * 
+     * @throws std::runtime_error if the files cannot be read or created
+     */
+    void openLog(const std::string &basePath, size_t batchSize = 64,
+                 std::chrono::microseconds maxDelay = std::chrono::milliseconds(2),
+                 size_t compactionSize = 64 << 20);
+
+    /**
+     * @brief Waits until the mutations of the calling thread are on disk
+     * 
+     * Starts a compaction if the log has grown past its limit. Must be called
+     * without holding readLock() or writeLock(), so that other threads can add
+     * their records to the same batch.
+     * 
+     * @throws std::runtime_error if the log could not be written
+     */
+    void commitMutations();
+
+    /**
+     * @brief Folds the log into a new snapshot in the background
+     * 
+     * Under readLock(), the current log segment is closed, a new one is started
+     * and the collections are copied: the objects are shared, but the member
+     * lists of the groups are copied, since they may change. A thread then
+     * writes _basePath_.snap from the copy and removes the old segments, while
+     * readers and writers go on. Must be called without holding the locks.
+     * 
+     * @return false if there is no log or a compaction is already running
+     */
+    bool compact();
+
+    /** @brief Returns true while a compaction is running */
+    bool isCompacting() const;
+
+    /** @brief Returns the log opened by openLog(), or nullptr */
+    const MutationLog *getLog() const;
+
+    /**
+     * @struct SaveStatus
+     * @brief Outcome of the last backgroundSave()
+     */
+    struct SaveStatus
+    {
+        enum State { None, Running, Succeeded, Failed } state = None;
+        std::string filename;
+        double seconds = 0;    ///< duration of the save, fork included
+        std::time_t finished = 0;
+    };
+
+    /**
+     * @brief Saves the catalog from a forked child process
+     * 
+     * The process is forked under readLock() (writeLock() if a snapshot is
+     * opened lazily, since the child materialises it), so that the child gets a
+     * consistent copy-on-write image of the catalog, which it writes with
+     * save(), or saveSnapshot() if _filename_ ends with `.snap`, before exiting.
+     * Meanwhile the parent goes on serving; a thread waits for the child and
+     * records the outcome returned by getLastSave(). Must be called without
+     * holding the locks.
+     * 
+     * @param[in] filename The path to the file to write
+     * @return false if a save is already running or fork() failed
+     */
+    bool backgroundSave(const std::string &filename);
+
+    /** @brief Returns the outcome of the last backgroundSave() */
+    SaveStatus getLastSave() const;
+
+    /**
+     * @struct ReloadStatus
+     * @brief Outcome of the last reload()
+     */
+    struct ReloadStatus
+    {
+        enum State { None, Running, Succeeded, Failed } state = None;
+        std::string filename;
+        unsigned long count = 0;   ///< number of reloads, failed ones included
+        double loadSeconds = 0;    ///< parsing the file, without lock
+        double diffSeconds = 0;    ///< computing the delta, under writeLock()
+        double swapSeconds = 0;    ///< applying the delta, under writeLock()
+        size_t added = 0, changed = 0, removed = 0;  ///< objects
+        size_t groupsChanged = 0, groupsRemoved = 0; ///< groups added or rebuilt, groups removed
+        std::time_t finished = 0;
+    };
+
+    /**
+     * @brief Makes the catalog identical to a text catalog file
+     * 
+     * The file is parsed by readParallel() into a private catalog, without any
+     * lock. Then, under writeLock(), the delta between the two catalogs is
+     * computed (the objects that are new or whose content changed, the objects
+     * that are no longer in the file, and the groups that are new, whose
+     * members changed or that are gone) and applied alone, so that requests
+     * are only held for the time of a linear scan and never see a half-loaded
+     * catalog. Unchanged objects and groups are kept, with their version stamps.
+     * 
+     * The file wins over mutations made by other threads while it is parsed:
+     * the delta is computed against the catalog they left.
+     * The delta is logged if openLog() was called. Must be called without
+     * holding the locks; concurrent reloads run one after the other.
+     * 
+     * @param[in] filename The catalog, in the format of save()
+     * @return false if the file cannot be read, in which case nothing changes
+     * @sa getLastReload()
+     */
+    bool reload(const std::string &filename);
+
+    /**
+     * @brief Reloads the catalog whenever a file changes
+     * 
+     * Starts a FileWatcher calling reload() from its thread each time
+     * _filename_ is rewritten or replaced. Replaces the previous watch, if any.
+     * 
+     * @param[in] filename The catalog to watch
+     * 
+     * @throws std::runtime_error if the file cannot be watched
+     */
+    void watch(const std::string &filename);
+
+    /** @brief Returns the outcome of the last reload() */
+    ReloadStatus getLastReload() const;
+
+    /**
+     * @struct IngestStats
+     * @brief Counters of an ingest()
+     */
+    struct IngestStats
+    {
+        unsigned long directories = 0; ///< directories read
+        unsigned long files = 0;       ///< regular files seen
+        unsigned long photos = 0, videos = 0, films = 0; ///< objects created
+        unsigned long unchanged = 0;   ///< files known from the cache, not opened
+        unsigned long removed = 0;     ///< objects of deleted files, removed
+        unsigned long duplicates = 0;  ///< objects created with the content of another
+        unsigned long long hashedBytes = 0; ///< bytes read by the content hash
+        double hashSeconds = 0;        ///< time spent hashing, summed over the threads
+        unsigned long skipped = 0;     ///< media files whose path has blanks or control characters
+        std::vector<std::string> skippedPaths; ///< the first MAX_SKIPPED_PATHS of them, relative to the tree
+        unsigned long errors = 0;      ///< unreadable files or directories, names already used
+        double seconds = 0;
+    };
+
+    /** @brief Number of skipped files reported by name in IngestStats */
+    static constexpr size_t MAX_SKIPPED_PATHS = 16;
+
+    /**
+     * @brief Adds every photo and video of a directory tree to the catalog
+     * 
+     * The tree is crawled by a MediaCrawler. Its threads read the metadata of
+     * each file they find, as importPhoto() and importVideo() do, and hand the
+     * objects to the create methods in batches of _batchSize_, each added
+     * under writeLock() and committed to the log, if any. The name of an
+     * object is its path relative to _directory_; files whose path contains
+     * blanks or control characters, which the catalog format cannot hold, are
+     * skipped and counted, the first ones by name. The object of
+     * a file read again replaces the one read before. Must be called without
+     * holding the locks.
+     * 
+     * With a _cache_, the files whose size, modification time and inode are
+     * those of their cache entry are not opened: their object, if missing, is
+     * created from the cache. The entries of the files read are added to the
+     * cache, and, if the whole tree could be read, the objects of the cached
+     * files that are gone are deleted. The cache is not saved.
+     * 
+     * Unless _hashing_ is None, the content of each file read is hashed by the
+     * same threads and indexed: the objects created with the hash of another
+     * are counted as duplicates, see findDuplicates().
+     * 
+     * @param[in] directory The root of the tree
+     * @param[in] threads The number of threads, 0 for the number of cores
+     * @param[in] maxOpenFiles The maximum number of files open at once
+     * @param[in] batchSize The number of objects added per write lock
+     * @param[in] progress If not null, called with the counters every _progressInterval_
+     * @param[in] progressInterval The time between two calls to _progress_
+     * @param[in,out] cache If not null, the metadata of the files of previous ingests
+     * @param[in] hashing How the content of the files is hashed
+     * 
+     * @return The final counters
+     * 
+     * @throws std::runtime_error if _directory_ cannot be read
+     */
+    IngestStats ingest(const std::string &directory, unsigned threads = 0, size_t maxOpenFiles = 64,
+                       size_t batchSize = 256,
+                       const std::function<void(const IngestStats &)> &progress = nullptr,
+                       std::chrono::milliseconds progressInterval = std::chrono::seconds(1),
+                       IngestCache *cache = nullptr,
+                       contenthash::Mode hashing = contenthash::Mode::Sampled);
+
+    /**
+     * @struct WatchStats
+     * @brief Counters of a watchDirectory()
+     */
+    struct WatchStats
+    {
+        std::string directory;
+        DirectoryWatcher::Backlog backlog; ///< changes waiting to be applied
+        unsigned long added = 0;     ///< objects of new files
+        unsigned long updated = 0;   ///< objects of rewritten files, replaced
+        unsigned long removed = 0;   ///< objects of deleted files
+        unsigned long unchanged = 0; ///< files reported but identical to their cache entry
+        unsigned long groups = 0;    ///< groups modified by a replacement or a removal
+        unsigned long skipped = 0;   ///< media files whose path has blanks or control characters
+        unsigned long errors = 0;    ///< unreadable files, names already used
+        unsigned long rescans = 0;   ///< trees read again after lost events
+        double applySeconds = 0;     ///< time spent applying changes
+    };
+
+    /**
+     * @brief Keeps the catalog in step with a directory tree
+     * 
+     * The tree is first ingested, as by ingest() with an in-memory cache;
+     * a DirectoryWatcher then reports the files written, moved or deleted
+     * below it. Each batch of changes is read without lock, then applied
+     * under a single writeLock() and committed to the log, if any: the
+     * objects of new files are created, those of rewritten files replaced,
+     * and those of deleted files removed, from the groups as well. Changes
+     * are debounced for _quiet_ and applied by at most _batchSize_ every
+     * _interval_. Replaces the watch of the same directory, if any. Must be
+     * called without holding the locks.
+     * 
+     * @param[in] directory The root of the tree
+     * @param[in] quiet How long a file must stay untouched before it is read
+     * @param[in] batchSize The maximum number of changes applied at once
+     * @param[in] interval The minimum time between two batches
+     * @param[in] hashing How the content of the files is hashed
+     * 
+     * @return The counters of the initial ingest
+     * 
+     * @throws std::runtime_error if _directory_ cannot be read or watched
+     */
+    IngestStats watchDirectory(const std::string &directory,
+                               std::chrono::milliseconds quiet = std::chrono::milliseconds(500),
+                               size_t batchSize = 1024,
+                               std::chrono::milliseconds interval = std::chrono::milliseconds(100),
+                               contenthash::Mode hashing = contenthash::Mode::Sampled);
+
+    /**
+     * @brief Stops a watchDirectory(); the objects of the tree are kept
+     * 
+     * @return false if the directory is not watched
+     */
+    bool unwatchDirectory(const std::string &directory);
+
+    /** @brief Returns the counters of the watched directories, sorted by directory */
+    std::vector<WatchStats> getWatchStats() const;
+
+    /** @brief Locks the Manager for reading (shared) */
+    std::shared_lock<std::shared_mutex> readLock() const;
+
+    /** @brief Locks the Manager for writing (exclusive) */
+    std::unique_lock<std::shared_mutex> writeLock();
+
     /**
      * @brief Retrieves the media collection
      * 
@@ -206,15 +872,261 @@ public:
      * indexed by name.
      * 
      * @return A map of strings (names) to shared pointers of Multimedia objects
+     * 
+     * @note Copying the map copies every shared pointer. Prefer forEachMedia()
+     *       to walk a large collection.
      */
     std::map<std::string, mmPtr> getMedias() const;
 
+    /**
+     * @brief Retrieves the statistics of the media collection
+     * 
+     * The statistics are maintained by every create method, setter and
+     * deleteByName(), so this method answers in constant time.
+     * 
+     * @return The statistics of the whole media collection
+     * @sa CatalogStats
+     */
+    const CatalogStats &getStats() const;
+
+    /**
+     * @brief Retrieves the statistics of a group by name
+     * 
+     * @param[in] groupName The name of the group
+     * @return The statistics of the items of the group
+     * 
+     * @throws NamingError if no group has this name
+     * @sa Group::getStats()
+     */
+    const CatalogStats &getGroupStats(const std::string &groupName) const;
+
+    /**
+     * @brief Changes the false positive rate of the name filter
+     * 
+     * Media and group names are kept in a counting Bloom filter, checked by
+     * every lookup before the maps: a name that the filter rejects is reported
+     * missing without any map probe or string comparison. The filter grows
+     * automatically with the collections; this method rebuilds it with a new
+     * target false positive rate (1% by default).
+     * 
+     * @param[in] falsePositiveRate The target false positive rate, in ]0, 1[
+     * 
+     * @throws std::invalid_argument if the rate is out of range
+     * @sa CountingBloomFilter
+     */
+    void setNameFilterRate(double falsePositiveRate);
+
+    /**
+     * @brief Retrieves the name filter
+     * 
+     * @return The counting Bloom filter over media and group names
+     */
+    const CountingBloomFilter &getNameFilter() const;
+
+    /** @brief Returns the number of lookups by name since the creation of the Manager */
+    unsigned long getLookupCount() const;
+
+    /** @brief Returns the number of lookups answered by the name filter alone */
+    unsigned long getSkippedLookupCount() const;
+
+    /**
+     * @brief Visits the media collection in name order without copying it
+     * 
+     * Calls _visit_ with a reference to each multimedia object, in name order,
+     * until it returns false. Neither the collection nor the shared pointers
+     * are copied, so no reference count is modified.
+     * 
+     * @param[in] visit Called with each object, returns false to stop
+     * @param[in] after If not nullptr, the visit starts after this name
+     */
+    void forEachMedia(const std::function<bool(const Multimedia &)> &visit,
+                      const std::string *after = nullptr) const;
+
+    /**
+     * @brief Lists one page of the media collection
+     * 
+     * Objects are listed by name or by (duration, name); objects without a
+     * duration (photos) are not listed by duration. A page starts after the
+     * object designated by _cursor_, so pages remain consistent when objects
+     * are added or removed between two calls. Pages by name are produced by
+     * walking the name index; pages by duration are selected with a bounded
+     * heap of _limit_ + 1 entries.
+     * 
+     * @param[in] emit Called with each object of the page, in order
+     * @param[in] limit The maximum number of objects in the page
+     * @param[in] byDuration true to order by duration instead of name
+     * @param[in] type If not nullptr, only objects of this type are listed
+     * @param[in] cursor An opaque cursor returned by a previous call, or "" for the first page
+     * 
+     * @return The cursor of the next page, or "" if this is the last page
+     * 
+     * @throws std::invalid_argument if the cursor is invalid
+     */
+    std::string listMedias(const std::function<void(const Multimedia &)> &emit, size_t limit,
+                           bool byDuration = false, const MediaType *type = nullptr,
+                           const std::string &cursor = "") const;
+
 private:
     /** @brief Collection of multimedia objects indexed by name */
     std::map<std::string, mmPtr> mediaCollection;
 
     /** @brief Collection of groups indexed by name */
     std::map<std::string, gPtr> mediaGroups;
+
+    /** @brief Statistics of the media collection */
+    CatalogStats stats;
+
+    /** @brief Counting Bloom filter over the names of mediaCollection and mediaGroups */
+    CountingBloomFilter nameFilter;
+
+    /** @brief Lookup counters reported by getLookupCount() and getSkippedLookupCount() */
+    mutable std::atomic<unsigned long> lookups{0}, skippedLookups{0};
+
+    /** @brief Checks the name filter and counts the lookup */
+    bool mayExist(const std::string &name) const noexcept;
+
+    /** @brief Map lookups, without checking the name filter */
+    const Multimedia *lookupMedia(const std::string &name) const noexcept;
+    const Group *lookupGroup(const std::string &name) const noexcept;
+
+    /** @brief Adds a name that was just added to a collection to the name filter */
+    void addName(const std::string &name);
+
+    /** @brief Creates the object or group described by a parsed catalog line
+     *  @param byId The objects of the catalog by ID, to resolve `GroupIds` members
+     *  @return The object created, nullptr for a group
+     *  @throws NamingError if the name already exists
+     */
+    mmPtr addRecord(const CatalogRecord &record, const std::vector<mmPtr> &byId);
+
+    /** @brief Creates the group described by a parsed catalog line, with its members */
+    gPtr buildGroup(const CatalogRecord &record, const std::vector<mmPtr> &byId) const;
+
+    /** @brief Rebuilds the name filter from the collections */
+    void rebuildNameFilter(size_t capacity, double falsePositiveRate);
+
+    /** @brief Snapshot opened by openSnapshot(), holding the objects not materialised yet */
+    std::unique_ptr<LazyCatalog> lazy;
+
+    /** @brief Constructs the object described by a snapshot entry
+     *  @param version The version stamp of the object, 0 for a new one
+     */
+    static mmPtr makeMedia(const SnapshotMedia &entry, unsigned long version = 0);
+
+    /** @brief Looks an object up in the opened snapshot */
+    const Multimedia *lookupLazy(const std::string &name) const noexcept;
+
+    /** @brief Tells whether an object with this name exists */
+    bool mediaExists(const std::string &name) const;
+
+    /** @brief Moves every object of the opened snapshot into the collections, under writeLock() */
+    void materializeAll();
+
+    /** @brief Checks, before a const operation over the whole catalog, that materializeAll() was called
+     *  @throws std::logic_error if a snapshot opened lazily is not materialised
+     */
+    void requireMaterialized() const;
+
+    /** @brief Lock returned by readLock() and writeLock() */
+    mutable std::shared_mutex mutex;
+
+    /** @brief Write-ahead log opened by openLog() and its current segment */
+    std::unique_ptr<MutationLog> log;
+    std::string logBase;
+    unsigned long logSegment = 0;
+    size_t compactionSize = 0;
+
+    /** @brief Background compaction started by compact() */
+    std::thread compactor;
+    std::atomic<bool> compacting{false};
+
+    /** @brief Thread waiting for the child of backgroundSave() and its outcome */
+    std::thread saveWaiter;
+    mutable std::mutex saveMutex;
+    SaveStatus lastSave;
+
+    /** @brief Thread of readAsync() and the handle of its load */
+    std::thread loader;
+    std::shared_ptr<CatalogLoad> loading;
+    mutable std::mutex loadMutex;
+    std::atomic<bool> stopLoading{false};
+
+    /** @brief Watcher started by watch(), serialisation of reload() and its outcome */
+    std::unique_ptr<FileWatcher> watcher;
+    std::mutex reloading;
+    mutable std::mutex reloadMutex;
+    ReloadStatus lastReload;
+
+    /** @brief Content hash of the objects added by ingest(), and the objects of each hash */
+    std::unordered_map<std::string, uint64_t> contentHashes;
+    std::unordered_map<uint64_t, std::set<std::string>> contentIndex;
+
+    /** @brief Indexes the content of an object, returns true if another has the same */
+    bool indexContent(const std::string &name, uint64_t hash);
+    void forgetContent(const std::string &name);
+
+    /** @brief Thumbnails read by getThumbnail() */
+    ThumbnailCache thumbnails{THUMBNAIL_CACHE_BYTES};
+
+    /**
+     * @brief Replaces objects in the groups that hold them
+     * 
+     * @param[in] replacements The new object of each replaced one, nullptr to
+     *            remove it from the groups
+     * @return The number of groups modified
+     */
+    size_t replaceInGroups(const std::unordered_map<const Multimedia *, mmPtr> &replacements);
+
+    /**
+     * @brief Deletes an object if it was read from a given file
+     * 
+     * @param[in] name The name of the object
+     * @param[in] filepath The file the object must have
+     * @param[out] previous The deleted object, null if it was still in the opened snapshot
+     * @return false if no object of this name has this file
+     */
+    bool deleteFileObject(const std::string &name, const std::string &filepath, mmPtr &previous);
+
+    /** @brief Creates the object described by an ingest cache entry */
+    mmPtr createFromEntry(const std::string &filepath, const IngestCache::Entry &entry);
+
+    /** @brief A directory followed by watchDirectory() */
+    struct DirectoryWatch
+    {
+        std::string directory;
+        contenthash::Mode hashing;
+        IngestCache cache{""}; ///< files of the tree, never saved
+        std::mutex busy;       ///< held while the catalog is updated from the tree
+        mutable std::mutex statsMutex;
+        WatchStats stats;
+        std::unique_ptr<DirectoryWatcher> watcher; ///< last: stopped first
+    };
+
+    /** @brief Applies a batch of changes reported by the watcher of _watch_ */
+    void applyChanges(DirectoryWatch &watch, const std::vector<DirectoryWatcher::Change> &changes);
+
+    /** @brief Appends records to the log, if any */
+    void logMedia(const std::string &name, const Multimedia &media);
+    void logGroup(const std::string &name, const Group &group);
+    void logDelete(const std::string &name);
+    void logRecord(std::string_view record);
+
+    /** @brief Applies a record read from the log */
+    void replayRecord(std::string_view record);
+
+    /** @brief Names and members of the groups, sorted by name */
+    using GroupMembers = std::vector<std::pair<std::string, std::vector<mmPtr>>>;
+
+    /** @brief Copies the member lists of groups */
+    static GroupMembers copyGroups(const std::map<std::string, gPtr> &groups);
+
+    /** @brief Writes a snapshot of collections, folding the log segments up to _logSegment_ */
+    static void writeSnapshot(const std::string &filename, const std::map<std::string, mmPtr> &medias,
+                              const GroupMembers &groups, unsigned long logSegment = 0);
+
+    /** @brief Directories followed by watchDirectory(), stopped first on destruction */
+    mutable std::mutex watchesMutex;
+    std::map<std::string, std::shared_ptr<DirectoryWatch>> watches;
 };
 
 #endif // MANAGER_H
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + strerror(error));
+    }
+
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0)
+    {
+        void *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + path + ": " + strerror(error));
+        }
+        begin = static_cast<const char *>(address);
+    }
+    // the mapping stays valid once the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (begin)
+        ::munmap(const_cast<char *>(begin), length);
+}
+
+void MappedFile::advise(bool sequential) const
+{
+    if (begin)
+        ::madvise(const_cast<char *>(begin), length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file mappedfile.h
+ * @brief Header file for the MappedFile class
+ *
+ * This file defines the MappedFile class, a read-only memory mapping of a file.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file
+ *
+ * The content of the file is accessed in place through the page cache, without
+ * being copied into user-space buffers. The mapping is released when the
+ * MappedFile is destroyed; views obtained from it must not outlive it.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief Maps a file
+     *
+     * @param[in] path The file to map
+     *
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string &path);
+
+    /**
+     * @brief Destructor for MappedFile, unmaps the file
+     */
+    ~MappedFile();
+
+    /** @brief Returns the first byte of the file (nullptr if the file is empty) */
+    const char *data() const { return begin; }
+
+    /** @brief Returns the size of the file in bytes */
+    size_t size() const { return length; }
+
+    /** @brief Returns the whole content of the file */
+    std::string_view view() const { return std::string_view(begin, length); }
+
+    /**
+     * @brief Tells the kernel how the mapping will be accessed
+     *
+     * @param[in] sequential true for a sequential scan, false for random accesses
+     */
+    void advise(bool sequential) const;
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *begin = nullptr;
+    size_t length = 0;
+};
+
+#endif // MAPPEDFILE_H
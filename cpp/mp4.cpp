@@ -0,0 +1,297 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mp4.h"
+
+namespace
+{
+    // larger movie boxes are not metadata worth reading
+    constexpr uint64_t MAX_MOVIE_SIZE = 64 << 20;
+    constexpr size_t MAX_CHAPTERS = 4096;
+
+    // Big-endian reads, bounds-checked against a box.
+    class BoxData
+    {
+    public:
+        explicit BoxData(std::string_view data) : data(data) {}
+
+        size_t size() const { return data.size(); }
+
+        bool u8(size_t offset, uint8_t &value) const
+        {
+            if (offset >= data.size())
+                return false;
+            value = static_cast<uint8_t>(data[offset]);
+            return true;
+        }
+
+        bool u32(size_t offset, uint32_t &value) const
+        {
+            if (offset > data.size() || data.size() - offset < 4)
+                return false;
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data()) + offset;
+            value = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+            return true;
+        }
+
+        bool u64(size_t offset, uint64_t &value) const
+        {
+            uint32_t high, low;
+            if (!u32(offset, high) || !u32(offset + 4, low))
+                return false;
+            value = uint64_t(high) << 32 | low;
+            return true;
+        }
+
+    private:
+        std::string_view data;
+    };
+
+    // Reads the header of the box at _offset_, _available_ bytes being left in
+    // its parent. Returns the size of the whole box, 0 if the header is invalid.
+    uint64_t boxHeader(const BoxData &box, size_t offset, uint64_t available, uint32_t &type, uint64_t &headerSize)
+    {
+        uint32_t size32;
+        if (!box.u32(offset, size32) || !box.u32(offset + 4, type))
+            return 0;
+        uint64_t size = size32;
+        headerSize = 8;
+        if (size32 == 1)
+        {
+            if (!box.u64(offset + 8, size))
+                return 0;
+            headerSize = 16;
+        }
+        else if (size32 == 0)
+        {
+            size = available; // up to the end of the parent
+        }
+        return size >= headerSize && size <= available ? size : 0;
+    }
+
+    constexpr uint32_t fourcc(const char (&name)[5])
+    {
+        return uint32_t(uint8_t(name[0])) << 24 | uint32_t(uint8_t(name[1])) << 16 |
+               uint32_t(uint8_t(name[2])) << 8 | uint32_t(uint8_t(name[3]));
+    }
+
+    // Calls _visit_ with the type and content of each child box, until it
+    // returns false. Returns false if a child is malformed.
+    template <class Visit>
+    bool forEachBox(std::string_view parent, Visit visit)
+    {
+        BoxData box(parent);
+        size_t offset = 0;
+        while (parent.size() - offset >= 8)
+        {
+            uint32_t type;
+            uint64_t headerSize;
+            uint64_t size = boxHeader(box, offset, parent.size() - offset, type, headerSize);
+            if (size == 0)
+                return false;
+            if (!visit(type, parent.substr(offset + headerSize, size - headerSize)))
+                return true;
+            offset += size;
+        }
+        return true;
+    }
+
+    // Returns the content of the first child box of this type, if any.
+    bool child(std::string_view parent, uint32_t type, std::string_view &content)
+    {
+        bool found = false;
+        forEachBox(parent, [&](uint32_t childType, std::string_view childContent)
+                   {
+            if (childType != type)
+                return true;
+            content = childContent;
+            found = true;
+            return false; });
+        return found;
+    }
+
+    // Full boxes start with a version byte and three flag bytes. Reads the
+    // time scale and the duration of a movie or media header.
+    bool header(std::string_view content, uint32_t &timescale, uint64_t &duration)
+    {
+        BoxData box(content);
+        uint8_t version;
+        if (!box.u8(0, version))
+            return false;
+        if (version == 1)
+            return box.u32(20, timescale) && box.u64(24, duration) && timescale != 0;
+        uint32_t duration32;
+        if (!box.u32(12, timescale) || !box.u32(16, duration32) || timescale == 0)
+            return false;
+        duration = duration32;
+        return true;
+    }
+
+    // Nero chapter list: version, flags, [reserved], count, then for each
+    // chapter a start time in units of 100 ns and a title prefixed by its length.
+    bool neroChapters(std::string_view chpl, std::vector<double> &chapters)
+    {
+        BoxData box(chpl);
+        uint8_t version, count;
+        size_t offset = 4;
+        if (!box.u8(0, version))
+            return false;
+        if (version != 0)
+            offset += 4;
+        if (!box.u8(offset++, count))
+            return false;
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            uint64_t start;
+            uint8_t titleLength;
+            if (!box.u64(offset, start) || !box.u8(offset + 8, titleLength))
+                return false;
+            chapters.push_back(start / 1e7);
+            offset += 9 + size_t(titleLength);
+        }
+        return true;
+    }
+
+    // QuickTime chapter track: one sample per chapter, whose start times are
+    // the sums of the durations of the time-to-sample table.
+    bool trackChapters(std::string_view mdia, std::vector<double> &chapters)
+    {
+        std::string_view mdhd, minf, stbl, stts;
+        uint32_t timescale;
+        uint64_t duration;
+        if (!child(mdia, fourcc("mdhd"), mdhd) || !header(mdhd, timescale, duration) ||
+            !child(mdia, fourcc("minf"), minf) || !child(minf, fourcc("stbl"), stbl) ||
+            !child(stbl, fourcc("stts"), stts))
+            return false;
+        BoxData box(stts);
+        uint32_t entries;
+        if (!box.u32(4, entries) || (box.size() - 8) / 8 < entries)
+            return false;
+        uint64_t time = 0;
+        for (uint32_t i = 0; i < entries; ++i)
+        {
+            uint32_t samples, delta;
+            box.u32(8 + 8 * size_t(i), samples);
+            box.u32(12 + 8 * size_t(i), delta);
+            for (uint32_t s = 0; s < samples; ++s)
+            {
+                if (chapters.size() >= MAX_CHAPTERS)
+                    return true;
+                chapters.push_back(static_cast<double>(time) / timescale);
+                time += delta;
+            }
+        }
+        return true;
+    }
+
+    uint32_t trackId(std::string_view trak)
+    {
+        std::string_view tkhd;
+        uint8_t version;
+        uint32_t id = 0;
+        if (child(trak, fourcc("tkhd"), tkhd) && BoxData(tkhd).u8(0, version))
+            BoxData(tkhd).u32(version == 1 ? 20 : 12, id);
+        return id;
+    }
+}
+
+bool mp4::parseMovie(std::string_view moov, Mp4Data &data)
+{
+    data = Mp4Data();
+    std::string_view mvhd;
+    uint32_t timescale;
+    uint64_t duration;
+    if (!child(moov, fourcc("mvhd"), mvhd) || !header(mvhd, timescale, duration))
+        return false;
+    data.hasDuration = true;
+    data.duration = static_cast<double>(duration) / timescale;
+
+    std::string_view udta, chpl;
+    if (child(moov, fourcc("udta"), udta) && child(udta, fourcc("chpl"), chpl) &&
+        neroChapters(chpl, data.chapters) && !data.chapters.empty())
+        return true;
+    data.chapters.clear();
+
+    // the track designated by the chap reference of another track
+    uint32_t chapterTrack = 0;
+    forEachBox(moov, [&](uint32_t type, std::string_view trak)
+               {
+        std::string_view tref, chap;
+        if (type == fourcc("trak") && child(trak, fourcc("tref"), tref) && child(tref, fourcc("chap"), chap))
+            BoxData(chap).u32(0, chapterTrack);
+        return chapterTrack == 0; });
+    if (chapterTrack == 0)
+        return true;
+    forEachBox(moov, [&](uint32_t type, std::string_view trak)
+               {
+        std::string_view mdia;
+        if (type != fourcc("trak") || trackId(trak) != chapterTrack)
+            return true;
+        if (!child(trak, fourcc("mdia"), mdia) || !trackChapters(mdia, data.chapters))
+            data.chapters.clear();
+        return false; });
+    return true;
+}
+
+bool mp4::readFile(const std::string &path, Mp4Data &data)
+{
+    data = Mp4Data();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + strerror(error));
+    }
+
+    auto readAt = [&](char *buffer, size_t size, uint64_t offset)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            ssize_t n = ::pread(fd, buffer + done, size - done, offset + done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            done += n;
+        }
+        return true;
+    };
+
+    // top-level boxes: only their headers are read until moov is found
+    uint64_t fileSize = st.st_size, offset = 0;
+    bool found = false;
+    while (fileSize - offset >= 8)
+    {
+        char buffer[16];
+        size_t headerBytes = fileSize - offset >= 16 ? 16 : 8;
+        if (!readAt(buffer, headerBytes, offset))
+            break;
+        uint32_t type;
+        uint64_t headerSize;
+        uint64_t size = boxHeader(BoxData(std::string_view(buffer, headerBytes)), 0, fileSize - offset, type, headerSize);
+        if (size == 0)
+            break;
+        if (type == fourcc("moov"))
+        {
+            if (size - headerSize > MAX_MOVIE_SIZE)
+                break;
+            std::string moov(size - headerSize, '\0');
+            if (readAt(&moov[0], moov.size(), offset + headerSize))
+                found = parseMovie(moov, data);
+            break;
+        }
+        offset += size;
+    }
+    ::close(fd);
+    return found;
+}
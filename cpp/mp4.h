@@ -0,0 +1,69 @@
+/**
+ * @file mp4.h
+ * @brief Header file for the MP4 metadata parser
+ *
+ * This file declares the functions reading the duration and chapters of MP4
+ * (ISO base media) files.
+ */
+
+#ifndef MP4_H
+#define MP4_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct Mp4Data
+ * @brief Metadata read from the movie box of an MP4 file
+ */
+struct Mp4Data
+{
+    bool hasDuration = false;     ///< true if the movie header was found
+    double duration = 0;          ///< seconds
+    std::vector<double> chapters; ///< start time of each chapter in seconds, in order
+};
+
+/**
+ * @brief Parser of the movie box of MP4 files
+ *
+ * An MP4 file is a sequence of boxes (size, four-character type, content),
+ * some of which contain other boxes. The metadata are in the `moov` box, which
+ * may come before or after the media data (`mdat`, usually most of the file):
+ * - the duration is in the movie header, `moov/mvhd`;
+ * - chapters are either a Nero chapter list, `moov/udta/chpl`, or a QuickTime
+ *   chapter track, designated by the `tref/chap` box of another track, whose
+ *   samples start at the chapter boundaries (`mdia/minf/stbl/stts`).
+ *
+ * Every size, offset and count read from the file is checked before use:
+ * malformed or truncated input is reported as missing metadata, never read
+ * out of bounds.
+ */
+namespace mp4
+{
+    /**
+     * @brief Reads the metadata of a movie box in memory
+     *
+     * @param[in] moov The content of the `moov` box, without its header
+     * @param[out] data The metadata found
+     * @return false if there is no valid movie header
+     */
+    bool parseMovie(std::string_view moov, Mp4Data &data);
+
+    /**
+     * @brief Reads the metadata of an MP4 file
+     *
+     * Only the top-level box headers are read until the `moov` box is found,
+     * which is then read in one pread(): the media data are skipped, wherever
+     * they are.
+     *
+     * @param[in] path The MP4 file
+     * @param[out] data The metadata found
+     * @return false if there is no valid movie box
+     *
+     * @throws std::runtime_error if the file cannot be opened or read
+     */
+    bool readFile(const std::string &path, Mp4Data &data);
+}
+
+#endif // MP4_H
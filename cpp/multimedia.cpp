@@ -1,6 +1,12 @@
 #include "multimedia.h"
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "stats.h"
 
 Multimedia::Multimedia(std::string name, std::string filepath)
 {
@@ -17,7 +23,9 @@ std::string Multimedia::getName() const
 
 void Multimedia::setName(std::string name)
 {
+    beforeChange();
     this->name = name;
+    afterChange();
 }
 
 std::string Multimedia::getFilepath() const
@@ -27,7 +35,70 @@ std::string Multimedia::getFilepath() const
 
 void Multimedia::setFilepath(std::string filepath)
 {
+    beforeChange();
     this->filepath = filepath;
+    afterChange();
+}
+
+unsigned long Multimedia::getVersion() const
+{
+    return version;
+}
+
+void Multimedia::touch()
+{
+    version = nextVersion();
+}
+
+void Multimedia::beforeChange()
+{
+    for (CatalogStats *stats : statistics.list)
+        stats->uncount(*this);
+}
+
+void Multimedia::afterChange()
+{
+    for (CatalogStats *stats : statistics.list)
+        stats->count(*this);
+    touch();
+}
+
+bool Multimedia::launch(const char *program) const
+{
+    // a path starting with '-' would be taken for an option
+    std::string path = !filepath.empty() && filepath[0] == '-' ? "./" + filepath : filepath;
+    char *const argv[] = {const_cast<char *>(program), const_cast<char *>(path.c_str()), nullptr};
+    // the intermediate child exits at once, so the program is reaped by init
+    pid_t child = fork();
+    if (child < 0)
+        return false;
+    if (child == 0)
+    {
+        pid_t grandchild = fork();
+        if (grandchild == 0)
+        {
+            execvp(program, argv);
+            _exit(127);
+        }
+        _exit(grandchild < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static std::atomic<unsigned long> versionCounter(0);
+
+unsigned long Multimedia::nextVersion()
+{
+    return ++versionCounter;
+}
+
+unsigned long Multimedia::reserveVersions(unsigned long count)
+{
+    return versionCounter.fetch_add(count) + 1;
 }
 
 
@@ -11,6 +11,23 @@
 #ifndef MULTIMEDIA_H
 #define MULTIMEDIA_H
 #include <string>
+#include <vector>
+
+class CatalogStats;
+
+/**
+ * @enum MediaType
+ * @brief Concrete type of a multimedia object
+ * 
+ * Lets code that walks a whole collection (queries, statistics, serialization)
+ * branch on the type of an object without a chain of dynamic_cast.
+ */
+enum class MediaType
+{
+    Photo, ///< A Photo object
+    Video, ///< A Video object (but not a Film)
+    Film   ///< A Film object
+};
 
 /**
  * @class Multimedia
@@ -40,6 +57,61 @@ protected:
      */
     std::string filepath = "";
 
+    /** @brief Version stamp of the object
+     *  @details Taken from nextVersion() at construction and refreshed by touch()
+     *           on every mutation, so that clients can detect stale cached copies
+     */
+    unsigned long version = nextVersion();
+
+    /**
+     * @brief Marks the object as modified
+     * 
+     * Refreshes the version stamp with a new value from nextVersion(). Setters
+     * call it through afterChange().
+     */
+    void touch();
+
+    /** @brief Statistics this object currently contributes to
+     *  @details Not copied along with the object: a copy belongs to no statistics
+     *  @sa CatalogStats
+     */
+    struct StatsLinks
+    {
+        std::vector<CatalogStats *> list;
+        StatsLinks() {}
+        StatsLinks(const StatsLinks &) {}
+        StatsLinks &operator=(const StatsLinks &) { return *this; }
+    } statistics;
+
+    /**
+     * @brief Prepares the object for a modification
+     * 
+     * Removes the current values of the object from the statistics it contributes
+     * to. Every setter must call this method before modifying the object, then
+     * afterChange() once the modification is done.
+     */
+    void beforeChange();
+
+    /**
+     * @brief Completes a modification of the object
+     * 
+     * Adds the new values of the object to the statistics it contributes to and
+     * refreshes its version stamp with touch().
+     */
+    void afterChange();
+
+    /**
+     * @brief Opens the file of the object with a program, in the background
+     * 
+     * The program is found in the PATH and started with the file path as its
+     * only argument, without going through a shell, so that the characters of
+     * the path are never interpreted. The program is not waited for.
+     * 
+     * @param[in] program The viewer or player
+     * @return false if the program could not be started
+     */
+    bool launch(const char *program) const;
+
     /**
      * @brief Protected default constructor
      * 
@@ -66,6 +138,11 @@ protected:
      */
     friend class Manager;
 
+    /** @brief CatalogStats is granted friend access to link itself to objects
+     *  @sa CatalogStats
+     */
+    friend class CatalogStats;
+
 public:
     /**
      * @brief Virtual destructor for the Multimedia class
@@ -111,6 +188,37 @@ public:
      */
     void setFilepath(std::string filepath);
 
+    /**
+     * @brief Retrieves the version stamp of the multimedia object
+     * 
+     * The version changes each time the object is modified. Stamps are drawn
+     * from a single process-wide counter, so a larger value always means a
+     * more recent modification.
+     * 
+     * @return The current version stamp
+     */
+    unsigned long getVersion() const;
+
+    /**
+     * @brief Returns a new version stamp
+     * 
+     * Draws the next value of the process-wide version counter. This counter
+     * is shared by multimedia objects and groups and is thread-safe.
+     * 
+     * @return A version stamp strictly greater than all previously returned ones
+     */
+    static unsigned long nextVersion();
+
+    /**
+     * @brief Reserves consecutive version stamps
+     * 
+     * Same as calling nextVersion() _count_ times, at once.
+     * 
+     * @param[in] count The number of stamps
+     * @return The first of the _count_ stamps
+     */
+    static unsigned long reserveVersions(unsigned long count);
+
     /**
      * @brief Displays multimedia information to an output stream
      * 
@@ -135,6 +243,15 @@ public:
      */
     virtual void play() const = 0;
 
+    /**
+     * @brief Retrieves the concrete type of the multimedia object
+     * 
+     * @return The MediaType of the derived class
+     * 
+     * @note This is a pure virtual method and must be implemented by derived classes
+     */
+    virtual MediaType getType() const = 0;
+
     /**
      * @brief Writes multimedia object information to a file
      * 
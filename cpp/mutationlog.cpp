@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mutationlog.h"
+#include "mappedfile.h"
+#include "snapshot.h"
+
+namespace
+{
+    // record: payload length (4 bytes), checksum of the payload (4 bytes), payload
+    constexpr size_t FRAME = 8;
+
+    uint32_t recordChecksum(std::string_view payload)
+    {
+        return static_cast<uint32_t>(snapshot::checksum(payload.data(), payload.size()));
+    }
+}
+
+int MutationLog::openFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+    return fd;
+}
+
+MutationLog::MutationLog(const std::string &path, size_t batchSize, std::chrono::microseconds maxDelay)
+    : fd(openFile(path)), batchSize(batchSize > 0 ? batchSize : 1), maxDelay(maxDelay)
+{
+    struct stat st;
+    if (::fstat(fd, &st) == 0)
+        fileSize = st.st_size;
+    flusher = std::thread(&MutationLog::run, this);
+}
+
+MutationLog::~MutationLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    ::close(fd);
+}
+
+uint64_t MutationLog::append(std::string_view payload)
+{
+    uint32_t header[2] = {static_cast<uint32_t>(payload.size()), recordChecksum(payload)};
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pendingRecords == 0)
+        oldest = std::chrono::steady_clock::now();
+    pending.append(reinterpret_cast<const char *>(header), FRAME);
+    pending.append(payload);
+    fileSize += FRAME + payload.size();
+    // the flusher starts the delay on the first record and stops it on the last one of a batch
+    ++pendingRecords;
+    if (pendingRecords == 1 || pendingRecords == batchSize)
+        wake.notify_one();
+    return ++appended;
+}
+
+void MutationLog::waitDurable(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    synced.wait(lock, [&]
+                { return durable >= sequence || failed; });
+    if (durable < sequence)
+        throw std::runtime_error("The mutation log could not be written");
+}
+
+void MutationLog::sync()
+{
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sequence = appended;
+        forced = true;
+    }
+    wake.notify_one();
+    waitDurable(sequence);
+}
+
+void MutationLog::switchTo(const std::string &path)
+{
+    int next = openFile(path);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (durable < appended && !failed)
+    {
+        forced = true;
+        wake.notify_one();
+        synced.wait(lock);
+    }
+    // nothing is pending: the flusher does not use the descriptor until the next append
+    ::close(fd);
+    fd = next;
+    fileSize = 0;
+}
+
+void MutationLog::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        if (pendingRecords == 0)
+        {
+            if (stopping)
+                return;
+            wake.wait(lock);
+            continue;
+        }
+        if (!stopping && !forced && pendingRecords < batchSize &&
+            wake.wait_until(lock, oldest + maxDelay) == std::cv_status::no_timeout)
+        {
+            continue;
+        }
+
+        std::string batch;
+        batch.swap(pending);
+        uint64_t last = appended;
+        pendingRecords = 0;
+        forced = false;
+        lock.unlock();
+
+        bool ok = true;
+        for (size_t done = 0; ok && done < batch.size();)
+        {
+            ssize_t n = ::write(fd, batch.data() + done, batch.size() - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            ok = n > 0;
+            done += ok ? n : 0;
+        }
+        ok = ok && ::fdatasync(fd) == 0;
+        if (!ok)
+            std::cerr << "Cannot write the mutation log: " << strerror(errno) << std::endl;
+
+        lock.lock();
+        if (ok)
+        {
+            durable = last;
+            ++syncs;
+        }
+        failed = failed || !ok;
+        synced.notify_all();
+    }
+}
+
+uint64_t MutationLog::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return fileSize;
+}
+
+uint64_t MutationLog::getAppended() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended;
+}
+
+uint64_t MutationLog::getDurable() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return durable;
+}
+
+uint64_t MutationLog::getSyncCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return syncs;
+}
+
+bool MutationLog::replay(const std::string &path, const std::function<void(std::string_view)> &apply)
+{
+    MappedFile file(path);
+    file.advise(true);
+    std::string_view rest = file.view();
+    while (rest.size() >= FRAME)
+    {
+        uint32_t header[2];
+        memcpy(header, rest.data(), FRAME);
+        if (header[0] > rest.size() - FRAME)
+            return false;
+        std::string_view payload = rest.substr(FRAME, header[0]);
+        if (recordChecksum(payload) != header[1])
+            return false;
+        apply(payload);
+        rest.remove_prefix(FRAME + payload.size());
+    }
+    return rest.empty();
+}
@@ -0,0 +1,137 @@
+/**
+ * @file mutationlog.h
+ * @brief Header file for the MutationLog class
+ *
+ * This file defines the MutationLog class, an append-only write-ahead log whose
+ * records are synced to disk in batches by a background thread.
+ */
+
+#ifndef MUTATIONLOG_H
+#define MUTATIONLOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @class MutationLog
+ * @brief Append-only log with group commit
+ *
+ * Each record is framed by its length and a checksum, so that a record torn by
+ * a crash is detected on replay. append() only copies the record into a memory
+ * buffer; a flusher thread writes the buffer and syncs it with one fdatasync()
+ * once _batchSize_ records are pending or the oldest pending record has waited
+ * _maxDelay_, so that the cost of a sync is shared by every record of the batch
+ * (group commit). Writers that need durability call waitDurable() with the
+ * sequence number returned by append().
+ *
+ * @sa Manager::openLog()
+ */
+class MutationLog
+{
+public:
+    /**
+     * @brief Opens a log file for appending
+     *
+     * @param[in] path The log file, created if needed
+     * @param[in] batchSize The number of pending records that triggers a sync
+     * @param[in] maxDelay The longest time a record waits before being synced
+     *
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    MutationLog(const std::string &path, size_t batchSize = 64,
+                std::chrono::microseconds maxDelay = std::chrono::milliseconds(2));
+
+    /**
+     * @brief Destructor for MutationLog, syncs the pending records
+     */
+    ~MutationLog();
+
+    /**
+     * @brief Appends a record
+     *
+     * @param[in] payload The content of the record
+     * @return The sequence number of the record
+     */
+    uint64_t append(std::string_view payload);
+
+    /**
+     * @brief Waits until a record is on disk
+     *
+     * @param[in] sequence The number returned by append()
+     *
+     * @throws std::runtime_error if the log could not be written
+     */
+    void waitDurable(uint64_t sequence);
+
+    /**
+     * @brief Syncs every pending record now and waits for it
+     *
+     * @throws std::runtime_error if the log could not be written
+     */
+    void sync();
+
+    /**
+     * @brief Syncs the pending records and continues in another file
+     *
+     * @param[in] path The new log file
+     *
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    void switchTo(const std::string &path);
+
+    /** @brief Returns the size in bytes of the current file, pending records included */
+    uint64_t size() const;
+
+    /** @brief Returns the number of records appended */
+    uint64_t getAppended() const;
+
+    /** @brief Returns the number of records on disk */
+    uint64_t getDurable() const;
+
+    /** @brief Returns the number of syncs done */
+    uint64_t getSyncCount() const;
+
+    /**
+     * @brief Reads the records of a log file
+     *
+     * Reading stops at the first incomplete or corrupted record, which is what
+     * a crash in the middle of a write leaves at the end of the file.
+     *
+     * @param[in] path The log file
+     * @param[in] apply The function called with the payload of each record
+     * @return false if the file ends with an incomplete or corrupted record
+     *
+     * @throws std::runtime_error if the file cannot be read
+     */
+    static bool replay(const std::string &path, const std::function<void(std::string_view)> &apply);
+
+private:
+    MutationLog(const MutationLog &) = delete;
+    MutationLog &operator=(const MutationLog &) = delete;
+
+    /** @brief Body of the flusher thread */
+    void run();
+
+    static int openFile(const std::string &path);
+
+    int fd;
+    size_t batchSize;
+    std::chrono::microseconds maxDelay;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake, synced;
+    std::string pending;
+    size_t pendingRecords = 0;
+    std::chrono::steady_clock::time_point oldest;
+    uint64_t appended = 0, durable = 0, syncs = 0, fileSize = 0;
+    bool forced = false, stopping = false, failed = false;
+    std::thread flusher;
+};
+
+#endif // MUTATIONLOG_H
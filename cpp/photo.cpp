@@ -1,12 +1,21 @@
 #include "photo.h"
+#include <cmath>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+
+// NaN would break the ordering of the coordinates kept by CatalogStats
+static double finiteCoordinate(double value){
+    if (!std::isfinite(value))
+        throw std::invalid_argument("Photo coordinates must be finite numbers!");
+    return value;
+}
 
 Photo::Photo(): Multimedia(), latitude(0), longitude(0){}
 
 Photo::Photo(std::string name, std::string filepath, double latitude, double longitude)
-: Multimedia(name, filepath), latitude(latitude), longitude(longitude){}
+: Multimedia(name, filepath), latitude(finiteCoordinate(latitude)), longitude(finiteCoordinate(longitude)){}
 
 Photo::~Photo(){
     std::cout << "Photo object DESTROYED: " << name <<"\n";
@@ -17,7 +26,10 @@ double Photo::getLatitude() const{
 }
 
 void Photo::setLatitude(double latitude){
+    finiteCoordinate(latitude);
+    beforeChange();
     this->latitude = latitude;
+    afterChange();
 }
 
 double Photo::getLongitude() const{
@@ -25,7 +37,10 @@ double Photo::getLongitude() const{
 }
 
 void Photo::setLongitude(double longitude){
+    finiteCoordinate(longitude);
+    beforeChange();
     this->longitude = longitude;
+    afterChange();
 }
 
 std::ostream& Photo::display(std::ostream& os) const{
@@ -34,13 +49,14 @@ std::ostream& Photo::display(std::ostream& os) const{
     return os;
 }
 
+MediaType Photo::getType() const {
+    return MediaType::Photo;
+}
+
 void Photo::play() const {
     std::cout << "Displaying a photo\n" ;
-    std::string string = "imagej "+filepath+" &";
-    const char *cstring = string.data();
-    if (system(cstring)){
-        std::cout << "File DNE\n" ;
-        exit(EXIT_FAILURE);
+    if (!launch("imagej")){
+        std::cout << "Cannot start imagej\n" ;
     };
 
 }
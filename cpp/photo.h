@@ -50,6 +50,8 @@ public:
      * Assigns a new latitude coordinate to the photo.
      * 
      * @param[in] latitude The latitude value to set (range typically -90.0 to 90.0)
+     * 
+     * @throws std::invalid_argument if the latitude is not a finite number
      */
     void setLatitude(double latitude);
 
@@ -68,6 +70,8 @@ public:
      * Assigns a new longitude coordinate to the photo.
      * 
      * @param[in] longitude The longitude value to set (range typically -180.0 to 180.0)
+     * 
+     * @throws std::invalid_argument if the longitude is not a finite number
      */
     void setLongitude(double longitude);
 
@@ -106,6 +110,15 @@ public:
      */
     void write(const std::string& filename) const override;
 
+    /**
+     * @brief Retrieves the concrete type of the photo
+     * 
+     * @return MediaType::Photo
+     * 
+     * @note This overrides the pure virtual method from the Multimedia class
+     */
+    MediaType getType() const override;
+
 private:
     /** @brief The latitude coordinate of the photo location (range: -90.0 to 90.0)
      *  @details Initialized to 0 by default
@@ -136,6 +149,7 @@ private:
      * @param[in] latitude The geographic latitude of the photo location
      * @param[in] longitude The geographic longitude of the photo location
      * 
+     * @throws std::invalid_argument if a coordinate is not a finite number
      * @sa Manager
      */
     Photo(std::string name, std::string filepath, double latitude, double longitude);
@@ -0,0 +1,460 @@
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "query.h"
+#include "video.h"
+#include "film.h"
+#include "exceptions.h"
+
+namespace
+{
+    // Comparison operators are encoded as a mask of the outcomes they accept,
+    // so that a numeric comparison can be evaluated without branching.
+    const unsigned LT = 1, EQ = 2, GT = 4;
+    const unsigned CONTAINS = 8; // names only
+
+    const int NUMERIC_FIELDS = 3; // Type, Duration, Chapters
+
+    // Flattened view of a multimedia object, filled once per scanned object.
+    struct Row
+    {
+        const Multimedia *media;
+        double values[NUMERIC_FIELDS] = {};
+        unsigned present; // bit i is set if values[i] is meaningful
+    };
+
+    void fillRow(const Multimedia &media, Row &row)
+    {
+        row.media = &media;
+        MediaType type = media.getType();
+        // the missing fields are read before being masked by present
+        row.values[0] = static_cast<double>(type);
+        row.values[1] = row.values[2] = 0;
+        row.present = 1;
+        if (type != MediaType::Photo)
+        {
+            row.values[1] = static_cast<const Video &>(media).getDuration();
+            row.present |= 2;
+        }
+        if (type == MediaType::Film)
+        {
+            row.values[2] = static_cast<double>(static_cast<const Film &>(media).getChapterNumber());
+            row.present |= 4;
+        }
+    }
+
+    // A comparison between a numeric field and a constant.
+    struct NumericTerm
+    {
+        int field;
+        double value;
+        unsigned mask;
+
+        bool eval(const Row &row) const
+        {
+            double v = row.values[field];
+            unsigned outcome = (unsigned(v < value) * LT) | (unsigned(v == value) * EQ) | (unsigned(v > value) * GT);
+            return ((outcome & mask) != 0) & ((row.present >> field) & 1);
+        }
+    };
+}
+
+struct Query::Node
+{
+    virtual ~Node() {}
+    virtual bool eval(const Row &row) const = 0;
+};
+
+namespace
+{
+    struct NumericNode : Query::Node
+    {
+        NumericTerm term;
+        bool eval(const Row &row) const override { return term.eval(row); }
+    };
+
+    struct NameNode : Query::Node
+    {
+        unsigned mask;
+        std::string value;
+
+        bool eval(const Row &row) const override
+        {
+            const std::string &name = row.media->getName();
+            if (mask == CONTAINS)
+                return name.find(value) != std::string::npos;
+            int c = name.compare(value);
+            unsigned outcome = c < 0 ? LT : (c == 0 ? EQ : GT);
+            return (outcome & mask) != 0;
+        }
+    };
+
+    // Conjunction: all numeric terms are evaluated without short-circuit (they
+    // are cheap and branch-free), then the other children with short-circuit.
+    struct AndNode : Query::Node
+    {
+        std::vector<NumericTerm> numeric;
+        std::vector<std::unique_ptr<Query::Node>> others;
+
+        bool eval(const Row &row) const override
+        {
+            bool ok = true;
+            for (const NumericTerm &t : numeric)
+                ok &= t.eval(row);
+            if (!ok)
+                return false;
+            for (const auto &child : others)
+                if (!child->eval(row))
+                    return false;
+            return true;
+        }
+    };
+
+    struct OrNode : Query::Node
+    {
+        std::vector<std::unique_ptr<Query::Node>> children;
+
+        bool eval(const Row &row) const override
+        {
+            for (const auto &child : children)
+                if (child->eval(row))
+                    return true;
+            return false;
+        }
+    };
+
+    struct NotNode : Query::Node
+    {
+        std::unique_ptr<Query::Node> child;
+        bool eval(const Row &row) const override { return !child->eval(row); }
+    };
+
+    struct Token
+    {
+        enum Kind { End, Word, Number, String, Op, LParen, RParen } kind;
+        std::string text;
+    };
+
+    std::vector<Token> tokenize(const std::string &text)
+    {
+        std::vector<Token> tokens;
+        size_t i = 0, n = text.size();
+        while (i < n)
+        {
+            char c = text[i];
+            if (isspace((unsigned char)c))
+            {
+                ++i;
+            }
+            else if (c == '(' || c == ')')
+            {
+                tokens.push_back({c == '(' ? Token::LParen : Token::RParen, std::string(1, c)});
+                ++i;
+            }
+            else if (c == '"')
+            {
+                size_t end = text.find('"', i + 1);
+                if (end == std::string::npos)
+                    throw QueryError("Unterminated string in query");
+                tokens.push_back({Token::String, text.substr(i + 1, end - i - 1)});
+                i = end + 1;
+            }
+            else if (c == '=' || c == '!' || c == '<' || c == '>' || c == '~')
+            {
+                size_t len = (i + 1 < n && text[i + 1] == '=') ? 2 : 1;
+                std::string op = text.substr(i, len);
+                if (op == "!")
+                    throw QueryError("Unknown operator '!' in query");
+                tokens.push_back({Token::Op, op == "==" ? "=" : op});
+                i += len;
+            }
+            else if (isdigit((unsigned char)c) || c == '-' || c == '.')
+            {
+                size_t start = i++;
+                while (i < n && (isdigit((unsigned char)text[i]) || text[i] == '.'))
+                    ++i;
+                tokens.push_back({Token::Number, text.substr(start, i - start)});
+            }
+            else
+            {
+                size_t start = i;
+                while (i < n && !isspace((unsigned char)text[i]) && text[i] != '(' && text[i] != ')' &&
+                       text[i] != '"' && text[i] != '=' && text[i] != '!' && text[i] != '<' &&
+                       text[i] != '>' && text[i] != '~')
+                    ++i;
+                tokens.push_back({Token::Word, text.substr(start, i - start)});
+            }
+        }
+        tokens.push_back({Token::End, ""});
+        return tokens;
+    }
+
+    unsigned opMask(const std::string &op)
+    {
+        if (op == "=") return EQ;
+        if (op == "!=") return LT | GT;
+        if (op == "<") return LT;
+        if (op == "<=") return LT | EQ;
+        if (op == ">") return GT;
+        if (op == ">=") return GT | EQ;
+        return CONTAINS;
+    }
+
+    Query::Field fieldOf(const std::string &word)
+    {
+        if (word == "type") return Query::Field::Type;
+        if (word == "duration") return Query::Field::Duration;
+        if (word == "chapters") return Query::Field::Chapters;
+        if (word == "name") return Query::Field::Name;
+        throw QueryError("Unknown field '" + word + "' in query");
+    }
+}
+
+/// Recursive descent parser producing the predicate tree of a Query.
+class QueryParser
+{
+public:
+    QueryParser(const std::string &text) : tokens(tokenize(text)) {}
+
+    void parse(Query &query)
+    {
+        if (!isKeyword("order") && !isKeyword("limit") && !isKeyword("offset") && peek().kind != Token::End)
+            query.root = parseExpr();
+        if (isKeyword("order"))
+        {
+            next();
+            expectKeyword("by");
+            query.ordered = true;
+            query.orderBy = fieldOf(expect(Token::Word).text);
+            if (isKeyword("desc") || isKeyword("asc"))
+                query.descending = next().text == "desc";
+        }
+        if (isKeyword("limit"))
+        {
+            next();
+            query.limit = parseCount();
+        }
+        if (isKeyword("offset"))
+        {
+            next();
+            query.offset = parseCount();
+        }
+        if (peek().kind != Token::End)
+            throw QueryError("Unexpected '" + peek().text + "' in query");
+    }
+
+private:
+    std::vector<Token> tokens;
+    size_t pos = 0;
+
+    const Token &peek() const { return tokens[pos]; }
+    const Token &next() { return pos + 1 < tokens.size() ? tokens[pos++] : tokens[pos]; }
+    bool isKeyword(const char *word) const { return peek().kind == Token::Word && peek().text == word; }
+
+    const Token &expect(Token::Kind kind)
+    {
+        if (peek().kind != kind)
+            throw QueryError(peek().kind == Token::End ? "Unexpected end of query"
+                                                       : "Unexpected '" + peek().text + "' in query");
+        return next();
+    }
+
+    void expectKeyword(const char *word)
+    {
+        if (!isKeyword(word))
+            throw QueryError(std::string("Expected '") + word + "' in query");
+        next();
+    }
+
+    size_t parseCount()
+    {
+        const std::string &text = expect(Token::Number).text;
+        char *end = nullptr;
+        long long value = strtoll(text.c_str(), &end, 10);
+        if (*end != '\0' || value < 0)
+            throw QueryError("Invalid count '" + text + "' in query");
+        return static_cast<size_t>(value);
+    }
+
+    std::unique_ptr<Query::Node> parseExpr()
+    {
+        std::unique_ptr<Query::Node> first = parseTerm();
+        if (!isKeyword("or"))
+            return first;
+        std::unique_ptr<OrNode> node(new OrNode());
+        node->children.push_back(std::move(first));
+        while (isKeyword("or"))
+        {
+            next();
+            node->children.push_back(parseTerm());
+        }
+        return node;
+    }
+
+    std::unique_ptr<Query::Node> parseTerm()
+    {
+        std::unique_ptr<Query::Node> first = parseFactor();
+        if (!isKeyword("and"))
+            return first;
+        std::unique_ptr<AndNode> node(new AndNode());
+        add(*node, std::move(first));
+        while (isKeyword("and"))
+        {
+            next();
+            add(*node, parseFactor());
+        }
+        return node;
+    }
+
+    // Numeric comparisons are flattened into the branch-free part of the conjunction.
+    static void add(AndNode &node, std::unique_ptr<Query::Node> child)
+    {
+        if (NumericNode *numeric = dynamic_cast<NumericNode *>(child.get()))
+            node.numeric.push_back(numeric->term);
+        else
+            node.others.push_back(std::move(child));
+    }
+
+    std::unique_ptr<Query::Node> parseFactor()
+    {
+        if (isKeyword("not"))
+        {
+            next();
+            std::unique_ptr<NotNode> node(new NotNode());
+            node->child = parseFactor();
+            return node;
+        }
+        if (peek().kind == Token::LParen)
+        {
+            next();
+            std::unique_ptr<Query::Node> node = parseExpr();
+            expect(Token::RParen);
+            return node;
+        }
+        Query::Field field = fieldOf(expect(Token::Word).text);
+        std::string op = expect(Token::Op).text;
+        const Token &value = next();
+        if (value.kind != Token::Word && value.kind != Token::Number && value.kind != Token::String)
+            throw QueryError("Missing value in query");
+
+        if (field == Query::Field::Name)
+        {
+            std::unique_ptr<NameNode> node(new NameNode());
+            node->mask = opMask(op);
+            node->value = value.text;
+            return node;
+        }
+        if (op == "~")
+            throw QueryError("Operator '~' only applies to names");
+
+        std::unique_ptr<NumericNode> node(new NumericNode());
+        node->term.field = static_cast<int>(field);
+        node->term.mask = opMask(op);
+        if (field == Query::Field::Type)
+        {
+            if (value.text == "Photo")
+                node->term.value = static_cast<double>(MediaType::Photo);
+            else if (value.text == "Video")
+                node->term.value = static_cast<double>(MediaType::Video);
+            else if (value.text == "Film")
+                node->term.value = static_cast<double>(MediaType::Film);
+            else
+                throw QueryError("Unknown type '" + value.text + "' in query");
+        }
+        else
+        {
+            char *end = nullptr;
+            node->term.value = strtod(value.text.c_str(), &end);
+            if (value.kind != Token::Number || *end != '\0')
+                throw QueryError("Invalid number '" + value.text + "' in query");
+        }
+        return node;
+    }
+};
+
+Query::Query(const std::string &text)
+{
+    QueryParser(text).parse(*this);
+    plan();
+}
+
+Query::~Query() {}
+
+bool Query::matches(const Multimedia &media) const
+{
+    if (!root)
+        return true;
+    Row row;
+    fillRow(media, row);
+    return root->eval(row);
+}
+
+bool Query::numericValue(const Multimedia &media, Field field, double &value)
+{
+    Row row;
+    fillRow(media, row);
+    int i = static_cast<int>(field);
+    if (i >= NUMERIC_FIELDS || !((row.present >> i) & 1))
+        return false;
+    value = row.values[i];
+    return true;
+}
+
+const std::string *Query::getNameLower(bool &inclusive) const
+{
+    inclusive = lowerInclusive;
+    return hasNameLower ? &nameLower : nullptr;
+}
+
+const std::string *Query::getNameUpper(bool &inclusive) const
+{
+    inclusive = upperInclusive;
+    return hasNameUpper ? &nameUpper : nullptr;
+}
+
+void Query::plan()
+{
+    std::vector<const Node *> conjuncts;
+    if (const AndNode *node = dynamic_cast<const AndNode *>(root.get()))
+    {
+        for (const auto &child : node->others)
+            conjuncts.push_back(child.get());
+    }
+    else if (root)
+    {
+        conjuncts.push_back(root.get());
+    }
+
+    for (const Node *conjunct : conjuncts)
+    {
+        const NameNode *node = dynamic_cast<const NameNode *>(conjunct);
+        if (!node)
+            continue;
+        if (node->mask == EQ)
+        {
+            nameEquals = node->value;
+            hasNameEquals = true;
+        }
+        else if (node->mask == GT || node->mask == (GT | EQ))
+        {
+            if (!hasNameLower || node->value > nameLower)
+            {
+                nameLower = node->value;
+                lowerInclusive = node->mask & EQ;
+                hasNameLower = true;
+            }
+        }
+        else if (node->mask == LT || node->mask == (LT | EQ))
+        {
+            if (!hasNameUpper || node->value < nameUpper)
+            {
+                nameUpper = node->value;
+                upperInclusive = node->mask & EQ;
+                hasNameUpper = true;
+            }
+        }
+    }
+}
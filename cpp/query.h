@@ -0,0 +1,167 @@
+/**
+ * @file query.h
+ * @brief Header file for the Query class
+ *
+ * This file defines the Query class which compiles a small filter language into
+ * a predicate tree that can be evaluated over the multimedia objects of a Manager.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <limits>
+
+#include "multimedia.h"
+
+/**
+ * @class Query
+ * @brief A filter over multimedia objects compiled from a textual query
+ *
+ * A query is parsed once into a predicate tree and can then be evaluated any
+ * number of times. The grammar is:
+ *
+ * @code
+ *   query     := [expr] ["order" "by" field ["asc"|"desc"]] ["limit" N] ["offset" N]
+ *   expr      := term ("or" term)*
+ *   term      := factor ("and" factor)*
+ *   factor    := "not" factor | "(" expr ")" | field op value
+ *   field     := "type" | "name" | "duration" | "chapters"
+ *   op        := "=" | "!=" | "<" | "<=" | ">" | ">=" | "~"
+ * @endcode
+ *
+ * For example: `type=Video and duration>60 and name~"Toy" order by duration limit 20`.
+ * The `~` operator tests whether the name contains the given string. Type values
+ * are Photo, Video and Film and are matched exactly (a Film is not a Video here).
+ * Objects without a given field (e.g. the duration of a Photo) never satisfy a
+ * comparison on that field and are sorted last.
+ *
+ * Numeric comparisons of a conjunction are evaluated without branches, then the
+ * remaining (string) predicates are evaluated with short-circuit. The query also
+ * exposes the name constraints of its top-level conjunction so that the Manager
+ * can restrict the scan to a range of its name index.
+ *
+ * @sa Manager::runQuery()
+ */
+class Query
+{
+public:
+    /**
+     * @enum Field
+     * @brief Fields that can be tested or used for ordering
+     */
+    enum class Field
+    {
+        Type,     ///< The MediaType of the object
+        Duration, ///< The duration of a Video or Film
+        Chapters, ///< The number of chapters of a Film
+        Name      ///< The name of the object
+    };
+
+    /** @brief Value of getLimit() when the query has no limit clause */
+    static const size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+    /**
+     * @brief Compiles a query
+     *
+     * @param[in] text The query in the language described above
+     *
+     * @throws QueryError if the query is malformed
+     */
+    explicit Query(const std::string &text);
+
+    /**
+     * @brief Destructor for Query
+     */
+    ~Query();
+
+    /**
+     * @brief Tests whether a multimedia object satisfies the query
+     *
+     * @param[in] media The object to test
+     * @return true if the object satisfies the filter part of the query
+     */
+    bool matches(const Multimedia &media) const;
+
+    /**
+     * @brief Retrieves the value of a numeric field of a multimedia object
+     *
+     * @param[in] media The multimedia object
+     * @param[in] field The field to read (must not be Field::Name)
+     * @param[out] value The value of the field if present
+     * @return false if the object has no such field
+     */
+    static bool numericValue(const Multimedia &media, Field field, double &value);
+
+    /**
+     * @brief Retrieves the name equality constraint of the query, if any
+     *
+     * @return A pointer to the name the results must be equal to, or nullptr
+     */
+    const std::string *getNameEquals() const { return hasNameEquals ? &nameEquals : nullptr; }
+
+    /**
+     * @brief Retrieves the lower bound on names of the query, if any
+     *
+     * @param[out] inclusive true if the bound itself may match
+     * @return A pointer to the lower bound, or nullptr
+     */
+    const std::string *getNameLower(bool &inclusive) const;
+
+    /**
+     * @brief Retrieves the upper bound on names of the query, if any
+     *
+     * @param[out] inclusive true if the bound itself may match
+     * @return A pointer to the upper bound, or nullptr
+     */
+    const std::string *getNameUpper(bool &inclusive) const;
+
+    /** @brief Returns true if the query has an order by clause */
+    bool isOrdered() const { return ordered; }
+
+    /** @brief Returns the field of the order by clause (Field::Name by default) */
+    Field getOrderBy() const { return orderBy; }
+
+    /** @brief Returns true if results are sorted in descending order */
+    bool isDescending() const { return descending; }
+
+    /** @brief Returns the maximum number of results, or NO_LIMIT */
+    size_t getLimit() const { return limit; }
+
+    /** @brief Returns the number of results to skip */
+    size_t getOffset() const { return offset; }
+
+    /** @brief Node of the compiled predicate tree (defined in query.cpp) */
+    struct Node;
+
+private:
+    Query(const Query &) = delete;
+    Query &operator=(const Query &) = delete;
+
+    /** @brief Root of the predicate tree, nullptr if every object matches */
+    std::unique_ptr<Node> root;
+
+    /** @brief Name equality constraint extracted from the top-level conjunction */
+    std::string nameEquals;
+    bool hasNameEquals = false;
+
+    /** @brief Name range constraints extracted from the top-level conjunction */
+    std::string nameLower, nameUpper;
+    bool hasNameLower = false, hasNameUpper = false;
+    bool lowerInclusive = false, upperInclusive = false;
+
+    /** @brief Ordering and pagination clauses */
+    bool ordered = false;
+    Field orderBy = Field::Name;
+    bool descending = false;
+    size_t limit = NO_LIMIT;
+    size_t offset = 0;
+
+    /** @brief Extracts name constraints usable as an index range */
+    void plan();
+    friend class QueryParser;
+};
+
+#endif // QUERY_H
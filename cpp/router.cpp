@@ -0,0 +1,842 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "router.h"
+#include "manager.h"
+#include "query.h"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void CommandArgs::skipSpaces()
+{
+    size_t start = text.find_first_not_of(' ');
+    text.remove_prefix(start == std::string_view::npos ? text.size() : start);
+}
+
+std::string_view CommandArgs::next()
+{
+    skipSpaces();
+    size_t end = text.find(' ');
+    std::string_view word = text.substr(0, end);
+    text.remove_prefix(word.size());
+    return word;
+}
+
+std::string_view CommandArgs::rest()
+{
+    skipSpaces();
+    size_t end = text.find_last_not_of(' ');
+    std::string_view remaining = text.substr(0, end == std::string_view::npos ? 0 : end + 1);
+    text = std::string_view();
+    return remaining;
+}
+
+std::string_view CommandArgs::nextName(bool last)
+{
+    skipSpaces();
+    if (text.size() >= 2 && text[0] == '"')
+    {
+        size_t end = text.find('"', 1);
+        if (end != std::string_view::npos)
+        {
+            std::string_view name = text.substr(1, end - 1);
+            text.remove_prefix(end + 1);
+            return name;
+        }
+    }
+    return last ? rest() : next();
+}
+
+bool CommandArgs::empty()
+{
+    skipSpaces();
+    return text.empty();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Command handlers
+
+namespace
+{
+    // search <name> [ifnot <version>]
+    bool handleSearch(Manager &m, CommandArgs &args, std::string &response)
+    {
+        unsigned long known = 0;
+        bool conditional = args.lastNumber("ifnot", known);
+        std::string name(args.nextName(true));
+        std::optional<unsigned long> version = m.findVersion(name);
+        if (!version)
+        {
+            response = (m.isLoading() ? "LOADING " : "NOTFOUND ") + name;
+            return true;
+        }
+        if (conditional && *version == known)
+        {
+            response = "NOTMODIFIED " + std::to_string(*version);
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "VERSION " << *version << " ";
+        m.trySearchAndDisplay(name, oss);
+        response = oss.str();
+        return true;
+    }
+
+    // query <filter> [order by <field> [desc]] [limit <n>] [offset <n>]
+    bool handleQuery(Manager &m, CommandArgs &args, std::string &response)
+    {
+        try
+        {
+            Query query{std::string(args.rest())};
+            std::string names;
+            size_t count = m.runQuery(query, [&](const Multimedia &media)
+                                      { names += ' ';
+                                        names += media.getName(); });
+            response = "RESULTS " + std::to_string(count) + names;
+        }
+        catch (const std::exception &e)
+        {
+            response = std::string("ERROR ") + e.what();
+        }
+        return true;
+    }
+
+    // list [Photo|Video|Film] [orderby name|duration] [after <cursor>] [limit <n>]
+    bool handleList(Manager &m, CommandArgs &args, std::string &response)
+    {
+        MediaType type = MediaType::Photo;
+        bool hasType = false, byDuration = false;
+        std::string_view cursor;
+        size_t limit = 50;
+        try
+        {
+            while (!args.empty())
+            {
+                std::string_view word = args.next();
+                if (word == "Photo" || word == "Video" || word == "Film")
+                {
+                    type = word == "Photo" ? MediaType::Photo : word == "Video" ? MediaType::Video : MediaType::Film;
+                    hasType = true;
+                }
+                else if (word == "orderby")
+                {
+                    std::string_view field = args.next();
+                    if (field != "name" && field != "duration")
+                        throw std::invalid_argument("Invalid list ordering: " + std::string(field));
+                    byDuration = field == "duration";
+                }
+                else if (word == "after" && !args.empty())
+                    cursor = args.next();
+                else if (word == "limit" && args.nextNumber(limit) && limit > 0)
+                    continue;
+                else
+                    throw std::invalid_argument("Invalid list argument: " + std::string(word));
+            }
+            std::string names;
+            size_t count = 0;
+            std::string next = m.listMedias([&](const Multimedia &media)
+                                            { names += ' ';
+                                              names += media.getName();
+                                              ++count; },
+                                            limit, byDuration, hasType ? &type : nullptr, std::string(cursor));
+            response = "ITEMS " + std::to_string(count) + " NEXT " + (next.empty() ? "-" : next) + names;
+        }
+        catch (const std::exception &e)
+        {
+            response = std::string("ERROR ") + e.what();
+        }
+        return true;
+    }
+
+    // stats [group]
+    bool handleStats(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string group(args.nextName(true));
+        std::ostringstream oss;
+        try
+        {
+            const CatalogStats &stats = group.empty() ? m.getStats() : m.getGroupStats(group);
+            oss << "STATS ";
+            stats.display(oss);
+        }
+        catch (const std::exception &e)
+        {
+            oss << "ERROR " << e.what();
+        }
+        response = oss.str();
+        return true;
+    }
+
+    // filterstats
+    bool handleFilterStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        const CountingBloomFilter &filter = m.getNameFilter();
+        std::ostringstream oss;
+        oss << "FILTER lookups=" << m.getLookupCount()
+            << " skipped=" << m.getSkippedLookupCount()
+            << " names=" << filter.size()
+            << " capacity=" << filter.getCapacity()
+            << " fpr=" << filter.getFalsePositiveRate();
+        response = oss.str();
+        return true;
+    }
+
+    // cachestats
+    bool handleCacheStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        const LazyCatalog *lazy = m.getLazyCatalog();
+        if (!lazy)
+        {
+            response = "CACHE none";
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "CACHE entries=" << lazy->size()
+            << " resident=" << lazy->getResident()
+            << " capacity=" << lazy->getCapacity()
+            << " hits=" << lazy->getHits()
+            << " misses=" << lazy->getMisses()
+            << " evictions=" << lazy->getEvictions()
+            << " p50=" << lazy->getLatencyPercentile(0.5) << "ns"
+            << " p99=" << lazy->getLatencyPercentile(0.99) << "ns"
+            << " p999=" << lazy->getLatencyPercentile(0.999) << "ns";
+        response = oss.str();
+        return true;
+    }
+
+    // play <name>
+    bool handlePlay(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string name(args.nextName(true));
+        response = m.tryPlayMedia(name) ? "OK" : (m.isLoading() ? "LOADING " : "NOTFOUND ") + name;
+        return true;
+    }
+
+    // delete <name>
+    bool handleDelete(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string name(args.nextName(true));
+        response = m.tryDeleteByName(name) ? "OK" : "NOTFOUND " + name;
+        return true;
+    }
+
+    // logstats
+    bool handleLogStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        const MutationLog *log = m.getLog();
+        if (!log)
+        {
+            response = "LOG none";
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "LOG appended=" << log->getAppended()
+            << " durable=" << log->getDurable()
+            << " syncs=" << log->getSyncCount()
+            << " size=" << log->size()
+            << " compacting=" << (m.isCompacting() ? 1 : 0);
+        response = oss.str();
+        return true;
+    }
+
+    // compact
+    bool handleCompact(Manager &m, CommandArgs &, std::string &response)
+    {
+        response = m.compact() ? "OK" : "ERROR no log or compaction already running";
+        return true;
+    }
+
+    // bgsave <file>
+    bool handleBgSave(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string filename(args.rest());
+        if (filename.empty())
+            response = "ERROR missing file name";
+        else
+            response = m.backgroundSave(filename) ? "OK" : "ERROR a save is already running or fork failed";
+        return true;
+    }
+
+    // lastsave
+    bool handleLastSave(Manager &m, CommandArgs &, std::string &response)
+    {
+        static const char *const states[] = {"none", "running", "ok", "failed"};
+        Manager::SaveStatus status = m.getLastSave();
+        std::ostringstream oss;
+        oss << "LASTSAVE " << states[status.state];
+        if (status.state != Manager::SaveStatus::None)
+            oss << " file=" << status.filename;
+        if (status.finished != 0)
+            oss << " seconds=" << status.seconds << " finished=" << status.finished;
+        response = oss.str();
+        return true;
+    }
+
+    // reloadstats
+    bool handleReloadStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        static const char *const states[] = {"none", "running", "ok", "failed"};
+        Manager::ReloadStatus status = m.getLastReload();
+        std::ostringstream oss;
+        oss << "RELOAD " << states[status.state];
+        if (status.state != Manager::ReloadStatus::None)
+            oss << " file=" << status.filename << " count=" << status.count;
+        if (status.finished != 0)
+            oss << " load=" << status.loadSeconds << " diff=" << status.diffSeconds
+                << " swap=" << status.swapSeconds << " added=" << status.added
+                << " changed=" << status.changed << " removed=" << status.removed
+                << " groups=" << status.groupsChanged << " groupsremoved=" << status.groupsRemoved
+                << " finished=" << status.finished;
+        response = oss.str();
+        return true;
+    }
+
+    // loadstats
+    bool handleLoadStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        std::shared_ptr<const CatalogLoad> load = m.getLoad();
+        if (!load)
+        {
+            response = "LOAD none";
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "LOAD " << (load->isDone() ? "done" : "running")
+            << " file=" << load->getFilename()
+            << " bytes=" << load->getLoadedBytes() << "/" << load->getTotalBytes()
+            << " records=" << load->getRecords()
+            << " errors=" << load->getErrors()
+            << " seconds=" << load->getSeconds();
+        response = oss.str();
+        return true;
+    }
+
+    bool parseHashMode(std::string_view word, contenthash::Mode &mode)
+    {
+        static const char *const modes[] = {"none", "sampled", "full"};
+        for (int i = 0; i < 3; ++i)
+        {
+            if (word == modes[i])
+            {
+                mode = static_cast<contenthash::Mode>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ingest <directory> [threads <n>] [maxopen <n>] [batch <n>] [cache <file>] [hash none|sampled|full]
+    bool handleIngest(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string directory(args.next());
+        std::string cacheFile;
+        contenthash::Mode hashing = contenthash::Mode::Sampled;
+        unsigned threads = 0;
+        size_t maxOpenFiles = 64, batchSize = 256;
+        while (!args.empty())
+        {
+            std::string_view word = args.next();
+            if (!(word == "threads" && args.nextNumber(threads)) &&
+                !(word == "maxopen" && args.nextNumber(maxOpenFiles) && maxOpenFiles > 0) &&
+                !(word == "batch" && args.nextNumber(batchSize) && batchSize > 0) &&
+                !(word == "cache" && !(cacheFile = std::string(args.next())).empty()) &&
+                !(word == "hash" && parseHashMode(args.next(), hashing)))
+            {
+                response = "ERROR invalid option " + std::string(word);
+                return true;
+            }
+        }
+        if (directory.empty())
+        {
+            response = "ERROR missing directory";
+            return true;
+        }
+        auto report = [](const Manager::IngestStats &stats)
+        {
+            std::cout << "ingest: " << stats.files << " files, " << stats.photos + stats.videos + stats.films
+                      << " objects in " << stats.seconds << " s" << std::endl;
+        };
+        Manager::IngestStats stats;
+        std::unique_ptr<IngestCache> cache;
+        try
+        {
+            if (!cacheFile.empty())
+            {
+                cache.reset(new IngestCache(cacheFile));
+                cache->load();
+                if (cache->getDiscarded() > 0)
+                    std::cout << "ingest: " << cache->getDiscarded() << " bytes of " << cacheFile
+                              << " discarded" << std::endl;
+            }
+            stats = m.ingest(directory, threads, maxOpenFiles, batchSize, report, std::chrono::seconds(1), cache.get(),
+                             hashing);
+            if (cache && cache->isModified())
+                cache->save();
+        }
+        catch (const std::runtime_error &e)
+        {
+            response = std::string("ERROR ") + e.what();
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "INGESTED directories=" << stats.directories << " files=" << stats.files
+            << " photos=" << stats.photos << " videos=" << stats.videos << " films=" << stats.films
+            << " unchanged=" << stats.unchanged << " removed=" << stats.removed
+            << " duplicates=" << stats.duplicates
+            << " skipped=" << stats.skipped << " errors=" << stats.errors
+            << " seconds=" << stats.seconds
+            << " rate=" << (stats.seconds > 0 ? stats.files / stats.seconds : 0)
+            << " hashed=" << stats.hashedBytes
+            << " hashrate=" << (stats.hashSeconds > 0 ? stats.hashedBytes / stats.hashSeconds / 1e6 : 0);
+        // quoted, their control characters replaced, so that they cannot split
+        // the response or reach the terminal of the client
+        if (!stats.skippedPaths.empty())
+            oss << " skippedpaths=";
+        for (size_t i = 0; i < stats.skippedPaths.size(); ++i)
+        {
+            std::string path = stats.skippedPaths[i];
+            std::replace_if(path.begin(), path.end(), [](unsigned char c)
+                            { return c < ' ' || c == 0x7f; }, '?');
+            oss << (i > 0 ? " \"" : "\"") << path << '"';
+        }
+        response = oss.str();
+        return true;
+    }
+
+    // duplicates [limit <n>], each set as names separated by commas
+    bool handleDuplicates(Manager &m, CommandArgs &args, std::string &response)
+    {
+        size_t limit = 0;
+        if (!args.empty() && !(args.next() == "limit" && args.nextNumber(limit)))
+        {
+            response = "ERROR invalid option";
+            return true;
+        }
+        std::vector<std::vector<std::string>> sets = m.findDuplicates(limit);
+        response = "DUPLICATES " + std::to_string(sets.size());
+        for (const std::vector<std::string> &names : sets)
+        {
+            response += ' ';
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                if (i > 0)
+                    response += ',';
+                response += names[i];
+            }
+        }
+        return true;
+    }
+
+    // collapse
+    bool handleCollapse(Manager &m, CommandArgs &, std::string &response)
+    {
+        size_t groups, removed;
+        try
+        {
+            removed = m.collapseDuplicates(&groups);
+        }
+        catch (const std::runtime_error &e)
+        {
+            response = std::string("ERROR ") + e.what();
+            return true;
+        }
+        response = "COLLAPSED objects=" + std::to_string(removed) + " groups=" + std::to_string(groups);
+        return true;
+    }
+
+    // watchdir <directory> [quiet <ms>] [batch <n>] [interval <ms>] [hash none|sampled|full]
+    bool handleWatchDir(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string directory(args.next());
+        contenthash::Mode hashing = contenthash::Mode::Sampled;
+        unsigned long quiet = 500, interval = 100;
+        size_t batchSize = 1024;
+        while (!args.empty())
+        {
+            std::string_view word = args.next();
+            if (!(word == "quiet" && args.nextNumber(quiet)) &&
+                !(word == "batch" && args.nextNumber(batchSize) && batchSize > 0) &&
+                !(word == "interval" && args.nextNumber(interval)) &&
+                !(word == "hash" && parseHashMode(args.next(), hashing)))
+            {
+                response = "ERROR invalid option " + std::string(word);
+                return true;
+            }
+        }
+        if (directory.empty())
+        {
+            response = "ERROR missing directory";
+            return true;
+        }
+        Manager::IngestStats stats;
+        try
+        {
+            stats = m.watchDirectory(directory, std::chrono::milliseconds(quiet), batchSize,
+                                     std::chrono::milliseconds(interval), hashing);
+        }
+        catch (const std::runtime_error &e)
+        {
+            response = std::string("ERROR ") + e.what();
+            return true;
+        }
+        std::ostringstream oss;
+        oss << "WATCHING " << directory << " files=" << stats.files
+            << " objects=" << stats.photos + stats.videos + stats.films
+            << " errors=" << stats.errors << " seconds=" << stats.seconds;
+        response = oss.str();
+        return true;
+    }
+
+    // unwatchdir <directory>
+    bool handleUnwatchDir(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string directory(args.next());
+        response = m.unwatchDirectory(directory) ? "OK" : "NOTFOUND " + directory;
+        return true;
+    }
+
+    // watchstats, the watched directories separated by " ; "
+    bool handleWatchStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        std::vector<Manager::WatchStats> watches = m.getWatchStats();
+        std::ostringstream oss;
+        oss << "WATCHES " << watches.size();
+        for (size_t i = 0; i < watches.size(); ++i)
+        {
+            const Manager::WatchStats &stats = watches[i];
+            const DirectoryWatcher::Backlog &backlog = stats.backlog;
+            oss << (i > 0 ? " ; " : " ") << stats.directory
+                << " directories=" << backlog.directories
+                << " pending=" << backlog.pending
+                << " maxpending=" << backlog.maxPending
+                << " oldest=" << backlog.oldestSeconds << "s"
+                << " events=" << backlog.events
+                << " coalesced=" << backlog.coalesced
+                << " overflows=" << backlog.overflows
+                << " batches=" << backlog.batches
+                << " changes=" << backlog.changes
+                << " lastbatch=" << backlog.lastBatchSeconds << "s"
+                << " added=" << stats.added
+                << " updated=" << stats.updated
+                << " removed=" << stats.removed
+                << " unchanged=" << stats.unchanged
+                << " groups=" << stats.groups
+                << " skipped=" << stats.skipped
+                << " errors=" << stats.errors
+                << " rescans=" << stats.rescans
+                << " applied=" << stats.applySeconds << "s";
+        }
+        response = oss.str();
+        return true;
+    }
+
+    // fetch <name> [offset] [length], answered by "FILE <length> <offset> <size>" then
+    // the bytes of the file, sent by the server from the page cache
+    bool handleFetch(Manager &m, CommandArgs &args, std::string &response, TCPServer::Body &body)
+    {
+        // a name with spaces must be quoted, so that it cannot end with the range
+        std::string name(args.nextName());
+        uint64_t offset = 0, length = UINT64_MAX;
+        if ((!args.empty() && !args.nextNumber(offset)) || (!args.empty() && !args.nextNumber(length)) || !args.empty())
+        {
+            response = "ERROR invalid range";
+            return true;
+        }
+        const Multimedia *media = m.findMedia(name);
+        if (!media)
+        {
+            response = (m.isLoading() ? "LOADING " : "NOTFOUND ") + name;
+            return true;
+        }
+        std::string filepath = media->getFilepath();
+        int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            response = "ERROR cannot read " + filepath + (fd < 0 ? std::string(": ") + strerror(errno) : "");
+            if (fd >= 0)
+                ::close(fd);
+            return true;
+        }
+        uint64_t size = st.st_size;
+        if (offset > size)
+        {
+            ::close(fd);
+            response = "ERROR offset beyond the end of " + std::to_string(size) + " bytes";
+            return true;
+        }
+        length = std::min(length, size - offset);
+        ::posix_fadvise(fd, offset, length, POSIX_FADV_SEQUENTIAL);
+        body.fd = fd;
+        body.offset = offset;
+        body.length = length;
+        response = "FILE " + std::to_string(length) + " " + std::to_string(offset) + " " + std::to_string(size);
+        return true;
+    }
+
+    // thumb <name>, answered by "THUMB <length>" then the bytes of the JPEG thumbnail
+    bool handleThumb(Manager &m, CommandArgs &args, std::string &response)
+    {
+        std::string name(args.nextName(true));
+        const Multimedia *media = m.findMedia(name);
+        if (!media)
+        {
+            response = (m.isLoading() ? "LOADING " : "NOTFOUND ") + name;
+            return true;
+        }
+        if (media->getType() != MediaType::Photo)
+        {
+            response = "ERROR not a photo: " + name;
+            return true;
+        }
+        ThumbnailCache::Bytes thumbnail;
+        try
+        {
+            thumbnail = m.getThumbnail(name);
+        }
+        catch (const std::runtime_error &e)
+        {
+            response = std::string("ERROR ") + e.what();
+            return true;
+        }
+        if (thumbnail->empty())
+        {
+            response = "NOTHUMB " + name;
+            return true;
+        }
+        response = "THUMB " + std::to_string(thumbnail->size()) + "\n";
+        response += *thumbnail;
+        return true;
+    }
+
+    // thumbstats
+    bool handleThumbStats(Manager &m, CommandArgs &, std::string &response)
+    {
+        const ThumbnailCache &cache = m.getThumbnailCache();
+        unsigned long hits = cache.getHits(), misses = cache.getMisses();
+        std::ostringstream oss;
+        oss << "THUMBS entries=" << cache.size()
+            << " bytes=" << cache.getBytes()
+            << " capacity=" << cache.getCapacity()
+            << " hits=" << hits
+            << " misses=" << misses
+            << " evictions=" << cache.getEvictions()
+            << " hitrate=" << (hits + misses > 0 ? double(hits) / (hits + misses) : 0)
+            << " p50hit=" << cache.getLatencyPercentile(true, 0.5) << "ns"
+            << " p99hit=" << cache.getLatencyPercentile(true, 0.99) << "ns"
+            << " p50miss=" << cache.getLatencyPercentile(false, 0.5) << "ns"
+            << " p99miss=" << cache.getLatencyPercentile(false, 0.99) << "ns";
+        response = oss.str();
+        return true;
+    }
+
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // Dispatch table, built at compile time
+
+    // How a handler uses the Manager, hence which lock the router takes.
+    enum class Access
+    {
+        Read,   // shared lock
+        Scan,   // shared lock, once the lazily opened snapshot is materialised
+        Write,  // exclusive lock, then the mutations are committed to the log
+        Unlocked
+    };
+
+    struct Command
+    {
+        std::string_view verb;
+        CommandRouter::Handler handler;
+        Access access;
+        CommandRouter::StreamHandler stream = nullptr; // instead of handler
+    };
+
+    constexpr Command commands[] = {
+        {"search", &handleSearch, Access::Read},
+        {"query", &handleQuery, Access::Scan},
+        {"list", &handleList, Access::Scan},
+        {"stats", &handleStats, Access::Scan},
+        {"filterstats", &handleFilterStats, Access::Read},
+        {"cachestats", &handleCacheStats, Access::Read},
+        {"logstats", &handleLogStats, Access::Read},
+        {"play", &handlePlay, Access::Read},
+        {"delete", &handleDelete, Access::Write},
+        {"compact", &handleCompact, Access::Unlocked},
+        {"bgsave", &handleBgSave, Access::Unlocked},
+        {"lastsave", &handleLastSave, Access::Read},
+        {"reloadstats", &handleReloadStats, Access::Unlocked},
+        {"loadstats", &handleLoadStats, Access::Unlocked},
+        {"ingest", &handleIngest, Access::Unlocked},
+        {"duplicates", &handleDuplicates, Access::Read},
+        {"collapse", &handleCollapse, Access::Unlocked},
+        {"thumb", &handleThumb, Access::Read},
+        {"thumbstats", &handleThumbStats, Access::Unlocked},
+        {"watchdir", &handleWatchDir, Access::Unlocked},
+        {"unwatchdir", &handleUnwatchDir, Access::Unlocked},
+        {"watchstats", &handleWatchStats, Access::Unlocked},
+        {"fetch", nullptr, Access::Read, &handleFetch},
+    };
+
+    constexpr size_t COMMAND_COUNT = sizeof(commands) / sizeof(commands[0]);
+
+    // must be a power of two, large enough for a perfect hash to be found easily
+    constexpr size_t TABLE_SIZE = 128;
+    static_assert(COMMAND_COUNT < TABLE_SIZE / 2, "TABLE_SIZE is too small");
+
+    // FNV-1a with a seed
+    constexpr uint32_t hashVerb(std::string_view verb, uint32_t seed)
+    {
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : verb)
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        return h;
+    }
+
+    constexpr bool isPerfect(uint32_t seed)
+    {
+        bool used[TABLE_SIZE] = {};
+        for (const Command &command : commands)
+        {
+            size_t slot = hashVerb(command.verb, seed) & (TABLE_SIZE - 1);
+            if (used[slot])
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t findSeed()
+    {
+        for (uint32_t seed = 0; seed < 10000; ++seed)
+            if (isPerfect(seed))
+                return seed;
+        return UINT32_MAX;
+    }
+
+    constexpr uint32_t SEED = findSeed();
+    static_assert(SEED != UINT32_MAX, "No perfect hash found for the command verbs");
+
+    // slot -> index in commands, or -1
+    constexpr std::array<int8_t, TABLE_SIZE> buildTable()
+    {
+        std::array<int8_t, TABLE_SIZE> table{};
+        for (size_t i = 0; i < TABLE_SIZE; ++i)
+            table[i] = -1;
+        for (size_t i = 0; i < COMMAND_COUNT; ++i)
+            table[hashVerb(commands[i].verb, SEED) & (TABLE_SIZE - 1)] = static_cast<int8_t>(i);
+        return table;
+    }
+
+    constexpr std::array<int8_t, TABLE_SIZE> table = buildTable();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+namespace
+{
+    const Command *findCommand(std::string_view verb)
+    {
+        int index = table[hashVerb(verb, SEED) & (TABLE_SIZE - 1)];
+        if (index < 0 || commands[index].verb != verb)
+            return nullptr;
+        return &commands[index];
+    }
+}
+
+CommandRouter::Handler CommandRouter::find(std::string_view verb)
+{
+    const Command *command = findCommand(verb);
+    return command ? command->handler : nullptr;
+}
+
+bool CommandRouter::dispatch(std::string_view request, std::string &response, TCPServer::Body &body) const
+{
+    CommandArgs args(request);
+    std::string_view verb = args.next();
+    const Command *command = findCommand(verb);
+    if (!command)
+    {
+        response = "ERROR unknown command ";
+        response += verb;
+        return true;
+    }
+    auto run = [&]
+    {
+        return command->stream ? command->stream(*manager, args, response, body)
+                               : command->handler(*manager, args, response);
+    };
+
+    switch (command->access)
+    {
+    case Access::Read:
+    {
+        auto lock = manager->readLock();
+        return run();
+    }
+    case Access::Scan:
+    {
+        auto lock = manager->readLock();
+        if (manager->getLazyCatalog())
+        {
+            lock.unlock();
+            try
+            {
+                auto exclusive = manager->writeLock();
+                manager->materialize();
+            }
+            catch (const std::exception &e)
+            {
+                // a corrupted snapshot: the request fails, the server goes on
+                response = std::string("ERROR ") + e.what();
+                return true;
+            }
+            lock.lock();
+        }
+        return run();
+    }
+    case Access::Write:
+    {
+        bool keep;
+        {
+            auto lock = manager->writeLock();
+            keep = run();
+        }
+        // outside the lock, so that concurrent writers share the sync
+        try
+        {
+            manager->commitMutations();
+        }
+        catch (const std::exception &e)
+        {
+            response = std::string("ERROR ") + e.what();
+        }
+        return keep;
+    }
+    case Access::Unlocked:
+        break;
+    }
+    return run();
+}
+
+bool CommandRouter::operator()(const std::string &request, std::string &response, TCPServer::Body &body) const
+{
+    bool keep = dispatch(request, response, body);
+    if (verbose)
+    {
+        // binary data after a framed header is not logged
+        std::string line = "request: " + request + "\nresponse: ";
+        line.append(response, 0, response.find('\n'));
+        line += '\n';
+        std::cout << line;
+    }
+    return keep;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file router.h
+ * @brief Header file for the CommandRouter class
+ *
+ * This file defines the CommandRouter class which parses the requests received
+ * by the TCPServer and dispatches them to the handler of their command.
+ */
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+#include "tcpserver.h"
+
+class Manager;
+
+/**
+ * @class CommandArgs
+ * @brief Tokenizer over the arguments of a request
+ *
+ * Splits the arguments of a request into space-separated words without copying
+ * them: every word is a std::string_view into the request.
+ */
+class CommandArgs
+{
+public:
+    /**
+     * @brief Creates a tokenizer over a text
+     *
+     * @param[in] text The arguments, which must outlive the tokenizer
+     */
+    explicit CommandArgs(std::string_view text) : text(text) {}
+
+    /**
+     * @brief Returns the next word
+     *
+     * @return The next space-separated word, or an empty view if there is none
+     */
+    std::string_view next();
+
+    /**
+     * @brief Returns the remaining text without its surrounding spaces
+     *
+     * All the words are consumed, so that empty() returns true afterwards.
+     *
+     * @return The remaining text
+     */
+    std::string_view rest();
+
+    /**
+     * @brief Returns the next name
+     *
+     * Names may contain spaces: a name between double quotes is returned
+     * without them, and the name that ends a request may be written without
+     * quotes.
+     *
+     * @param[in] last true if nothing follows the name, which then extends to
+     *            the end of the text unless it is quoted
+     * @return The name, or an empty view if there is none
+     */
+    std::string_view nextName(bool last = false);
+
+    /** @brief Returns true if there is no word left */
+    bool empty();
+
+    /**
+     * @brief Parses the next word as a number
+     *
+     * @param[out] value The parsed number
+     * @return false (and no word is consumed) if the next word is not a number of type T
+     */
+    template <class T>
+    bool nextNumber(T &value)
+    {
+        skipSpaces();
+        size_t end = text.find(' ');
+        std::string_view word = text.substr(0, end);
+        auto result = std::from_chars(word.data(), word.data() + word.size(), value);
+        if (word.empty() || result.ec != std::errc() || result.ptr != word.data() + word.size())
+            return false;
+        text.remove_prefix(word.size());
+        return true;
+    }
+
+    /**
+     * @brief Parses an optional `<keyword> <number>` clause ending the text
+     *
+     * Lets a command take a name with spaces followed by an optional clause.
+     *
+     * @param[in] keyword The keyword of the clause
+     * @param[out] value The parsed number
+     * @return false (and nothing is consumed) if the text does not end with the clause
+     */
+    template <class T>
+    bool lastNumber(std::string_view keyword, T &value)
+    {
+        std::string_view head = text.substr(0, text.find_last_not_of(' ') + 1);
+        size_t space = head.find_last_of(' ');
+        if (space == std::string_view::npos)
+            return false;
+        std::string_view word = head.substr(space + 1);
+        head = head.substr(0, head.find_last_not_of(' ', space) + 1);
+        size_t start = head.find_last_of(' ');
+        start = start == std::string_view::npos ? 0 : start + 1;
+        T parsed;
+        auto result = std::from_chars(word.data(), word.data() + word.size(), parsed);
+        if (head.substr(start) != keyword || result.ec != std::errc() || result.ptr != word.data() + word.size())
+            return false;
+        value = parsed;
+        text = head.substr(0, start);
+        return true;
+    }
+
+private:
+    void skipSpaces();
+    std::string_view text;
+};
+
+/**
+ * @class CommandRouter
+ * @brief Dispatches server requests to command handlers
+ *
+ * A request is a command verb followed by its arguments, for example
+ * `search test-photo`. The handlers are registered in a constant table built at
+ * compile time and indexed by a perfect hash of the verb: the hash seed is
+ * chosen at compile time so that no two verbs collide, hence dispatching costs
+ * one hash, one table load and one string comparison. Requests are parsed from
+ * a std::string_view without any stream or string allocation.
+ *
+ * A CommandRouter can be passed directly to TCPServer as its callback. Unknown
+ * commands get an `ERROR` response. A few commands, such as `fetch`, have a
+ * StreamHandler instead, which may attach a file region sent by the server
+ * after the response.
+ *
+ * Each command of the table declares how it uses the Manager, and the router
+ * holds Manager::readLock() or Manager::writeLock() accordingly while the
+ * handler runs. After a command that modifies the catalog, the router releases
+ * the lock and waits for the mutations to be logged (Manager::commitMutations())
+ * before answering.
+ *
+ * @sa TCPServer, Manager
+ */
+class CommandRouter
+{
+public:
+    /**
+     * @brief Handler of a command
+     *
+     * @param manager The Manager the command operates on
+     * @param args The arguments of the command (the request without the verb)
+     * @param response The response sent back to the client
+     * @return false to close the connection with the client
+     */
+    using Handler = bool (*)(Manager &manager, CommandArgs &args, std::string &response);
+
+    /**
+     * @brief Handler of a command whose response may be followed by a file region
+     *
+     * Same as Handler; _body_ is sent after _response_ if its descriptor is set.
+     */
+    using StreamHandler = bool (*)(Manager &manager, CommandArgs &args, std::string &response,
+                                   TCPServer::Body &body);
+
+    /**
+     * @brief Creates a router for a Manager
+     *
+     * @param[in] manager The Manager the commands operate on, which must outlive the router
+     */
+    explicit CommandRouter(Manager &manager) : manager(&manager) {}
+
+    /**
+     * @brief Logs every request and response on std::cout
+     *
+     * Off by default: the lines are not flushed, but they still take the
+     * lock of the stream for each request.
+     *
+     * @param[in] verbose true to log the requests
+     */
+    void setVerbose(bool verbose) { this->verbose = verbose; }
+
+    /**
+     * @brief Processes a request
+     *
+     * Same as dispatch(), with the signature of TCPServer::StreamCallback.
+     *
+     * @param[in] request The request sent by the client
+     * @param[out] response The response sent back to the client
+     * @param[out] body The file region sent after the response, if any
+     * @return false to close the connection with the client
+     */
+    bool operator()(const std::string &request, std::string &response, TCPServer::Body &body) const;
+
+    /**
+     * @brief Dispatches a request to the handler of its command
+     *
+     * @param[in] request The request sent by the client
+     * @param[out] response The response sent back to the client
+     * @param[out] body The file region sent after the response, if any
+     * @return false to close the connection with the client
+     */
+    bool dispatch(std::string_view request, std::string &response, TCPServer::Body &body) const;
+
+    /**
+     * @brief Finds the handler of a command
+     *
+     * @param[in] verb The command verb
+     * @return The handler, or nullptr if there is no such command or if it
+     *         has a StreamHandler
+     */
+    static Handler find(std::string_view verb);
+
+private:
+    Manager *manager;
+    bool verbose = false;
+};
+
+#endif // ROUTER_H
@@ -0,0 +1,339 @@
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "snapshot.h"
+#include "catalogwriter.h"
+#include "mappedfile.h"
+#include "photo.h"
+#include "video.h"
+#include "film.h"
+
+static_assert(sizeof(int) == sizeof(int32_t), "chapters are stored as 32-bit integers");
+
+namespace
+{
+    constexpr char MAGIC[8] = {'M', 'M', 'S', 'N', 'A', 'P', '\r', '\n'};
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    enum Section
+    {
+        STRINGS,
+        MEDIA,
+        CHAPTERS,
+        GROUPS,
+        MEMBERS,
+        SECTION_COUNT
+    };
+
+    struct SectionEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t checksum;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t fileSize;
+        uint64_t mediaCount;
+        uint64_t groupCount;
+        uint64_t logSegment; // last log segment folded into the snapshot, 0 if none
+        SectionEntry sections[SECTION_COUNT];
+        uint64_t checksum; // of the preceding bytes
+    };
+
+    struct MediaEntry
+    {
+        uint64_t name;
+        uint64_t filepath;
+        uint32_t nameLength;
+        uint32_t filepathLength;
+        double latitude;
+        double longitude;
+        int32_t duration;
+        uint32_t chapterCount;
+        uint64_t chapters;
+        uint32_t type;
+        uint32_t reserved;
+    };
+
+    struct GroupEntry
+    {
+        uint64_t name;
+        uint32_t nameLength;
+        uint32_t memberCount;
+        uint64_t members;
+    };
+
+    static_assert(sizeof(Header) == 176 && sizeof(MediaEntry) == 64 && sizeof(GroupEntry) == 24,
+                  "the snapshot layout must not depend on the compiler");
+
+    size_t align(size_t size) { return (size + 7) & ~size_t(7); }
+
+    uint64_t rotate(uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+    [[noreturn]] void corrupted(const std::string &what)
+    {
+        throw std::runtime_error("Corrupted snapshot: " + what);
+    }
+}
+
+uint64_t snapshot::checksum(const void *data, size_t size)
+{
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL, PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    const char *bytes = static_cast<const char *>(data);
+    uint64_t lanes[4] = {PRIME1, PRIME2, ~PRIME1, ~PRIME2};
+
+    // four independent multiply chains keep the pipeline busy
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i + 8 * lane, 8);
+            lanes[lane] = rotate(lanes[lane] + word * PRIME2, 31) * PRIME1;
+        }
+    }
+    uint64_t hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18) + size;
+    for (; i < size; ++i)
+    {
+        hash = rotate(hash ^ static_cast<unsigned char>(bytes[i]) * PRIME1, 11) * PRIME2;
+    }
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// SnapshotWriter
+
+struct SnapshotWriter::Tables
+{
+    std::string strings;
+    std::vector<MediaEntry> medias;
+    std::vector<int32_t> chapters;
+    std::vector<GroupEntry> groups;
+    std::vector<uint32_t> members;
+    uint64_t logSegment = 0;
+
+    uint64_t addString(std::string_view text)
+    {
+        uint64_t offset = strings.size();
+        strings.append(text);
+        return offset;
+    }
+};
+
+SnapshotWriter::SnapshotWriter() : tables(new Tables()) {}
+
+SnapshotWriter::~SnapshotWriter() = default;
+
+uint32_t SnapshotWriter::addMedia(std::string_view name, const Multimedia &media)
+{
+    MediaEntry entry{};
+    entry.name = tables->addString(name);
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    std::string filepath = media.getFilepath();
+    entry.filepath = tables->addString(filepath);
+    entry.filepathLength = static_cast<uint32_t>(filepath.size());
+    entry.type = static_cast<uint32_t>(media.getType());
+    switch (media.getType())
+    {
+    case MediaType::Photo:
+    {
+        const Photo &photo = static_cast<const Photo &>(media);
+        entry.latitude = photo.getLatitude();
+        entry.longitude = photo.getLongitude();
+        break;
+    }
+    case MediaType::Film:
+    {
+        const Film &film = static_cast<const Film &>(media);
+        entry.chapters = tables->chapters.size();
+        entry.chapterCount = static_cast<uint32_t>(film.getChapterNumber());
+        const int *chapters = film.getChapters();
+        tables->chapters.insert(tables->chapters.end(), chapters, chapters + film.getChapterNumber());
+    }
+    // fall through
+    case MediaType::Video:
+        entry.duration = static_cast<const Video &>(media).getDuration();
+        break;
+    }
+    tables->medias.push_back(entry);
+    return static_cast<uint32_t>(tables->medias.size() - 1);
+}
+
+void SnapshotWriter::addGroup(std::string_view name, const std::vector<uint32_t> &members)
+{
+    GroupEntry entry{};
+    entry.name = tables->addString(name);
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    entry.members = tables->members.size();
+    entry.memberCount = static_cast<uint32_t>(members.size());
+    tables->members.insert(tables->members.end(), members.begin(), members.end());
+    tables->groups.push_back(entry);
+}
+
+void SnapshotWriter::setLogSegment(uint64_t segment)
+{
+    tables->logSegment = segment;
+}
+
+void SnapshotWriter::commit(const std::string &path) const
+{
+    const void *data[SECTION_COUNT] = {tables->strings.data(), tables->medias.data(), tables->chapters.data(),
+                                       tables->groups.data(), tables->members.data()};
+    size_t sizes[SECTION_COUNT] = {tables->strings.size(),
+                                   tables->medias.size() * sizeof(MediaEntry),
+                                   tables->chapters.size() * sizeof(int32_t),
+                                   tables->groups.size() * sizeof(GroupEntry),
+                                   tables->members.size() * sizeof(uint32_t)};
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = snapshot::VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.mediaCount = tables->medias.size();
+    header.groupCount = tables->groups.size();
+    header.logSegment = tables->logSegment;
+    size_t offset = align(sizeof(Header));
+    for (int section = 0; section < SECTION_COUNT; ++section)
+    {
+        header.sections[section] = {offset, sizes[section], snapshot::checksum(data[section], sizes[section])};
+        offset = align(offset + sizes[section]);
+    }
+    header.fileSize = offset;
+    header.checksum = snapshot::checksum(&header, offsetof(Header, checksum));
+
+    static const char padding[8] = {};
+    CatalogWriter out(path);
+    out.write(&header, sizeof(header));
+    out.write(padding, align(sizeof(Header)) - sizeof(Header));
+    for (int section = 0; section < SECTION_COUNT; ++section)
+    {
+        out.write(data[section], sizes[section]);
+        out.write(padding, align(sizes[section]) - sizes[section]);
+    }
+    out.commit();
+}
+
+// SnapshotReader
+
+SnapshotReader::SnapshotReader(const std::string &path, bool verify) : mapping(new MappedFile(path))
+{
+    Header header;
+    if (mapping->size() < sizeof(header))
+        corrupted(path + " is too small");
+    memcpy(&header, mapping->data(), sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        corrupted(path + " is not a snapshot");
+    if (header.byteOrder != BYTE_ORDER_MARK)
+        throw std::runtime_error(path + " was written on a machine of another byte order");
+    if (header.version != snapshot::VERSION)
+        throw std::runtime_error(path + " has unsupported snapshot version " + std::to_string(header.version));
+    if (header.checksum != snapshot::checksum(&header, offsetof(Header, checksum)))
+        corrupted(path + " has a bad header checksum");
+    if (header.fileSize != mapping->size())
+        corrupted(path + " is truncated");
+
+    const char *sections[SECTION_COUNT];
+    for (int section = 0; section < SECTION_COUNT; ++section)
+    {
+        const SectionEntry &entry = header.sections[section];
+        if (entry.offset % 8 != 0 || entry.offset > mapping->size() || entry.size > mapping->size() - entry.offset)
+            corrupted(path + " has a section out of the file");
+        sections[section] = mapping->data() + entry.offset;
+        if (verify && entry.checksum != snapshot::checksum(sections[section], entry.size))
+            corrupted(path + " has a bad section checksum");
+    }
+
+    medias = header.mediaCount;
+    groups = header.groupCount;
+    segment = header.logSegment;
+    chapters = header.sections[CHAPTERS].size / sizeof(int32_t);
+    members = header.sections[MEMBERS].size / sizeof(uint32_t);
+    if (header.sections[MEDIA].size / sizeof(MediaEntry) != medias ||
+        header.sections[GROUPS].size / sizeof(GroupEntry) != groups)
+        corrupted(path + " has inconsistent counts");
+
+    strings = std::string_view(sections[STRINGS], header.sections[STRINGS].size);
+    mediaTable = sections[MEDIA];
+    chapterTable = reinterpret_cast<const int32_t *>(sections[CHAPTERS]);
+    groupTable = sections[GROUPS];
+    memberTable = reinterpret_cast<const uint32_t *>(sections[MEMBERS]);
+}
+
+SnapshotReader::~SnapshotReader() = default;
+
+std::string_view SnapshotReader::string(uint64_t offset, uint32_t length) const
+{
+    if (offset > strings.size() || length > strings.size() - offset)
+        corrupted("string out of the string table");
+    return strings.substr(offset, length);
+}
+
+std::string_view SnapshotReader::mediaName(size_t index) const
+{
+    MediaEntry entry;
+    memcpy(&entry, mediaTable + index * sizeof(MediaEntry), sizeof(entry));
+    return string(entry.name, entry.nameLength);
+}
+
+SnapshotMedia SnapshotReader::media(size_t index) const
+{
+    if (index >= medias)
+        throw std::out_of_range("snapshot media index");
+    MediaEntry entry;
+    memcpy(&entry, mediaTable + index * sizeof(MediaEntry), sizeof(entry));
+    if (entry.type > static_cast<uint32_t>(MediaType::Film))
+        corrupted("unknown media type");
+    if (entry.chapters > chapters || entry.chapterCount > chapters - entry.chapters)
+        corrupted("chapters out of the chapter table");
+    if (!std::isfinite(entry.latitude) || !std::isfinite(entry.longitude))
+        corrupted("non-finite photo coordinates");
+
+    return SnapshotMedia{static_cast<MediaType>(entry.type),
+                         string(entry.name, entry.nameLength),
+                         string(entry.filepath, entry.filepathLength),
+                         entry.latitude,
+                         entry.longitude,
+                         entry.duration,
+                         chapterTable + entry.chapters,
+                         entry.chapterCount};
+}
+
+SnapshotGroup SnapshotReader::group(size_t index) const
+{
+    if (index >= groups)
+        throw std::out_of_range("snapshot group index");
+    GroupEntry entry;
+    memcpy(&entry, groupTable + index * sizeof(GroupEntry), sizeof(entry));
+    if (entry.members > members || entry.memberCount > members - entry.members)
+        corrupted("members out of the member table");
+    for (uint32_t i = 0; i < entry.memberCount; ++i)
+    {
+        if (memberTable[entry.members + i] >= medias)
+            corrupted("member out of the media table");
+    }
+    return SnapshotGroup{string(entry.name, entry.nameLength), memberTable + entry.members, entry.memberCount};
+}
+
+size_t SnapshotReader::findMedia(std::string_view name) const
+{
+    size_t low = 0, high = medias;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (mediaName(middle) < name)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < medias && mediaName(low) == name ? low : npos;
+}
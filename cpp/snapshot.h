@@ -0,0 +1,198 @@
+/**
+ * @file snapshot.h
+ * @brief Header file for the SnapshotWriter and SnapshotReader classes
+ *
+ * This file defines the binary snapshot format of a catalog, which can be
+ * loaded from a memory mapping without parsing.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "multimedia.h"
+
+class MappedFile;
+
+/**
+ * @brief Layout of a snapshot file
+ *
+ * A snapshot starts with a fixed-size header (magic, format version, byte-order
+ * mark, counts, last folded log segment) holding the offset, size and checksum
+ * of five sections, each aligned on 8 bytes:
+ * - the string table, where all names and paths are concatenated;
+ * - the media table, one fixed-size entry per object, sorted by name;
+ * - the chapter table, the chapter lengths of all films;
+ * - the group table, one fixed-size entry per group, sorted by name;
+ * - the member table, the indices in the media table of the group members.
+ *
+ * Entries refer to the other tables by offset and length, so nothing has to be
+ * fixed up after the file is mapped. The header has its own checksum; the
+ * version is increased whenever the layout changes, and older versions are
+ * rejected.
+ */
+namespace snapshot
+{
+    /** @brief Current version of the format */
+    constexpr uint32_t VERSION = 2;
+
+    /** @brief 64-bit checksum of a section, computed on four independent lanes */
+    uint64_t checksum(const void *data, size_t size);
+}
+
+/**
+ * @struct SnapshotMedia
+ * @brief View of one multimedia object of a snapshot
+ *
+ * The string views and the chapter pointer point into the mapped file.
+ */
+struct SnapshotMedia
+{
+    MediaType type;
+    std::string_view name;
+    std::string_view filepath;
+    double latitude;
+    double longitude;
+    int duration;
+    const int32_t *chapters;
+    size_t chapterCount;
+};
+
+/**
+ * @struct SnapshotGroup
+ * @brief View of one group of a snapshot
+ */
+struct SnapshotGroup
+{
+    std::string_view name;
+    const uint32_t *members; ///< indices in the media table
+    size_t memberCount;
+};
+
+/**
+ * @class SnapshotWriter
+ * @brief Builds a snapshot in memory and writes it atomically
+ */
+class SnapshotWriter
+{
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    /**
+     * @brief Adds a multimedia object
+     *
+     * Objects must be added in increasing name order, without duplicates.
+     *
+     * @return The index of the object, to be used as a group member
+     */
+    uint32_t addMedia(std::string_view name, const Multimedia &media);
+
+    /**
+     * @brief Adds a group
+     *
+     * Groups must be added in increasing name order, after all the objects.
+     *
+     * @param[in] name The name of the group
+     * @param[in] members The indices returned by addMedia() for its members
+     */
+    void addGroup(std::string_view name, const std::vector<uint32_t> &members);
+
+    /**
+     * @brief Records the last log segment folded into the snapshot
+     *
+     * The records of this segment and of the previous ones must not be
+     * replayed over the snapshot. 0 (the default) if there is no log.
+     */
+    void setLogSegment(uint64_t segment);
+
+    /**
+     * @brief Writes the snapshot to a temporary file renamed over _path_
+     *
+     * @throws std::runtime_error on I/O error, in which case _path_ is unchanged
+     */
+    void commit(const std::string &path) const;
+
+private:
+    struct Tables;
+    std::unique_ptr<Tables> tables;
+};
+
+/**
+ * @class SnapshotReader
+ * @brief Validated read-only view of a mapped snapshot
+ *
+ * The constructor checks the header and the checksums; the accessors check that
+ * the offsets of the entry they decode stay inside their tables, so that a
+ * corrupted file raises an exception instead of reading out of bounds.
+ */
+class SnapshotReader
+{
+public:
+    /**
+     * @brief Maps and validates a snapshot
+     *
+     * @param[in] path The snapshot file
+     * @param[in] verify false to skip the section checksums, which read the whole file
+     *
+     * @throws std::runtime_error if the file cannot be mapped, has an unsupported
+     *         version or is corrupted
+     */
+    explicit SnapshotReader(const std::string &path, bool verify = true);
+    ~SnapshotReader();
+
+    /** @brief Returns the number of multimedia objects */
+    size_t mediaCount() const { return medias; }
+
+    /** @brief Returns the number of groups */
+    size_t groupCount() const { return groups; }
+
+    /** @brief Returns the last log segment folded into the snapshot, 0 if none */
+    uint64_t logSegment() const { return segment; }
+
+    /**
+     * @brief Decodes a multimedia object
+     * @throws std::out_of_range if _index_ is too large
+     * @throws std::runtime_error if the entry is corrupted
+     */
+    SnapshotMedia media(size_t index) const;
+
+    /**
+     * @brief Decodes a group
+     * @throws std::out_of_range if _index_ is too large
+     * @throws std::runtime_error if the entry is corrupted
+     */
+    SnapshotGroup group(size_t index) const;
+
+    /** @brief Returns the index of an object by binary search, or npos */
+    size_t findMedia(std::string_view name) const;
+
+    /** @brief Returns the mapped file */
+    const MappedFile &file() const { return *mapping; }
+
+    static constexpr size_t npos = size_t(-1);
+
+private:
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    std::string_view string(uint64_t offset, uint32_t length) const;
+    std::string_view mediaName(size_t index) const;
+
+    std::unique_ptr<MappedFile> mapping;
+    std::string_view strings;
+    const char *mediaTable = nullptr;
+    const int32_t *chapterTable = nullptr;
+    const char *groupTable = nullptr;
+    const uint32_t *memberTable = nullptr;
+    size_t medias = 0, groups = 0, chapters = 0, members = 0;
+    uint64_t segment = 0;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <ostream>
+
+#include "stats.h"
+#include "photo.h"
+#include "video.h"
+#include "film.h"
+
+void CatalogStats::add(Multimedia &media)
+{
+    media.statistics.list.push_back(this);
+    count(media);
+}
+
+void CatalogStats::remove(Multimedia &media)
+{
+    std::vector<CatalogStats *> &list = media.statistics.list;
+    auto it = std::find(list.begin(), list.end(), this);
+    if (it == list.end())
+        return;
+    list.erase(it);
+    uncount(media);
+}
+
+void CatalogStats::count(const Multimedia &media)
+{
+    MediaType type = media.getType();
+    ++counts[static_cast<int>(type)];
+    if (type == MediaType::Photo)
+    {
+        const Photo &photo = static_cast<const Photo &>(media);
+        latitudes.insert(photo.getLatitude());
+        longitudes.insert(photo.getLongitude());
+        return;
+    }
+    totalDuration += static_cast<const Video &>(media).getDuration();
+    if (type == MediaType::Film)
+        chapterCounts.insert(static_cast<const Film &>(media).getChapterNumber());
+}
+
+void CatalogStats::uncount(const Multimedia &media)
+{
+    MediaType type = media.getType();
+    --counts[static_cast<int>(type)];
+    if (type == MediaType::Photo)
+    {
+        const Photo &photo = static_cast<const Photo &>(media);
+        latitudes.erase(latitudes.find(photo.getLatitude()));
+        longitudes.erase(longitudes.find(photo.getLongitude()));
+        return;
+    }
+    totalDuration -= static_cast<const Video &>(media).getDuration();
+    if (type == MediaType::Film)
+        chapterCounts.erase(chapterCounts.find(static_cast<const Film &>(media).getChapterNumber()));
+}
+
+double CatalogStats::getAverageDuration() const
+{
+    size_t videos = getCount(MediaType::Video) + getCount(MediaType::Film);
+    return videos == 0 ? 0 : double(totalDuration) / videos;
+}
+
+bool CatalogStats::getChapterRange(size_t &min, size_t &max) const
+{
+    if (chapterCounts.empty())
+        return false;
+    min = *chapterCounts.begin();
+    max = *chapterCounts.rbegin();
+    return true;
+}
+
+bool CatalogStats::getPhotoBounds(double &minLat, double &maxLat, double &minLon, double &maxLon) const
+{
+    if (latitudes.empty())
+        return false;
+    minLat = *latitudes.begin();
+    maxLat = *latitudes.rbegin();
+    minLon = *longitudes.begin();
+    maxLon = *longitudes.rbegin();
+    return true;
+}
+
+std::ostream &CatalogStats::display(std::ostream &os) const
+{
+    os << "photos=" << getCount(MediaType::Photo)
+       << " videos=" << getCount(MediaType::Video)
+       << " films=" << getCount(MediaType::Film)
+       << " duration.total=" << totalDuration
+       << " duration.avg=" << getAverageDuration();
+    size_t minChapters, maxChapters;
+    if (getChapterRange(minChapters, maxChapters))
+        os << " chapters.min=" << minChapters << " chapters.max=" << maxChapters;
+    double minLat, maxLat, minLon, maxLon;
+    if (getPhotoBounds(minLat, maxLat, minLon, maxLon))
+        os << " latitude.min=" << minLat << " latitude.max=" << maxLat
+           << " longitude.min=" << minLon << " longitude.max=" << maxLon;
+    return os;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file stats.h
+ * @brief Header file for the CatalogStats class
+ *
+ * This file defines the CatalogStats class which maintains aggregate values
+ * (counts, durations, chapters, photo locations) over a set of multimedia objects.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <ostream>
+#include <set>
+
+#include "multimedia.h"
+
+/**
+ * @class CatalogStats
+ * @brief Incrementally maintained aggregates over a set of multimedia objects
+ *
+ * The aggregates are updated each time an object is added to or removed from
+ * the set, and each time an object of the set is modified: objects keep a list
+ * of the CatalogStats they belong to and their setters remove their old values
+ * before the change and add the new values afterwards. All the getters answer
+ * in constant time; updates cost O(log n) because minima and maxima are kept in
+ * ordered multisets so that they survive removals.
+ *
+ * The Manager keeps one CatalogStats for its whole collection and each Group
+ * keeps one for its items.
+ *
+ * @sa Manager::getStats(), Group::getStats()
+ */
+class CatalogStats
+{
+public:
+    /**
+     * @brief Creates empty statistics
+     */
+    CatalogStats() = default;
+
+    /**
+     * @brief Destructor for CatalogStats
+     *
+     * The statistics must be empty (every object removed) when destroyed.
+     */
+    ~CatalogStats() = default;
+
+    /**
+     * @brief Adds an object to the set
+     *
+     * The object's values are accounted for, and its future modifications will
+     * update these statistics until it is removed. An object added twice is
+     * accounted for twice.
+     *
+     * @param[in] media The object to add
+     */
+    void add(Multimedia &media);
+
+    /**
+     * @brief Removes an object from the set
+     *
+     * @param[in] media The object to remove (must have been added before)
+     */
+    void remove(Multimedia &media);
+
+    /** @brief Returns the number of objects in the set */
+    size_t getCount() const { return counts[0] + counts[1] + counts[2]; }
+
+    /** @brief Returns the number of objects of a given type in the set */
+    size_t getCount(MediaType type) const { return counts[static_cast<int>(type)]; }
+
+    /** @brief Returns the total duration of the videos and films of the set */
+    long long getTotalDuration() const { return totalDuration; }
+
+    /** @brief Returns the average duration of the videos and films of the set (0 if none) */
+    double getAverageDuration() const;
+
+    /**
+     * @brief Retrieves the smallest and largest number of chapters of the films
+     *
+     * @param[out] min The smallest number of chapters
+     * @param[out] max The largest number of chapters
+     * @return false if the set contains no film
+     */
+    bool getChapterRange(size_t &min, size_t &max) const;
+
+    /**
+     * @brief Retrieves the geographic bounding box of the photos
+     *
+     * @param[out] minLat The smallest latitude
+     * @param[out] maxLat The largest latitude
+     * @param[out] minLon The smallest longitude
+     * @param[out] maxLon The largest longitude
+     * @return false if the set contains no photo
+     */
+    bool getPhotoBounds(double &minLat, double &maxLat, double &minLon, double &maxLon) const;
+
+    /**
+     * @brief Displays the statistics on a single line
+     *
+     * @param[in,out] os The output stream to write to
+     * @return A reference to the modified output stream
+     */
+    std::ostream &display(std::ostream &os) const;
+
+private:
+    CatalogStats(const CatalogStats &) = delete;
+    CatalogStats &operator=(const CatalogStats &) = delete;
+
+    /** @brief Accounts for the current values of an object */
+    void count(const Multimedia &media);
+
+    /** @brief Stops accounting for the current values of an object */
+    void uncount(const Multimedia &media);
+
+    /** @brief Number of objects per MediaType */
+    size_t counts[3] = {0, 0, 0};
+
+    /** @brief Sum of the durations of videos and films */
+    long long totalDuration = 0;
+
+    /** @brief Number of chapters of each film */
+    std::multiset<size_t> chapterCounts;
+
+    /** @brief Latitudes and longitudes of each photo */
+    std::multiset<double> latitudes, longitudes;
+
+    /** @brief Multimedia calls count() and uncount() around its modifications */
+    friend class Multimedia;
+};
+
+#endif // STATS_H
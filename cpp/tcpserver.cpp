@@ -4,12 +4,57 @@
 //  http://www.telecom-paristech.fr/~elc
 //
 
+#include <algorithm>
+#include <condition_variable>
 #include <csignal>
+#include <cerrno>
 #include <iostream>
+#include <mutex>
 #include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
 #include "tcpserver.h"
 using namespace std;
 
+/// the connection of a client that stops reading a Body for this long is closed
+static const int BODY_TIMEOUT_MS = 30000;
+
+/// Turns taken by the connections sending a Body: at most _slots_ at a time, in FIFO order.
+class TCPServer::Turns
+{
+public:
+  explicit Turns(unsigned slots) : free_(std::max(slots, 1u)) {}
+
+  void acquire()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    unsigned long ticket = next_++;
+    cond_.wait(lock, [&] { return ticket == serving_ && free_ > 0; });
+    ++serving_;
+    --free_;
+    // the next ticket may take another free slot
+    cond_.notify_all();
+  }
+
+  void release()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++free_;
+    cond_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  unsigned free_;
+  unsigned long next_ = 0, serving_ = 0;
+};
+
 /// Connection with a given client. Each SocketCnx uses a different thread.
 class SocketCnx
 {
@@ -47,6 +92,7 @@ void SocketCnx::processRequests()
   while (true)
   {
     std::string request, response;
+    TCPServer::Body body;
 
     // read the incoming request sent by the client
     // SocketBuffer::readLine() lit jusqu'au premier délimiteur (qui est supprimé)
@@ -70,16 +116,38 @@ void SocketCnx::processRequests()
       response = "OK";
     }
     // closes the connection with this client if the callback returns false
-    else if (!server_.callback_(request, response))
+    else if (!server_.callback_(request, response, body))
     {
+      if (body.fd >= 0) ::close(body.fd);
       server_.error("Closing connection with client");
       break;
     }
 
+    // the response and the start of the body leave in the same packets
+    int cork = 1;
+    if (body.fd >= 0)
+      ::setsockopt(sock_->descriptor(), IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+
     // a response is always sent to the client (otherwise it might block)
     // writeLine() response folled by a \n delimiter
     auto sent = sockbuf_->writeLine(response);
 
+    if (body.fd >= 0)
+    {
+      bool complete = sent > 0 && server_.sendBody(*sock_, body);
+      ::close(body.fd);
+      // the body is followed by a delimiter, as a response
+      if (complete) sent = sockbuf_->writeLine("");
+      cork = 0;
+      ::setsockopt(sock_->descriptor(), IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+      // a partial body cannot be told from the next response
+      if (!complete)
+      {
+        server_.error("Body not sent, closing connection with client");
+        break;
+      }
+    }
+
     if (sent < 0)
     {
       server_.error("Write error");
@@ -99,13 +167,64 @@ void SocketCnx::processRequests()
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-TCPServer::TCPServer(Callback const &callback) : callback_(callback)
+TCPServer::TCPServer(Callback const &callback)
+    : TCPServer(callback ? StreamCallback([callback](string const &request, string &response, Body &)
+                                          { return callback(request, response); })
+                         : StreamCallback())
 {
-  // signal(SIGPIPE, SIG_IGN);  // ignore nasty SIGPIPEs
+}
+
+TCPServer::TCPServer(StreamCallback const &callback)
+    : callback_(callback), turns_(new Turns(std::thread::hardware_concurrency() / 2))
+{
+  // ignore nasty SIGPIPEs: sendfile() has no MSG_NOSIGNAL, a client closing during a body
+  // must not kill the server
+  signal(SIGPIPE, SIG_IGN);
 }
 
 TCPServer::~TCPServer() {}
 
+void TCPServer::setStreaming(unsigned maxStreams, size_t chunkSize)
+{
+  turns_.reset(new Turns(maxStreams));
+  chunkSize_ = std::max<size_t>(chunkSize, 1);
+}
+
+bool TCPServer::sendBody(Socket &sock, Body const &body)
+{
+  int fd = sock.descriptor();
+  int flags = ::fcntl(fd, F_GETFL);
+  // a turn is never held while waiting for a slow client
+  ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  off_t offset = body.offset;
+  size_t remaining = body.length;
+  bool complete = true;
+  while (remaining > 0)
+  {
+    pollfd writable = {fd, POLLOUT, 0};
+    int ready = ::poll(&writable, 1, BODY_TIMEOUT_MS);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0 || (writable.revents & (POLLERR | POLLHUP)))
+    {
+      complete = false;
+      break;
+    }
+    turns_->acquire();
+    ssize_t sent = ::sendfile(fd, body.fd, &offset, std::min(remaining, chunkSize_));
+    turns_->release();
+    if (sent < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+    // 0: the file was truncated since the response was built
+    if (sent <= 0)
+    {
+      complete = false;
+      break;
+    }
+    remaining -= sent;
+  }
+  ::fcntl(fd, F_SETFL, flags);
+  return complete;
+}
+
 int TCPServer::run(int port)
 {
   int status = servsock_.bind(port); // lier le ServerSocket a ce port
@@ -9,6 +9,7 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <sys/types.h>
 #include "ccsocket.h"
 
 class TCPConnection;
@@ -16,12 +17,28 @@ class TCPLock;
 
 /// TCP/IP IPv4 server.
 /// Supports TCP/IP AF_INET IPv4 connections with multiple clients. One thread is used per client.
+///
+/// A response may be followed by a region of a file (a Body), sent with sendfile() without
+/// being copied to user space. Bodies are sent in chunks of at most _chunkSize_ bytes by at
+/// most _maxStreams_ connections at a time, which take turns in FIFO order: a large file
+/// is interleaved with the other bodies and leaves threads free for the other requests.
+/// Responses on a connection are sent in order.
 class TCPServer {
 public:
 
   using Callback =
   std::function< bool(std::string const& request, std::string& response) >;
 
+  /// A region of a file, sent after the response. The server closes _fd_ once it is sent.
+  struct Body {
+    int fd = -1;
+    off_t offset = 0;
+    size_t length = 0;
+  };
+
+  using StreamCallback =
+  std::function< bool(std::string const& request, std::string& response, Body& body) >;
+
   /// initializes the server.
   /// The callback function will be called each time the server receives a request from a client.
   /// - _request_ contains the data sent by the client
@@ -29,8 +46,17 @@ public:
   /// The connection with the client is closed if the callback returns false.
   TCPServer(Callback const& callback);
 
+  /// initializes a server whose responses may be followed by a Body.
+  /// If the callback sets _body.fd_, the _body.length_ bytes of the file starting at
+  /// _body.offset_ are sent after _response_ and its delimiter, followed by a delimiter.
+  TCPServer(StreamCallback const& callback);
+
   virtual ~TCPServer();
 
+  /// Limits the number of connections sending a Body at the same time (default: half of the
+  /// cores, at least one) and the bytes sent per turn (default: 256 KiB).
+  void setStreaming(unsigned maxStreams, size_t chunkSize);
+
   /// Starts the server.
   /// Binds an internal ServerSocket to _port_ then starts an infinite loop that processes connection
   /// requests from clients.
@@ -41,13 +67,19 @@ public:
 private:
   friend class TCPLock;
   friend class SocketCnx;
+  class Turns;
 
   TCPServer(TCPServer const&) = delete;
   TCPServer& operator=(TCPServer const&) = delete;
   void error(std::string const& msg);
 
+  /// sends a Body on a socket; false if the connection must be closed.
+  bool sendBody(Socket& sock, Body const& body);
+
   ServerSocket servsock_;
-  Callback callback_{};
+  StreamCallback callback_{};
+  std::unique_ptr<Turns> turns_;
+  size_t chunkSize_{256 * 1024};
 };
 
 #endif
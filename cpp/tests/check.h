@@ -0,0 +1,39 @@
+/**
+ * @file check.h
+ * @brief Minimal checks for the test programs of tests/
+ *
+ * Each test program checks one module and returns a non-zero status if a
+ * check failed; `make check` builds and runs them all.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+
+/** @brief Number of failed checks of the test program */
+inline int &checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+/** @brief Reports a failed condition, without stopping the test */
+#define CHECK(condition)                                                                     \
+    do                                                                                       \
+    {                                                                                        \
+        if (!(condition))                                                                    \
+        {                                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << '\n'; \
+            ++checkFailures();                                                               \
+        }                                                                                    \
+    } while (0)
+
+/** @brief Returns the exit status of the test program, after a summary */
+inline int checkResult(const char *name)
+{
+    std::cerr << name << ": " << (checkFailures() == 0 ? "ok" : "FAILED") << '\n';
+    return checkFailures() == 0 ? 0 : 1;
+}
+
+#endif // CHECK_H
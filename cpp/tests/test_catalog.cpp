@@ -0,0 +1,81 @@
+// Checks the text catalog: what save() writes is loaded back identically by
+// read() and by readParallel() with any number of threads, groups included
+// (their members are written as IDs).
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "check.h"
+#include "../manager.h"
+
+namespace
+{
+    std::string tempPath(const char *suffix)
+    {
+        return "/tmp/test_catalog." + std::to_string(::getpid()) + suffix;
+    }
+
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::string saved(const Manager &manager)
+    {
+        std::string text = tempPath(".out");
+        manager.save(text);
+        std::string content = readFile(text);
+        std::remove(text.c_str());
+        return content;
+    }
+}
+
+int main()
+{
+    std::string catalog = tempPath(".txt");
+    std::string text;
+    {
+        Manager manager;
+        std::vector<mmPtr> members;
+        for (int i = 0; i < 3000; ++i)
+        {
+            std::string name = "m" + std::to_string(i);
+            if (i % 3 == 0)
+                members.push_back(manager.createPhoto(name, name + ".jpg", i % 90, -(i % 180)));
+            else if (i % 3 == 1)
+                manager.createVideo(name, name + ".mp4", i);
+            else
+            {
+                int chapters[] = {i, i + 1};
+                members.push_back(manager.createFilm(name, name + ".mp4", 2 * i + 1, chapters, 2));
+            }
+        }
+        manager.createGroup("every third", members);
+        manager.createGroup("My favorites", {members[5], members[1]});
+        manager.createGroup("empty");
+        manager.save(catalog);
+        text = readFile(catalog);
+    }
+    CHECK(text.find("GroupIds") != std::string::npos);
+
+    {
+        Manager manager;
+        manager.read(catalog);
+        CHECK(manager.getMedias().size() == 3000);
+        CHECK(manager.findGroup("every third") && manager.findGroup("every third")->size() == 2000);
+        CHECK(saved(manager) == text);
+    }
+    for (unsigned threads : {1u, 2u, 7u})
+    {
+        Manager manager;
+        manager.readParallel(catalog, threads);
+        CHECK(saved(manager) == text);
+    }
+
+    std::remove(catalog.c_str());
+    return checkResult("test_catalog");
+}
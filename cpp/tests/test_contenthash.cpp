@@ -0,0 +1,84 @@
+// Checks the content hash against XXH64 reference values, in one piece and in
+// streaming, and checks that collapseDuplicates() only deletes the objects of
+// files identical to the kept one, even when their sampled hashes are equal.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "../manager.h"
+
+namespace
+{
+    void writeFile(const std::string &path, const std::string &content)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << content;
+    }
+}
+
+int main()
+{
+    // reference values of XXH64 with seed 0
+    CHECK(contenthash::hash("", 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(contenthash::hash("a", 1) == 0xD24EC4F1A98C6E5BULL);
+    CHECK(contenthash::hash("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+    // the digest only depends on the concatenation of the pieces
+    std::string text;
+    for (int i = 0; i < 1000; ++i)
+        text += char('a' + i * 7 % 26);
+    for (size_t piece : {1, 3, 31, 32, 33, 100})
+    {
+        contenthash::Hasher hasher;
+        for (size_t offset = 0; offset < text.size(); offset += piece)
+            hasher.update(text.data() + offset, std::min(piece, text.size() - offset));
+        CHECK(hasher.digest() == contenthash::hash(text.data(), text.size()));
+    }
+    CHECK(contenthash::hash(text.data(), text.size(), 1) != contenthash::hash(text.data(), text.size()));
+
+    // large videos, a single free box: the copies differ at an offset between
+    // the first two samples
+    std::string directory = "/tmp/test_contenthash." + std::to_string(::getpid());
+    ::mkdir(directory.c_str(), 0700);
+    std::string large(contenthash::SAMPLE_THRESHOLD + (1 << 20), 'x');
+    for (int i = 0; i < 4; ++i)
+        large[i] = char(large.size() >> (24 - 8 * i));
+    large.replace(4, 4, "free");
+    std::string changed = large;
+    changed[contenthash::SAMPLE_SIZE + 1000] = 'y';
+    writeFile(directory + "/a.mp4", large);
+    writeFile(directory + "/b.mp4", large);
+    writeFile(directory + "/c.mp4", changed);
+
+    uint64_t bytes;
+    uint64_t sampled = contenthash::hashFile(directory + "/a.mp4", contenthash::Mode::Sampled, bytes);
+    CHECK(bytes == contenthash::SAMPLES * contenthash::SAMPLE_SIZE);
+    CHECK(contenthash::hashFile(directory + "/c.mp4", contenthash::Mode::Sampled, bytes) == sampled);
+    uint64_t full = contenthash::hashFile(directory + "/a.mp4", contenthash::Mode::Full, bytes);
+    CHECK(bytes == large.size() && full == contenthash::hash(large.data(), large.size()));
+    CHECK(full != sampled);
+    CHECK(contenthash::hashFile(directory + "/c.mp4", contenthash::Mode::Full, bytes) != full);
+    CHECK(contenthash::sameContent(directory + "/a.mp4", directory + "/b.mp4"));
+    CHECK(!contenthash::sameContent(directory + "/a.mp4", directory + "/c.mp4"));
+
+    {
+        Manager manager;
+        Manager::IngestStats stats = manager.ingest(directory, 1);
+        CHECK(stats.videos == 3 && stats.errors == 0);
+        std::vector<std::vector<std::string>> sets = manager.findDuplicates();
+        CHECK(sets.size() == 1 && sets[0].size() == 3);
+        size_t groups;
+        CHECK(manager.collapseDuplicates(&groups) == 1);
+        CHECK(manager.findMedia("a.mp4") && !manager.findMedia("b.mp4") && manager.findMedia("c.mp4"));
+    }
+
+    for (const char *name : {"/a.mp4", "/b.mp4", "/c.mp4"})
+        std::remove((directory + name).c_str());
+    ::rmdir(directory.c_str());
+    return checkResult("test_contenthash");
+}
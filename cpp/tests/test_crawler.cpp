@@ -0,0 +1,70 @@
+// Checks the MediaCrawler: media files are told apart from the others by their
+// first bytes, and exceptions thrown by the visit or filter functions are
+// counted as errors instead of escaping the threads of the crawl.
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "../crawler.h"
+
+namespace
+{
+    void writeFile(const std::string &path, const std::string &content)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << content;
+    }
+}
+
+int main()
+{
+    std::string directory = "/tmp/test_crawler." + std::to_string(::getpid());
+    const char *names[] = {"/a.mp4", "/b.mp4", "/c.jpg", "/d.txt", "/sub/e.mp4"};
+    ::mkdir(directory.c_str(), 0700);
+    ::mkdir((directory + "/sub").c_str(), 0700);
+    std::string video("\0\0\0\x10" "ftypisom\0\0\0\0", 16);
+    writeFile(directory + names[0], video);
+    writeFile(directory + names[1], video);
+    writeFile(directory + names[2], "\xFF\xD8\xFF\xE0 not much of a photo");
+    writeFile(directory + names[3], "text");
+    writeFile(directory + names[4], video);
+
+    for (unsigned threads : {1u, 4u})
+    {
+        MediaCrawler crawler(threads);
+        std::atomic<int> photos{0}, videos{0};
+        MediaCrawler::Progress progress = crawler.crawl(directory, [&](unsigned, const MediaCrawler::File &file)
+                                                        { ++(file.type == MediaType::Photo ? photos : videos); });
+        CHECK(progress.media == 4 && progress.errors == 0);
+        CHECK(photos == 1 && videos == 3);
+
+        progress = crawler.crawl(directory, [](unsigned, const MediaCrawler::File &)
+                                 { throw std::runtime_error("visit"); });
+        CHECK(progress.media == 4 && progress.errors == 4);
+
+        // a.mp4 makes the filter throw and b.mp4 is rejected: c.jpg and sub/e.mp4 are visited
+        std::atomic<int> visited{0};
+        progress = crawler.crawl(
+            directory, [&](unsigned, const MediaCrawler::File &)
+            { ++visited; },
+            [](unsigned, const MediaCrawler::File &file) -> bool
+            {
+                if (file.relative == "a.mp4")
+                    throw std::runtime_error("filter");
+                return file.relative != "b.mp4";
+            });
+        CHECK(progress.errors == 1 && visited == 2);
+    }
+
+    for (const char *name : names)
+        std::remove((directory + name).c_str());
+    ::rmdir((directory + "/sub").c_str());
+    ::rmdir(directory.c_str());
+    return checkResult("test_crawler");
+}
@@ -0,0 +1,237 @@
+// Checks the EXIF parser on synthetic JPEG files in both byte orders: GPS
+// coordinates and their references, the IFD1 thumbnail, and malformed input
+// (truncated blocks, oversized counts and offsets), which must be reported as
+// missing metadata.
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "check.h"
+#include "../exif.h"
+
+namespace
+{
+    // Layout of the TIFF block written by build(), with the values to corrupt:
+    //   8: IFD0, the GPS pointer; 26: GPS IFD, four entries;
+    //   80: latitude, 104: longitude (three rationals each);
+    //   128: IFD1, the thumbnail tags; 158: the thumbnail.
+    struct Layout
+    {
+        bool little = true;
+        char latitudeRef = 'N', longitudeRef = 'W';
+        uint32_t gpsPointer = 26;
+        uint16_t gpsEntries = 4;
+        uint32_t latitudeCount = 3, latitudeOffset = 80;
+        uint32_t degrees = 48, denominator = 1;
+        uint32_t ifd1 = 128;
+        uint32_t thumbnailOffset = 158, thumbnailLength = 10;
+        char thumbnailStart = '\xFF';
+    };
+
+    const std::string THUMBNAIL("\xFF\xD8\xFF\xDB" "abc" "\xFF\xD9" "z", 10);
+
+    class Tiff
+    {
+    public:
+        explicit Tiff(bool little) : little(little), bytes(168, '\0') {}
+
+        void u16(size_t at, uint32_t value)
+        {
+            for (int i = 0; i < 2; ++i)
+                bytes[at + i] = char(value >> (little ? 8 * i : 8 * (1 - i)));
+        }
+
+        void u32(size_t at, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+                bytes[at + i] = char(value >> (little ? 8 * i : 8 * (3 - i)));
+        }
+
+        void entry(size_t at, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+        {
+            u16(at, tag);
+            u16(at + 2, type);
+            u32(at + 4, count);
+            u32(at + 8, value);
+        }
+
+        void rationals(size_t at, uint32_t a, uint32_t b, uint32_t c, uint32_t denominator)
+        {
+            for (uint32_t value : {a, b, c})
+            {
+                u32(at, value);
+                u32(at + 4, denominator);
+                at += 8;
+            }
+        }
+
+        bool little;
+        std::string bytes;
+    };
+
+    std::string wrap(const std::string &tiff)
+    {
+        std::string block = std::string("Exif\0\0", 6) + tiff;
+        size_t length = block.size() + 2;
+        std::string jpeg("\xFF\xD8", 2);
+        jpeg += std::string("\xFF\xE0\x00\x04\x00\x00", 6); // an APP0 segment first
+        jpeg += "\xFF\xE1";
+        jpeg += char(length >> 8);
+        jpeg += char(length & 0xFF);
+        return jpeg + block + "\xFF\xDA\x00\x02\xFF\xD9";
+    }
+
+    std::string build(const Layout &layout)
+    {
+        Tiff tiff(layout.little);
+        tiff.bytes.replace(0, 2, layout.little ? "II" : "MM");
+        tiff.u16(2, 42);
+        tiff.u32(4, 8);
+
+        tiff.u16(8, 1);
+        tiff.entry(10, 0x8825, 4, 1, layout.gpsPointer);
+        tiff.u32(22, layout.ifd1);
+
+        tiff.u16(26, layout.gpsEntries);
+        tiff.entry(28, 1, 2, 2, 0);
+        tiff.bytes[36] = layout.latitudeRef;
+        tiff.entry(40, 2, 5, layout.latitudeCount, layout.latitudeOffset);
+        tiff.entry(52, 3, 2, 2, 0);
+        tiff.bytes[60] = layout.longitudeRef;
+        tiff.entry(64, 4, 5, 3, 104);
+        tiff.u32(76, 0);
+        tiff.rationals(80, layout.degrees, 30, 0, layout.denominator);
+        tiff.rationals(104, 2, 15, 36, 1);
+
+        tiff.u16(128, 2);
+        tiff.entry(130, 0x201, 4, 1, layout.thumbnailOffset);
+        tiff.entry(142, 0x202, 3, 1, 0);
+        tiff.u16(150, layout.thumbnailLength);
+        tiff.u32(154, 0);
+        tiff.bytes.replace(158, 10, THUMBNAIL);
+        tiff.bytes[158] = layout.thumbnailStart;
+        return wrap(tiff.bytes);
+    }
+
+    bool near(double a, double b)
+    {
+        return std::fabs(a - b) < 1e-9;
+    }
+
+    bool located(const Layout &layout)
+    {
+        ExifData data;
+        return exif::parse(build(layout), data) && data.hasLocation;
+    }
+
+    bool hasThumbnail(const Layout &layout)
+    {
+        std::string jpeg = build(layout);
+        std::string_view thumbnail;
+        return exif::thumbnail(jpeg, thumbnail);
+    }
+}
+
+int main()
+{
+    for (bool little : {true, false})
+    {
+        Layout layout;
+        layout.little = little;
+        ExifData data;
+        std::string jpeg = build(layout);
+        CHECK(exif::parse(jpeg, data) && data.hasLocation);
+        CHECK(near(data.latitude, 48.5) && near(data.longitude, -2.26));
+
+        std::string_view thumbnail;
+        CHECK(exif::thumbnail(jpeg, thumbnail) && thumbnail == THUMBNAIL);
+
+        // southern and western references
+        layout.latitudeRef = 'S';
+        layout.longitudeRef = 'E';
+        CHECK(exif::parse(build(layout), data) && near(data.latitude, -48.5) && near(data.longitude, 2.26));
+    }
+
+    // not a JPEG, no EXIF block, no GPS directory
+    ExifData data;
+    CHECK(!exif::parse("", data) && !exif::parse("\x89PNG\r\n\x1a\n", data));
+    CHECK(!exif::parse(std::string("\xFF\xD8\xFF\xDA\x00\x02", 6), data));
+    Layout layout;
+    layout.gpsPointer = 0;
+    CHECK(!located(layout));
+
+    // every truncation of the file, and of the TIFF block within a valid segment
+    std::string jpeg = build(Layout());
+    bool none = true;
+    for (size_t size = 0; size < jpeg.size(); ++size)
+    {
+        ExifData truncated;
+        exif::parse(std::string_view(jpeg).substr(0, size), truncated);
+        std::string_view thumbnail;
+        none = none && (!truncated.hasLocation || size >= jpeg.size() - 6);
+        exif::thumbnail(std::string_view(jpeg).substr(0, size), thumbnail);
+    }
+    CHECK(none);
+    std::string tiff = jpeg.substr(18, 168);
+    bool inside = true;
+    for (size_t size = 0; size < tiff.size(); ++size)
+    {
+        std::string block = wrap(tiff.substr(0, size));
+        ExifData truncated;
+        exif::parse(block, truncated);
+        inside = inside && (!truncated.hasLocation || size >= 128);
+        std::string_view thumbnail;
+        inside = inside && (!exif::thumbnail(block, thumbnail) || size >= 168);
+    }
+    CHECK(inside);
+
+    // oversized counts and offsets
+    layout = Layout();
+    layout.gpsEntries = 0xFFFF;
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.gpsPointer = 0xFFFFFFF0;
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.latitudeCount = 0x40000000;
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.latitudeOffset = 0xFFFFFFFC;
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.latitudeOffset = 150; // the rationals would end past the block
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.denominator = 0;
+    CHECK(!located(layout));
+    layout = Layout();
+    layout.degrees = 91;
+    CHECK(!located(layout));
+
+    // bounds of the IFD1 thumbnail
+    layout = Layout();
+    layout.ifd1 = 0;
+    CHECK(!hasThumbnail(layout) && located(layout));
+    layout.ifd1 = 0xFFFFFFFF;
+    CHECK(!hasThumbnail(layout));
+    layout = Layout();
+    layout.thumbnailLength = 11;
+    CHECK(!hasThumbnail(layout));
+    layout.thumbnailLength = 0xFFFF;
+    CHECK(!hasThumbnail(layout));
+    layout = Layout();
+    layout.thumbnailOffset = 0xFFFFFFFF;
+    CHECK(!hasThumbnail(layout));
+    layout.thumbnailOffset = 166;
+    CHECK(!hasThumbnail(layout));
+    layout = Layout();
+    layout.thumbnailLength = 3;
+    CHECK(!hasThumbnail(layout));
+    layout = Layout();
+    layout.thumbnailStart = 'x'; // not a JPEG stream
+    CHECK(!hasThumbnail(layout));
+
+    return checkResult("test_exif");
+}
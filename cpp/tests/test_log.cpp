@@ -0,0 +1,79 @@
+// Checks the replay of the mutation log: groups are logged with their initial
+// members, and the segments left behind by a compaction interrupted before
+// removing them are not replayed over the snapshot that folded them.
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "check.h"
+#include "../manager.h"
+
+namespace
+{
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string &path, const std::string &content)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << content;
+    }
+}
+
+int main()
+{
+    std::string base = "/tmp/test_log." + std::to_string(::getpid());
+    std::string segment1 = base + ".log.1";
+
+    // without compaction, the group comes back with its members
+    {
+        Manager manager;
+        manager.openLog(base, 1);
+        vPtr a = manager.createVideo("a", "a.mp4", 1);
+        vPtr b = manager.createVideo("b", "b.mp4", 2);
+        manager.createGroup("g", {a, b});
+        manager.commitMutations();
+    }
+    {
+        Manager manager;
+        manager.openLog(base, 1);
+        const Group *group = manager.findGroup("g");
+        CHECK(group && group->size() == 2);
+
+        // a change made through the object is only saved by a compaction
+        std::static_pointer_cast<Video>(manager.getMedias().at("a"))->setDuration(10);
+        std::string folded = readFile(segment1);
+        CHECK(!folded.empty());
+        CHECK(manager.compact());
+        while (manager.isCompacting())
+            ::usleep(1000);
+        CHECK(::access(segment1.c_str(), F_OK) != 0);
+
+        // as if the compactor had crashed after writing the snapshot
+        writeFile(segment1, folded);
+        manager.createVideo("c", "c.mp4", 3);
+        manager.commitMutations();
+    }
+    {
+        Manager manager;
+        manager.openLog(base, 1);
+        const Group *group = manager.findGroup("g");
+        CHECK(group && group->size() == 2);
+        const Video *a = dynamic_cast<const Video *>(manager.findMedia("a"));
+        CHECK(a && a->getDuration() == 10);
+        CHECK(manager.findMedia("c"));
+        CHECK(manager.getMedias().size() == 3);
+        // the new segment comes after the folded one
+        CHECK(::access((base + ".log.3").c_str(), F_OK) == 0);
+    }
+
+    for (const char *suffix : {".snap", ".log.1", ".log.2", ".log.3", ".log.4"})
+        std::remove((base + suffix).c_str());
+    return checkResult("test_log");
+}
@@ -0,0 +1,148 @@
+// Checks the MP4 parser on synthetic files: the movie box is found after the
+// media data, past a box with a 64-bit size; chapters are read from a Nero
+// chapter list or from the track designated by tref/chap; and malformed input
+// (truncated tables, boxes, files) is reported as missing metadata.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "check.h"
+#include "../mp4.h"
+
+namespace
+{
+    std::string u32(uint32_t value)
+    {
+        std::string bytes;
+        for (int shift = 24; shift >= 0; shift -= 8)
+            bytes += char(value >> shift);
+        return bytes;
+    }
+
+    std::string u64(uint64_t value)
+    {
+        return u32(uint32_t(value >> 32)) + u32(uint32_t(value));
+    }
+
+    std::string box(const char *type, const std::string &content)
+    {
+        return u32(uint32_t(content.size() + 8)) + type + content;
+    }
+
+    // version 0 movie or media header
+    std::string header(uint32_t timescale, uint32_t duration)
+    {
+        return u32(0) + u32(0) + u32(0) + u32(timescale) + u32(duration) + std::string(80, '\0');
+    }
+
+    std::string track(uint32_t id, const std::string &content)
+    {
+        return box("trak", box("tkhd", u32(0) + u32(0) + u32(0) + u32(id) + std::string(68, '\0')) + content);
+    }
+
+    // a chapter track with three chapters, 20 s apart, at a time scale of 600;
+    // its time-to-sample table claims _entries_ entries and holds two
+    std::string chapterTrack(uint32_t id, uint32_t entries)
+    {
+        std::string stts = u32(0) + u32(entries) + u32(2) + u32(600 * 20) + u32(1) + u32(600);
+        std::string stbl = box("stbl", box("stts", stts));
+        return track(id, box("mdia", box("mdhd", header(600, 600 * 41)) + box("minf", stbl)));
+    }
+
+    // mvhd version 1: 64-bit times
+    std::string trackMovie(uint32_t entries)
+    {
+        std::string mvhd = box("mvhd", std::string(1, '\1') + std::string(3, '\0') + u64(0) + u64(0) +
+                                           u32(1000) + u64(41000) + std::string(80, '\0'));
+        std::string video = track(1, box("tref", box("chap", u32(2))));
+        return mvhd + video + chapterTrack(2, entries);
+    }
+
+    std::string neroMovie()
+    {
+        // version 1: four reserved bytes before the count
+        std::string chpl = std::string(1, '\1') + std::string(7, '\0') + std::string(1, '\3');
+        const char *titles[] = {"Intro", "", "The end"};
+        uint64_t starts[] = {0, 300000000, 600000000};
+        for (int i = 0; i < 3; ++i)
+            chpl += u64(starts[i]) + char(std::string(titles[i]).size()) + titles[i];
+        return box("mvhd", header(1000, 90500)) + box("udta", box("chpl", chpl));
+    }
+
+    void writeFile(const std::string &path, const std::string &content)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << content;
+    }
+
+    bool readFile(const std::string &path, const std::string &content, Mp4Data &data)
+    {
+        writeFile(path, content);
+        return mp4::readFile(path, data);
+    }
+}
+
+int main()
+{
+    std::string path = "/tmp/test_mp4." + std::to_string(::getpid()) + ".mp4";
+    std::string ftyp = box("ftyp", "isom" + u32(0) + "isommp41");
+    // mdat with a 64-bit size
+    std::string payload(100000, 'm');
+    std::string mdat = u32(1) + "mdat" + u64(payload.size() + 16) + payload;
+
+    // moov after mdat, Nero chapters
+    Mp4Data data;
+    CHECK(readFile(path, ftyp + mdat + box("moov", neroMovie()), data));
+    CHECK(data.hasDuration && data.duration == 90.5);
+    CHECK(data.chapters == std::vector<double>({0, 30, 60}));
+
+    // chapter track, moov before mdat, mdat up to the end of the file (size 0)
+    std::string trackMoov = box("moov", trackMovie(2));
+    CHECK(readFile(path, ftyp + trackMoov + u32(0) + "mdat" + payload, data));
+    CHECK(data.hasDuration && data.duration == 41);
+    CHECK(data.chapters == std::vector<double>({0, 20, 40}));
+
+    // a truncated time-to-sample table: duration only
+    CHECK(mp4::parseMovie(trackMovie(3), data) && data.hasDuration && data.chapters.empty());
+    CHECK(mp4::parseMovie(trackMovie(0x20000000), data) && data.hasDuration && data.chapters.empty());
+
+    // every truncation of the movie box: never more chapters than the full box
+    for (const std::string &movie : {neroMovie(), trackMovie(2)})
+    {
+        bool bounded = true;
+        for (size_t size = 0; size < movie.size(); ++size)
+        {
+            Mp4Data truncated;
+            mp4::parseMovie(movie.substr(0, size), truncated);
+            bounded = bounded && truncated.chapters.size() <= 3;
+        }
+        CHECK(bounded);
+    }
+
+    // no movie box, a movie box larger than the file, a box size smaller than
+    // its header, truncated files
+    CHECK(!readFile(path, ftyp + mdat, data) && !data.hasDuration);
+    CHECK(!readFile(path, ftyp + u32(1000000) + "moov" + neroMovie(), data));
+    CHECK(!readFile(path, ftyp + u32(1) + "mdat" + u64(8) + box("moov", neroMovie()), data));
+    std::string file = ftyp + mdat + box("moov", neroMovie());
+    for (size_t size : {size_t(0), size_t(4), ftyp.size() + 10, ftyp.size() + mdat.size() + 20, file.size() - 1})
+        CHECK(!readFile(path, file.substr(0, size), data));
+
+    std::remove(path.c_str());
+    bool thrown = false;
+    try
+    {
+        mp4::readFile(path, data);
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    return checkResult("test_mp4");
+}
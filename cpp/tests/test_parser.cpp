@@ -0,0 +1,79 @@
+// Checks the CatalogParser on well-formed lines of every kind and on malformed
+// lines, which must be reported and skipped, in particular GroupIds lines whose
+// running sum of differences would overflow.
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../catalogparser.h"
+
+namespace
+{
+    // parses a whole text, returns the valid records and counts the errors
+    std::vector<CatalogRecord> parse(const std::string &text, size_t &errors)
+    {
+        CatalogParser parser(text);
+        std::vector<CatalogRecord> records;
+        CatalogRecord record;
+        while (parser.next(record))
+            records.push_back(record);
+        errors = parser.getErrors().size();
+        return records;
+    }
+
+    bool rejected(const std::string &line)
+    {
+        size_t errors;
+        return parse(line, errors).empty() && errors == 1;
+    }
+}
+
+int main()
+{
+    std::string text = "Photo p p.jpg 1.5 -2\n"
+                       "\n"
+                       "Video v v.mp4 30\r\n"
+                       "Film f f.mp4 60 3 10 20 30\n"
+                       "Group 2 p v My favorites\n"
+                       "GroupIds 3 2 -1 -1 By ids\n";
+    size_t errors;
+    std::vector<CatalogRecord> records = parse(text, errors);
+    CHECK(errors == 0);
+    CHECK(records.size() == 5);
+    if (records.size() == 5)
+    {
+        CHECK(records[0].kind == CatalogRecord::Photo && records[0].name == "p" && records[0].filepath == "p.jpg");
+        CHECK(records[0].latitude == 1.5 && records[0].longitude == -2);
+        CHECK(records[1].kind == CatalogRecord::Video && records[1].duration == 30 && records[1].line == 3);
+        CHECK(records[2].kind == CatalogRecord::Film && (records[2].chapters == std::vector<int>{10, 20, 30}));
+        CHECK(records[3].kind == CatalogRecord::Group && records[3].name == "My favorites");
+        CHECK(records[3].members.size() == 2 && records[3].members[1] == "v");
+        CHECK(records[4].name == "By ids" && (records[4].memberIds == std::vector<size_t>{2, 1, 0}));
+    }
+
+    CHECK(rejected("Photo p p.jpg 1"));
+    CHECK(rejected("Video v v.mp4 long"));
+    CHECK(rejected("Film f f.mp4 60 0"));
+    CHECK(rejected("Film f f.mp4 60 99999 1"));
+    CHECK(rejected("Film f f.mp4 60 1 10 extra"));
+    CHECK(rejected("Group 3 a b"));
+    CHECK(rejected("Sound s s.wav"));
+
+    // IDs go below zero or past 2^48, differences are out of range, or the
+    // running sum would overflow a long long
+    CHECK(rejected("GroupIds 2 0 -1 g"));
+    CHECK(rejected("GroupIds 1 281474976710657 g"));
+    CHECK(rejected("GroupIds 1 9223372036854775807 g"));
+    std::string overflow = "GroupIds 40000";
+    for (int i = 0; i < 40000; ++i)
+        overflow += " 281474976710656";
+    CHECK(rejected(overflow + " g"));
+    CHECK(!rejected("GroupIds 1 281474976710656 g"));
+
+    // a bad line does not prevent the following ones from being parsed
+    records = parse("Video a a.mp4 x\nVideo b b.mp4 1\n", errors);
+    CHECK(errors == 1 && records.size() == 1 && records[0].name == "b");
+
+    return checkResult("test_parser");
+}
@@ -0,0 +1,99 @@
+// Checks Manager::runQuery() against a scan of the whole collection, in
+// particular the name ranges taken from the index: empty, inverted and out of
+// bounds ranges, in both orders.
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../manager.h"
+
+namespace
+{
+    std::vector<std::string> run(const Manager &manager, const std::string &text)
+    {
+        Query query(text);
+        std::vector<std::string> names;
+        manager.runQuery(query, [&](const Multimedia &media)
+                         { names.push_back(media.getName()); });
+        return names;
+    }
+
+    // the matches of the filter, in name order, without using the index
+    std::vector<std::string> scan(const Manager &manager, const std::string &filter, bool descending)
+    {
+        Query query(filter);
+        std::vector<std::string> names;
+        manager.forEachMedia([&](const Multimedia &media)
+                             { if (query.matches(media)) names.push_back(media.getName());
+                               return true; });
+        if (descending)
+            std::reverse(names.begin(), names.end());
+        return names;
+    }
+}
+
+int main()
+{
+    Manager manager;
+    const char *names[] = {"b", "d", "f", "h", "j"};
+    int duration = 10;
+    for (const char *name : names)
+    {
+        manager.createVideo(name, "", duration);
+        duration = duration * 7 % 50;
+    }
+    manager.createPhoto("e", "", 1, 2);
+
+    const char *filters[] = {
+        "name>\"z\" and name<\"b\"",   // inverted, lower bound past the end
+        "name>\"f\" and name<\"d\"",   // inverted inside the collection
+        "name>=\"d\" and name<=\"d\"", // a single name
+        "name>\"d\" and name<\"d\"",   // empty
+        "name>=\"c\" and name<\"c\"",  // empty between two names
+        "name<\"a\"",                  // before the first name
+        "name>\"k\"",                  // after the last name
+        "name>\"a\" and name<\"z\"",
+        "name>=\"d\" and name<\"h\"",
+        "name>\"d\" and name<=\"h\"",
+        "name=\"x\"",
+        "name=\"f\"",
+        "name>\"b\" and type=Video",
+    };
+    for (const char *filter : filters)
+    {
+        std::string text(filter);
+        CHECK(run(manager, text) == scan(manager, text, false));
+        CHECK(run(manager, text + " order by name desc") == scan(manager, text, true));
+        CHECK(run(manager, text + " order by duration").size() == scan(manager, text, false).size());
+    }
+
+    CHECK(run(manager, "name>\"z\" and name<\"b\"").empty());
+    CHECK(run(manager, "name>\"z\" and name<\"b\" order by name desc").empty());
+    CHECK((run(manager, "name>=\"d\" and name<\"h\"") == std::vector<std::string>{"d", "e", "f"}));
+    CHECK((run(manager, "name>\"b\" order by name desc limit 2") == std::vector<std::string>{"j", "h"}));
+    CHECK((run(manager, "type=Video order by duration limit 2 offset 1").size() == 2));
+    CHECK(run(manager, "name>\"b\" limit 2 offset 100").empty());
+
+    // offset + limit and limit + 1 must not wrap around
+    CHECK(run(manager, "type=Video order by duration limit 9223372036854775807 offset 1").size() == 4);
+    CHECK(run(manager, "order by duration limit 9223372036854775807 offset 9223372036854775807").empty());
+    for (bool byDuration : {false, true})
+    {
+        size_t count = 0;
+        std::string next = manager.listMedias([&](const Multimedia &)
+                                              { ++count; },
+                                              SIZE_MAX, byDuration);
+        CHECK(count == (byDuration ? 5 : 6));
+        CHECK(next.empty());
+        count = 0;
+        next = manager.listMedias([&](const Multimedia &)
+                                  { ++count; },
+                                  2, byDuration);
+        CHECK(count == 2 && !next.empty());
+    }
+
+    return checkResult("test_query");
+}
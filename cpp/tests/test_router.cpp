@@ -0,0 +1,115 @@
+// Checks the CommandRouter: every verb of the table is found by its perfect
+// hash and nothing else is, the arguments are tokenized as documented (names
+// with spaces, trailing clauses), and requests reach their handlers. The files
+// that ingest cannot store are listed in its response.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "../manager.h"
+#include "../router.h"
+
+namespace
+{
+    std::string dispatch(const CommandRouter &router, std::string_view request)
+    {
+        std::string response;
+        TCPServer::Body body;
+        router.dispatch(request, response, body);
+        return response;
+    }
+
+    bool startsWith(const std::string &text, std::string_view prefix)
+    {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+int main()
+{
+    const char *verbs[] = {"search", "query", "list", "stats", "filterstats", "cachestats", "logstats",
+                           "play", "delete", "compact", "bgsave", "lastsave", "reloadstats", "loadstats",
+                           "ingest", "duplicates", "collapse", "thumb", "thumbstats", "watchdir",
+                           "unwatchdir", "watchstats"};
+    for (const char *verb : verbs)
+        CHECK(CommandRouter::find(verb) != nullptr);
+    // fetch has a StreamHandler
+    CHECK(CommandRouter::find("fetch") == nullptr);
+    for (const char *verb : {"", "foo", "searc", "searchx", "Search", "stats "})
+        CHECK(CommandRouter::find(verb) == nullptr);
+
+    // tokenizer
+    {
+        CommandArgs args("  one   two three ");
+        CHECK(args.next() == "one");
+        CHECK(args.rest() == "two three");
+        CHECK(args.empty());
+        CHECK(args.next().empty());
+    }
+    {
+        CommandArgs args("\"my video\" rest");
+        CHECK(args.nextName() == "my video");
+        CHECK(args.next() == "rest");
+    }
+    {
+        CommandArgs args("my video ifnot 42");
+        unsigned long version = 0;
+        CHECK(args.lastNumber("ifnot", version) && version == 42);
+        CHECK(args.nextName(true) == "my video");
+    }
+    {
+        CommandArgs args("my video ifnot x");
+        unsigned long version = 7;
+        CHECK(!args.lastNumber("ifnot", version) && version == 7);
+        CHECK(args.nextName(true) == "my video ifnot x");
+    }
+    {
+        CommandArgs args("12 x");
+        int number = 0;
+        CHECK(args.nextNumber(number) && number == 12);
+        CHECK(!args.nextNumber(number) && args.next() == "x");
+    }
+
+    // dispatch
+    Manager manager;
+    pPtr photo = manager.createPhoto("p", "p.jpg", 1, 2);
+    vPtr video = manager.createVideo("my video", "v.mp4", 3);
+    manager.createGroup("My favorites", {photo, video});
+    CommandRouter router(manager);
+
+    CHECK(startsWith(dispatch(router, "search p"), "VERSION "));
+    CHECK(dispatch(router, "search my video") == dispatch(router, "search \"my video\""));
+    CHECK(dispatch(router, "search My favorites").find("Name: my video") != std::string::npos);
+    std::string ifnot = "search p ifnot " + std::to_string(photo->getVersion());
+    CHECK(dispatch(router, ifnot) == "NOTMODIFIED " + std::to_string(photo->getVersion()));
+    CHECK(dispatch(router, "search nope") == "NOTFOUND nope");
+    CHECK(dispatch(router, "query type=Video") == "RESULTS 1 my video");
+    CHECK(dispatch(router, "foo bar") == "ERROR unknown command foo");
+    CHECK(dispatch(router, "delete p") == "OK");
+    CHECK(dispatch(router, "search p") == "NOTFOUND p");
+    CHECK(startsWith(dispatch(router, "stats"), "STATS photos=0 videos=1 "));
+
+    std::string directory = "/tmp/test_router." + std::to_string(::getpid());
+    ::mkdir(directory.c_str(), 0700);
+    ::mkdir((directory + "/Holiday 2019").c_str(), 0700);
+    const char *files[] = {"/a.mp4", "/Holiday 2019/IMG 001.mp4", "/b\tc.mp4"};
+    for (const char *file : files)
+        std::ofstream(directory + file, std::ios::binary) << std::string("\0\0\0\x10" "ftypisom\0\0\0\0", 16);
+    std::string ingested = dispatch(router, "ingest " + directory + " hash none");
+    CHECK(ingested.find(" videos=1 ") != std::string::npos && ingested.find(" skipped=2 ") != std::string::npos);
+    // in the order of the crawl
+    CHECK(ingested.find(" skippedpaths=\"") != std::string::npos);
+    CHECK(ingested.find("\"Holiday 2019/IMG 001.mp4\"") != std::string::npos);
+    CHECK(ingested.find("\"b?c.mp4\"") != std::string::npos && ingested.find('\t') == std::string::npos);
+    for (const char *file : files)
+        std::remove((directory + file).c_str());
+    ::rmdir((directory + "/Holiday 2019").c_str());
+    ::rmdir(directory.c_str());
+
+    return checkResult("test_router");
+}
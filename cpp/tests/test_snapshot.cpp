@@ -0,0 +1,172 @@
+// Checks the binary snapshots: a snapshot loads back the catalog it was saved
+// from, a corrupted one is rejected without changing anything, and a snapshot
+// opened lazily keeps the version of its objects through evictions and must be
+// materialised before the const operations over the whole catalog.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "check.h"
+#include "../manager.h"
+#include "../router.h"
+
+namespace
+{
+    std::string tempPath(const char *suffix)
+    {
+        return "/tmp/test_snapshot." + std::to_string(::getpid()) + suffix;
+    }
+
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::string display(const CatalogStats &stats)
+    {
+        std::ostringstream oss;
+        stats.display(oss);
+        return oss.str();
+    }
+
+    // the text catalog of a Manager, to compare catalogs
+    std::string saved(const Manager &manager)
+    {
+        std::string text = tempPath(".txt");
+        manager.save(text);
+        std::string content = readFile(text);
+        std::remove(text.c_str());
+        return content;
+    }
+}
+
+int main()
+{
+    std::string snap = tempPath(".snap");
+
+    // round trip of every kind of object and of groups
+    {
+        Manager manager;
+        manager.createPhoto("photo", "photo.jpg", 45.5, -1.25);
+        manager.createVideo("video", "video.mp4", 30);
+        int chapters[] = {5, 10, 15};
+        manager.createFilm("film", "film.mp4", 30, chapters, 3);
+        manager.createVideo("lonely", "lonely.mp4", 1);
+        manager.createGroup("My favorites", {manager.getMedias().at("photo"), manager.getMedias().at("film")});
+        manager.createGroup("empty");
+        manager.saveSnapshot(snap);
+
+        Manager loaded;
+        CHECK(loaded.loadSnapshot(snap) == 0);
+        CHECK(saved(manager).find("My favorites") != std::string::npos);
+        CHECK(saved(loaded) == saved(manager));
+        CHECK(display(loaded.getStats()) == display(manager.getStats()));
+
+        // a flipped byte is detected, and nothing is loaded
+        std::string content = readFile(snap);
+        std::string corrupted = tempPath(".bad");
+        // magic, version, header checksum, string table
+        for (size_t offset : {0, 8, 100, 200})
+        {
+            std::string bad = content;
+            bad[offset] ^= 0x20;
+            std::ofstream(corrupted, std::ios::binary) << bad;
+            Manager other;
+            bool thrown = false;
+            try
+            {
+                other.loadSnapshot(corrupted);
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown = true;
+            }
+            CHECK(thrown);
+            CHECK(other.getMedias().empty());
+        }
+        std::remove(corrupted.c_str());
+    }
+
+    {
+        Manager manager;
+        for (int i = 0; i < 100; ++i)
+            manager.createVideo("video" + std::to_string(i), "video.mp4", i);
+        manager.saveSnapshot(snap);
+    }
+
+    // objects evicted from the cache come back with the same version
+    {
+        Manager manager;
+        manager.openSnapshot(snap, 4);
+        unsigned long versions[100];
+        for (int i = 0; i < 100; ++i)
+            versions[i] = manager.findVersion("video" + std::to_string(i)).value_or(0);
+        CHECK(manager.getLazyCatalog()->getEvictions() > 0);
+        bool same = true;
+        for (int i = 0; i < 100; ++i)
+            same = same && manager.findVersion("video" + std::to_string(i)).value_or(0) == versions[i];
+        CHECK(same);
+        CHECK(versions[0] != 0 && versions[0] != versions[1]);
+
+        // nor are the versions changed by materialisation
+        bool thrown = false;
+        try
+        {
+            manager.getStats();
+        }
+        catch (const std::logic_error &)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        manager.materialize();
+        CHECK(manager.getStats().getCount() == 100);
+        CHECK(manager.findVersion("video42").value_or(0) == versions[42]);
+    }
+
+    // the checksums are not verified when a snapshot is opened lazily: a
+    // corrupted entry fails the materialisation, which changes nothing, and
+    // the requests that need it, which do not stop the server
+    {
+        std::string content = readFile(snap);
+        uint64_t mediaTable;
+        memcpy(&mediaTable, content.data() + 72, sizeof(mediaTable)); // offset of the media section
+        // name length of the last entry, "video99"
+        uint32_t length = 0xFFFFFFFF;
+        memcpy(&content[mediaTable + 99 * 64 + 16], &length, sizeof(length));
+        std::string corrupted = tempPath(".bad");
+        std::ofstream(corrupted, std::ios::binary) << content;
+
+        Manager manager;
+        manager.openSnapshot(corrupted, 4);
+        bool thrown = false;
+        try
+        {
+            manager.materialize();
+        }
+        catch (const std::exception &)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(manager.getLazyCatalog() && manager.getLazyCatalog()->size() == 100);
+        CHECK(manager.findMedia("video42"));
+
+        CommandRouter router(manager);
+        std::string response;
+        TCPServer::Body body;
+        CHECK(router.dispatch("stats", response, body) && response.compare(0, 6, "ERROR ") == 0);
+        CHECK(router.dispatch("search video7", response, body) && response.compare(0, 8, "VERSION ") == 0);
+        std::remove(corrupted.c_str());
+    }
+
+    std::remove(snap.c_str());
+    return checkResult("test_snapshot");
+}
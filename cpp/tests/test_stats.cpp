@@ -0,0 +1,158 @@
+// Checks that the statistics maintained incrementally by the Manager and its
+// groups stay equal to the statistics recomputed from scratch, through
+// creations, setters, group changes and deletions, and that non-finite photo
+// coordinates are rejected.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../manager.h"
+#include "../catalogparser.h"
+
+namespace
+{
+    template <class Items>
+    std::string recompute(const Items &items)
+    {
+        CatalogStats stats;
+        std::vector<Multimedia *> added;
+        for (const auto &item : items)
+        {
+            Multimedia &media = *item;
+            stats.add(media);
+            added.push_back(&media);
+        }
+        std::ostringstream oss;
+        stats.display(oss);
+        for (Multimedia *media : added)
+            stats.remove(*media);
+        return oss.str();
+    }
+
+    std::string display(const CatalogStats &stats)
+    {
+        std::ostringstream oss;
+        stats.display(oss);
+        return oss.str();
+    }
+
+    void checkAll(Manager &manager, const std::vector<gPtr> &groups)
+    {
+        std::vector<mmPtr> medias;
+        for (const auto &pair : manager.getMedias())
+            medias.push_back(pair.second);
+        CHECK(display(manager.getStats()) == recompute(medias));
+        for (const gPtr &group : groups)
+            CHECK(display(group->getStats()) == recompute(*group));
+    }
+}
+
+int main()
+{
+    Manager manager;
+    std::mt19937 random(42);
+    std::vector<gPtr> groups{manager.createGroup("g1"), manager.createGroup("g2")};
+    std::vector<std::string> names;
+    int next = 0;
+
+    for (int step = 0; step < 2000; ++step)
+    {
+        int action = random() % 8;
+        if (action <= 2 || names.empty())
+        {
+            std::string name = "m" + std::to_string(next++);
+            int kind = random() % 3;
+            if (kind == 0)
+                manager.createPhoto(name, "", int(random() % 180) - 90, int(random() % 360) - 180);
+            else if (kind == 1)
+                manager.createVideo(name, "", random() % 100);
+            else
+            {
+                int chapters[] = {1, 2, 3, 4, 5};
+                manager.createFilm(name, "", random() % 100, chapters, 1 + random() % 5);
+            }
+            names.push_back(name);
+            continue;
+        }
+        const std::string &name = names[random() % names.size()];
+        mmPtr media = manager.getMedias().at(name);
+        if (action == 3)
+        {
+            if (auto photo = std::dynamic_pointer_cast<Photo>(media))
+                photo->setLatitude(photo->getLatitude() + 1.5);
+            else if (auto film = std::dynamic_pointer_cast<Film>(media))
+            {
+                int chapters[] = {7, 8};
+                film->setChapters(chapters, 1 + random() % 2);
+            }
+            else
+                std::static_pointer_cast<Video>(media)->setDuration(random() % 100);
+        }
+        else if (action == 4)
+            groups[random() % 2]->push_back(media);
+        else if (action == 5)
+            groups[random() % 2]->remove(media);
+        else if (action == 6 && random() % 10 == 0)
+            groups[random() % 2]->clear();
+        else if (action == 7)
+        {
+            // deleting an object does not remove it from its groups
+            for (const gPtr &group : groups)
+                group->remove(media);
+            manager.deleteByName(name);
+            names.erase(std::find(names.begin(), names.end(), name));
+        }
+        if (step % 50 == 0)
+            checkAll(manager, groups);
+    }
+    checkAll(manager, groups);
+
+    // non-finite coordinates are rejected everywhere, so they never reach the statistics
+    std::string before = display(manager.getStats());
+    bool thrown = false;
+    try
+    {
+        manager.createPhoto("nan", "", NAN, 0);
+    }
+    catch (const std::invalid_argument &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!manager.findMedia("nan"));
+
+    pPtr photo = manager.createPhoto("finite", "", 1, 2);
+    thrown = false;
+    try
+    {
+        photo->setLongitude(INFINITY);
+    }
+    catch (const std::invalid_argument &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(photo->getLongitude() == 2);
+    manager.deleteByName("finite");
+    CHECK(display(manager.getStats()) == before);
+
+    const char *lines[] = {"Photo a a.jpg nan 0", "Photo b b.jpg 0 inf", "Photo c c.jpg -INF 0", "Photo d d.jpg 1 2"};
+    for (const char *line : lines)
+    {
+        std::string text(line);
+        CatalogParser parser(text);
+        CatalogRecord record;
+        bool parsed = parser.next(record);
+        CHECK(parsed == (text[6] == 'd'));
+        CHECK(parser.getErrors().size() == (parsed ? 0u : 1u));
+    }
+    checkAll(manager, groups);
+
+    return checkResult("test_stats");
+}
@@ -0,0 +1,102 @@
+#include "thumbcache.h"
+
+ThumbnailCache::ThumbnailCache(size_t capacity) : capacity(capacity)
+{
+}
+
+ThumbnailCache::Bytes ThumbnailCache::find(const std::string &filepath, uint64_t size, int64_t mtime)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto slotIt = cache.find(filepath);
+    if (slotIt == cache.end() || slotIt->second.size != size || slotIt->second.mtime != mtime)
+    {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    recent.splice(recent.begin(), recent, slotIt->second.recent);
+    return slotIt->second.thumbnail;
+}
+
+void ThumbnailCache::put(const std::string &filepath, uint64_t size, int64_t mtime, Bytes thumbnail)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto slotIt = cache.find(filepath);
+    if (slotIt != cache.end())
+    {
+        bytes -= slotIt->second.thumbnail->size();
+        recent.erase(slotIt->second.recent);
+        cache.erase(slotIt);
+    }
+    // a thumbnail larger than the whole cache is not kept
+    if (thumbnail->size() > capacity)
+        return;
+    bytes += thumbnail->size();
+    while (bytes > capacity)
+    {
+        auto evictedIt = cache.find(recent.back());
+        bytes -= evictedIt->second.thumbnail->size();
+        cache.erase(evictedIt);
+        recent.pop_back();
+        ++evictions;
+    }
+    recent.push_front(filepath);
+    cache.emplace(filepath, Slot{size, mtime, std::move(thumbnail), recent.begin()});
+}
+
+void ThumbnailCache::record(bool hit, uint64_t nanoseconds)
+{
+    int bucket = 0;
+    while (bucket < 63 && (uint64_t(1) << bucket) < nanoseconds)
+        ++bucket;
+    std::lock_guard<std::mutex> lock(mutex);
+    ++latencies[hit][bucket];
+}
+
+size_t ThumbnailCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.size();
+}
+
+size_t ThumbnailCache::getBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
+
+unsigned long ThumbnailCache::getHits() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+unsigned long ThumbnailCache::getMisses() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+unsigned long ThumbnailCache::getEvictions() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return evictions;
+}
+
+uint64_t ThumbnailCache::getLatencyPercentile(bool hit, double fraction) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t count = 0;
+    for (uint64_t n : latencies[hit])
+        count += n;
+    if (count == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(fraction * (count - 1)) + 1, seen = 0;
+    for (int bucket = 0; bucket < 64; ++bucket)
+    {
+        seen += latencies[hit][bucket];
+        if (seen >= rank)
+            return uint64_t(1) << bucket;
+    }
+    return uint64_t(1) << 63;
+}
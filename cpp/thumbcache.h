@@ -0,0 +1,117 @@
+/**
+ * @file thumbcache.h
+ * @brief Header file for the ThumbnailCache class
+ *
+ * This file defines the ThumbnailCache class, a least-recently-used cache of
+ * photo thumbnails bounded in bytes.
+ */
+
+#ifndef THUMBCACHE_H
+#define THUMBCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @class ThumbnailCache
+ * @brief Thumbnails of files, bounded by their total size
+ *
+ * Each entry holds the thumbnail of a file with the size and modification
+ * time the file had when it was read: an entry whose file changed since is
+ * a miss. A file without thumbnail is cached as an empty thumbnail, so that
+ * it is not parsed again.
+ *
+ * When the total size of the thumbnails exceeds the capacity, the least
+ * recently used ones are evicted. Thumbnails are shared, not copied: one
+ * evicted while being sent stays valid until it is sent. The cache is
+ * protected by a mutex so that concurrent readers may share it.
+ *
+ * @sa Manager::getThumbnail()
+ */
+class ThumbnailCache
+{
+public:
+    using Bytes = std::shared_ptr<const std::string>;
+
+    /**
+     * @brief Creates an empty cache
+     *
+     * @param[in] capacity The maximum total size of the thumbnails in bytes
+     */
+    explicit ThumbnailCache(size_t capacity);
+
+    /**
+     * @brief Returns the thumbnail of a file, if cached and current
+     *
+     * @param[in] filepath The file
+     * @param[in] size The current size of the file
+     * @param[in] mtime The current modification time of the file
+     * @return nullptr on a miss
+     */
+    Bytes find(const std::string &filepath, uint64_t size, int64_t mtime);
+
+    /** @brief Adds or replaces the thumbnail of a file, evicting others if needed */
+    void put(const std::string &filepath, uint64_t size, int64_t mtime, Bytes thumbnail);
+
+    /**
+     * @brief Records the time taken to serve a thumbnail
+     *
+     * @param[in] hit true if the thumbnail came from the cache
+     * @param[in] nanoseconds The time taken
+     */
+    void record(bool hit, uint64_t nanoseconds);
+
+    /** @brief Returns the number of cached thumbnails */
+    size_t size() const;
+
+    /** @brief Returns the total size of the cached thumbnails */
+    size_t getBytes() const;
+
+    /** @brief Returns the maximum total size of the thumbnails */
+    size_t getCapacity() const { return capacity; }
+
+    /** @brief Returns the number of lookups served from the cache */
+    unsigned long getHits() const;
+
+    /** @brief Returns the number of lookups that had to read the file */
+    unsigned long getMisses() const;
+
+    /** @brief Returns the number of thumbnails evicted */
+    unsigned long getEvictions() const;
+
+    /**
+     * @brief Returns a percentile of the time taken to serve a thumbnail
+     *
+     * Latencies are recorded in power-of-two buckets; the upper bound of the
+     * bucket is returned.
+     *
+     * @param[in] hit true for the hits, false for the misses
+     * @param[in] fraction The percentile, between 0 and 1 (0.99 for p99)
+     * @return The latency in nanoseconds, 0 if nothing was recorded
+     */
+    uint64_t getLatencyPercentile(bool hit, double fraction) const;
+
+private:
+    struct Slot
+    {
+        uint64_t size;
+        int64_t mtime;
+        Bytes thumbnail;
+        std::list<std::string>::iterator recent;
+    };
+
+    size_t capacity;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Slot> cache;
+    std::list<std::string> recent; ///< cached files, most recently used first
+    size_t bytes = 0;
+    unsigned long hits = 0, misses = 0, evictions = 0;
+    uint64_t latencies[2][64] = {}; ///< misses, hits
+};
+
+#endif // THUMBCACHE_H
@@ -0,0 +1,96 @@
+/**
+ * @file topk.h
+ * @brief Header file for the TopK class template
+ *
+ * This file defines TopK, a bounded heap that keeps the k smallest elements
+ * seen so far. It is used to order query and listing results without sorting
+ * (or even copying) the whole collection.
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * @class TopK
+ * @brief Keeps the k smallest elements of a stream according to a comparator
+ *
+ * Elements are kept in a max-heap of at most k entries: pushing costs O(log k)
+ * and an element larger than the current k-th smallest is rejected in O(1).
+ * Selecting a page of k items out of n therefore costs O(n log k) time and O(k)
+ * memory instead of O(n log n) and O(n) for a full sort.
+ *
+ * @tparam T The element type (typically a small key plus a raw pointer)
+ * @tparam Less A strict weak ordering on T
+ */
+template <class T, class Less = std::less<T>>
+class TopK
+{
+public:
+    /**
+     * @brief Creates an empty TopK
+     *
+     * @param[in] k The maximum number of elements kept
+     * @param[in] less The comparator used to order elements
+     */
+    explicit TopK(size_t k, Less less = Less()) : k(k), less(less)
+    {
+        heap.reserve(std::min<size_t>(k, 1024));
+    }
+
+    /**
+     * @brief Offers an element to the heap
+     *
+     * The element is kept if fewer than k elements were kept so far or if it
+     * is smaller than the largest kept element, which is then dropped.
+     *
+     * @param[in] value The element to offer
+     */
+    void push(const T &value)
+    {
+        if (k == 0)
+            return;
+        if (heap.size() < k)
+        {
+            heap.push_back(value);
+            std::push_heap(heap.begin(), heap.end(), less);
+        }
+        else if (less(value, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), less);
+            heap.back() = value;
+            std::push_heap(heap.begin(), heap.end(), less);
+        }
+    }
+
+    /**
+     * @brief Returns the kept elements in ascending order
+     *
+     * The heap is left empty afterwards.
+     *
+     * @return A vector of at most k elements sorted with the comparator
+     */
+    std::vector<T> takeSorted()
+    {
+        std::sort_heap(heap.begin(), heap.end(), less);
+        std::vector<T> sorted;
+        sorted.swap(heap);
+        return sorted;
+    }
+
+private:
+    /** @brief The maximum number of elements kept */
+    size_t k;
+
+    /** @brief The comparator used to order elements */
+    Less less;
+
+    /** @brief Max-heap (with respect to less) of the kept elements */
+    std::vector<T> heap;
+};
+
+#endif // TOPK_H
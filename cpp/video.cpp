@@ -21,7 +21,9 @@ int Video::getDuration() const
 
 void Video::setDuration(int duration)
 {
+    beforeChange();
     this->duration = duration;
+    afterChange();
 }
 
 std::ostream &Video::display(std::ostream &os) const
@@ -34,15 +36,17 @@ std::ostream &Video::display(std::ostream &os) const
 void Video::play() const
 {
     std::cout << "Displaying a video\n";
-    std::string string = "mpv " + filepath + " &";
-    const char *cstring = string.data();
-    if (system(cstring))
+    if (!launch("mpv"))
     {
-        std::cout << "File DNE\n";
-        exit(EXIT_FAILURE);
+        std::cout << "Cannot start mpv\n";
     };
 }
 
+MediaType Video::getType() const
+{
+    return MediaType::Video;
+}
+
 void Video::write(const std::string& filename) const {
     std::ofstream f(filename, std::ios::app); // append to the file
     f << "Video " << name << " " <<  filepath << " "
@@ -92,6 +92,15 @@ public:
      */
     void write(const std::string& filename) const override;
 
+    /**
+     * @brief Retrieves the concrete type of the video
+     * 
+     * @return MediaType::Video
+     * 
+     * @note This overrides the pure virtual method from the Multimedia class
+     */
+    MediaType getType() const override;
+
 protected:
     /** @brief The duration of the video in seconds
      *  @details Initialized to 0 by default